@@ -25,8 +25,12 @@
 
 #include "Commands.h"
 
+#include "Content.h"
+#include "Dialogs.h"
 #include "Elements.h"
+#include "Journal.h"
 #include "Page.h"
+#include "Playback.h"
 #include "Score.h"
 #include "Viewer.h"
 #include "Window.h"
@@ -44,12 +48,14 @@ void Commands::getAllCommands(juce::Array<juce::CommandID>& commands)
     FileSave,
     FileSaveAs,
     FileSaveAsXML,
+    FileExportClickTrack,
     FileQuit,
     
     ViewUseInches,
     ViewUseCentimeters,
     ViewShowCoarseGrid,
     ViewShowFineGrid,
+    ViewPreviewRhythm,
     
     PageLandscape,
     PagePortrait,
@@ -59,7 +65,9 @@ void Commands::getAllCommands(juce::Array<juce::CommandID>& commands)
     PageA3,
     PageTabloid,
     PageB3,
-    PageCustomSize
+    PageCustomSize,
+    PageAddPage,
+    PageRemovePage
   };
 
   commands.addArray(ids, sizeof(ids) / sizeof(CommandID));
@@ -87,6 +95,8 @@ juce::String Commands::getCommandNameFromID(const juce::CommandID id)
     return "Save As...";
   case FileSaveAsXML:
     return "Save As XML...";
+  case FileExportClickTrack:
+    return "Export Click Track...";
   case FileQuit:
     if(prim::OS::Windows())
       return "Exit";
@@ -100,6 +110,8 @@ juce::String Commands::getCommandNameFromID(const juce::CommandID id)
     return "Show Grid";
   case ViewShowFineGrid:
     return "Show Fine Grid";
+  case ViewPreviewRhythm:
+    return "Preview Rhythm";
   case PageLandscape:
     return "Landscape";
   case PagePortrait:
@@ -118,6 +130,10 @@ juce::String Commands::getCommandNameFromID(const juce::CommandID id)
     return "B3 (353x500 mm)";
   case PageCustomSize:
     return "Custom Size...";
+  case PageAddPage:
+    return "Add Page";
+  case PageRemovePage:
+    return "Remove Page";
   default:
     return "Command Item";
   }
@@ -154,6 +170,8 @@ void Commands::getShortcuts(const juce::CommandID id,
     info.addDefaultKeypress('G', 0);
   else if(command == ViewShowFineGrid)
     info.addDefaultKeypress('F', 0);
+  else if(command == ViewPreviewRhythm)
+    info.addDefaultKeypress(' ', 0);
   else if(command == PageLandscape)
     info.addDefaultKeypress('L', 0);
   else if(command == PagePortrait)
@@ -206,6 +224,10 @@ void Commands::getCommandInfo(const juce::CommandID id,
     info.setTicked(getDocument()->showFineGrid);
     break;
     
+  case ViewPreviewRhythm:
+    info.setTicked(getPlayback()->isPlaying());
+    break;
+    
   case PagePortrait:
     info.setTicked(getContainer()->sizePage.x < getContainer()->sizePage.y);
     break;
@@ -248,6 +270,10 @@ void Commands::getCommandInfo(const juce::CommandID id,
       13.897f * 19.685f) < 0.25f)
       info.setTicked(true);
     break;    
+    
+  case PageRemovePage:
+    info.setActive(getPageCount() > 1);
+    break;
   }
 }
 
@@ -320,20 +346,35 @@ bool Commands::perform(
       prim::String allXMLMetadata;
       getRepresentation()->toString(allXMLMetadata);
 
-      //Set the PDF output properties.
+      /*Set the PDF output properties. Saving again to the same file only
+      paints and appends the pages that changed since the last save.*/
       abcd::PDF::Properties prop;
       prop.ExtraData = (prim::byte*)allXMLMetadata.Merge();
       prop.ExtraDataLength = allXMLMetadata.ByteLength();  
+      prop.Filename = filename.toUTF8();
+      prop.LastSave = &getDocument()->lastSave;
+      
+      //The pages are drawn with the zoom and the grids of the view.
+      prim::String settings;
+      settings &= getViewer()->percentageZoom;
+      settings -= (prim::integer)getDocument()->showGrid;
+      settings -= (prim::integer)getDocument()->showFineGrid;
+      prop.LastSave->SetPageSettings(settings);
       
-      //Create a PDF.
+      //Each page has its own canvas, so the pages can be painted at once.
+      prop.PaintCanvasesInParallel = true;
+      
+      //Create the PDF and write it to file.
       getDocument()->temporarilyHideHandles = true;
       getScore()->Create<abcd::PDF>(&prop);
-
-      //Write the PDF to file.
-      prim::File::Replace(filename.toUTF8(), prop.Output.Merge());
       
       //Update the current save file.
-      getDocument()->filename = filename.toUTF8();
+      prim::String saved = filename.toRawUTF8();
+      if(saved != getDocument()->filename)
+      {
+        getDocument()->filename = saved;
+        getJournal()->recordFilename();
+      }
     }
     break;
     
@@ -367,6 +408,38 @@ bool Commands::perform(
       prim::File::Replace(filename.toUTF8(), allXMLMetadata);
     }
     break;
+
+  case FileExportClickTrack:
+    {
+      juce::String defaultFilename = juce::File::getSpecialLocation(
+        juce::File::userDesktopDirectory).getFullPathName();
+      defaultFilename << juce::File::separatorString;
+      defaultFilename << "Untitled.aiff";
+
+      juce::FileChooser SaveDialog("Please choose a filename",
+        defaultFilename, "*.aiff;*.wav", true);
+      
+      if(!SaveDialog.browseForFileToSave(true))
+        break;
+      
+      filename = SaveDialog.getResult().getFullPathName().toUTF8();
+      
+      //Write a wave file if asked for, and an AIFF otherwise.
+      bool wav = filename.endsWithIgnoreCase(".wav");
+      if(!wav && !filename.endsWithIgnoreCase(".aiff"))
+        filename << ".aiff";
+      
+      //Ask how long the main section should last.
+      new ValueChooser("Export Click Track", "Enter seconds (1-3600):",
+        getDocument()->rhythmSeconds, 1, 3600);
+      if(!ValueChooserComponent::valueIsValid)
+        break;
+      
+      getDocument()->rhythmSeconds = ValueChooserComponent::lastValueReturned;
+      getScore()->exportClickTrack(filename.toRawUTF8(),
+        getDocument()->rhythmSeconds, wav);
+    }
+    break;
    
   case FileQuit:
     Window::closeAllWindows();
@@ -376,33 +449,41 @@ bool Commands::perform(
     getDocument()->useInches = false;
     getContainer()->sizeGrid = prim::math::Millimeters(50.0f, 50.0f);
     getContainer()->sizeSubgrid = prim::math::Millimeters(10.0f, 10.0f);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->repaintScores();
     break;
     
   case ViewUseInches:
     getDocument()->useInches = true;
     getContainer()->sizeGrid.x = getContainer()->sizeGrid.y = 1.0f;
     getContainer()->sizeSubgrid.x = getContainer()->sizeSubgrid.y = 0.5f;
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->repaintScores();
     break;
     
   case ViewShowCoarseGrid:
     getDocument()->showGrid = !getDocument()->showGrid;
-    getPage(0)->repaint();
+    getContent()->repaintScores();
     break;
     
   case ViewShowFineGrid:
     getDocument()->showFineGrid = !getDocument()->showFineGrid;
-    getPage(0)->repaint();
+    getContent()->repaintScores();
+    break;
+    
+  case ViewPreviewRhythm:
+    if(getPlayback()->isPlaying())
+      getPlayback()->stop();
+    else if(getPlayback()->start())
+      getScore()->publishOnsets();
     break;
     
   case PagePortrait:
     if(getContainer()->sizePage.x > getContainer()->sizePage.y)
     {
       prim::math::Swap(getContainer()->sizePage.x, getContainer()->sizePage.y);
-      getCanvas(0)->Dimensions = getContainer()->sizePage;
-      getViewer()->positionPages(true);
-      getPage(0)->repaint();
+      getJournal()->recordContainer();
+      getContent()->paginate();
     }
     break;
     
@@ -410,56 +491,70 @@ bool Commands::perform(
     if(getContainer()->sizePage.x < getContainer()->sizePage.y)
     {
       prim::math::Swap(getContainer()->sizePage.x, getContainer()->sizePage.y);
-      getCanvas(0)->Dimensions = getContainer()->sizePage;
-      getViewer()->positionPages(true);
-      getPage(0)->repaint();
+      getJournal()->recordContainer();
+      getContent()->paginate();
     }
     break;
     
   case PageLetter:
     getContainer()->sizePage = prim::math::Inches(11.0f, 8.5f);
-    getCanvas(0)->Dimensions = prim::math::Inches(11.0f, 8.5f);
-    getViewer()->positionPages(true);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->paginate();
     break;
     
   case PageA4:
     getContainer()->sizePage = prim::math::Millimeters(297.0f, 210.0f);
-    getCanvas(0)->Dimensions = prim::math::Millimeters(297.0f, 210.0f);
-    getViewer()->positionPages(true);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->paginate();
     break;
 
   case PageB4:
     getContainer()->sizePage = prim::math::Millimeters(353.0f, 250.0f);
-    getCanvas(0)->Dimensions = prim::math::Millimeters(353.0f, 250.0f);
-    getViewer()->positionPages(true);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->paginate();
     break;
         
   case PageA3:
     getContainer()->sizePage = prim::math::Millimeters(420.0f, 297.0f);
-    getCanvas(0)->Dimensions = prim::math::Millimeters(420.0f, 297.0f);
-    getViewer()->positionPages(true);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->paginate();
     break;
     
   case PageTabloid:
     getContainer()->sizePage = prim::math::Inches(17.0f, 11.0f);
-    getCanvas(0)->Dimensions = prim::math::Inches(17.0f, 11.0f);
-    getViewer()->positionPages(true);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->paginate();
     break;
     
   case PageB3:
     getContainer()->sizePage = prim::math::Millimeters(500.0f, 353.0f);
-    getCanvas(0)->Dimensions = prim::math::Millimeters(500.0f, 353.0f);
-    getViewer()->positionPages(true);
-    getPage(0)->repaint();
+    getJournal()->recordContainer();
+    getContent()->paginate();
     break;    
     
   case PageCustomSize:
     break;
+    
+  case PageAddPage:
+    //Show the new page at the end.
+    getJournal()->recordSection(getContainer()->addMainSection());
+    getViewer()->focusIndex = getPageCount();
+    getContent()->paginate();
+    break;
+    
+  case PageRemovePage:
+    if(getPageCount() > 1)
+    {
+      //Remove the page in focus.
+      prim::count i = prim::math::Min(getViewer()->focusIndex,
+        getPageCount() - 1);
+      Representation::Section* section =
+        static_cast<notation::Score::Page*>(getCanvas(i))->section;
+      getJournal()->recordRemoval(section);
+      getContainer()->removeMainSection(section);
+      getContent()->paginate();
+    }
+    break;
   }
 
   return true;
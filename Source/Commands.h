@@ -71,6 +71,7 @@ public:
     FileSave             = 0x10400,
     FileSaveAs           = 0x10500,
     FileSaveAsXML        = 0x10600,
+    FileExportClickTrack = 0x10900,
     FileRevertToOriginal = 0x10700,
     FileQuit             = 0x10800,
     
@@ -78,6 +79,7 @@ public:
     ViewUseInches        = 0x20200,
     ViewShowCoarseGrid   = 0x20300,
     ViewShowFineGrid     = 0x20400,
+    ViewPreviewRhythm    = 0x20500,
     
     PageLandscape        = 0x30100,
     PagePortrait         = 0x30200,
@@ -87,7 +89,9 @@ public:
     PageA3               = 0x30600,
     PageTabloid          = 0x30700,
     PageB3               = 0x30800,
-    PageCustomSize       = 0x30900
+    PageCustomSize       = 0x30900,
+    PageAddPage          = 0x30A00,
+    PageRemovePage       = 0x30B00
   };
 };
 
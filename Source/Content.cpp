@@ -25,6 +25,7 @@
  
 #include "Content.h"
 #include "Elements.h"
+#include "Globals.h"
 #include "Page.h"
 #include "Score.h"
 #include "Viewer.h"
@@ -38,18 +39,100 @@ Content::Content(Document* document) : DocumentHandler(document)
   //Set the content as soon as we have it.
   getDocument()->content = this;
   
-  getPages().Add() = new Page(getDocument());
-  bbs::abstracts::Portfolio::Canvas* c = 
-    getCanvases().Add() = new notation::Score::Page(getDocument(), *getScore());
-  c->Dimensions = getContainer()->sizePage;
+  paginate();
+}
+
+Content::~Content()
+{
+  for(prim::count i = 0; i < shownPages.n(); i++)
+    delete getPage(shownPages[i]);
+}
+
+void Content::paginate(void)
+{
+  //Page numbers may have shifted, so start over with no components.
+  getViewer()->focusPage = 0;
+  for(prim::count i = 0; i < shownPages.n(); i++)
+    delete getPage(shownPages[i]);
+  shownPages.Clear();
+  
+  getScore()->paginate();
+  getScore()->sectionsChanged();
+  getPages().n(getCanvasCount());
+  for(prim::count i = 0; i < getPageCount(); i++)
+    getPages()[i] = 0;
+  
+  //The sizes of the pages may have changed, so lay them out again.
+  getViewer()->pixelsPerInchOfLayout = 0;
   getViewer()->positionPages(true);
+}
+
+void Content::showPages(prim::count first, prim::count last)
+{
+  //Only the pages that have components are visited, not the whole score.
+  prim::Array<prim::count> kept;
+  for(prim::count i = 0; i < shownPages.n(); i++)
+  {
+    prim::count index = shownPages[i];
+    Page* page = getPage(index);
+    if((index >= first && index <= last) || page == getViewer()->focusPage ||
+      page->currentEvent)
+      kept.Add(index);
+    else
+    {
+      delete page;
+      getPages()[index] = 0;
+    }
+  }
   
-  addAndMakeVisible(getPage(0));
+  for(prim::count i = first; i <= last; i++)
+  {
+    if(!getPage(i))
+    {
+      getPages()[i] = new Page(getDocument(), i);
+      addAndMakeVisible(getPage(i));
+      kept.Add(i);
+    }
+  }
+  shownPages.MoveFrom(kept);
 }
 
-Content::~Content()
+void Content::repaintScores(void)
 {
-  getPages().RemoveAndDeleteAll();
+  for(prim::count i = 0; i < shownPages.n(); i++)
+    getPage(shownPages[i])->repaintScore();
+}
+
+void Content::repaintHandles(void)
+{
+  for(prim::count i = 0; i < shownPages.n(); i++)
+    getPage(shownPages[i])->repaintHandles();
+}
+
+void Content::renderScores(void)
+{
+  prim::Array<Page*> stale;
+  for(prim::count i = 0; i < shownPages.n(); i++)
+  {
+    Page* page = getPage(shownPages[i]);
+    if(page->scoreImageIsStale())
+    {
+      page->prepareScore();
+      stale.Add(page);
+    }
+  }
+  if(!stale.n())
+    return;
+  
+  /*The pages have their own images and canvases, so they do not share
+  anything that is written while rendering. The message thread renders the
+  first page while the page painters render the rest.*/
+  juce::ThreadPool* painters = globals()->pagePainters;
+  for(prim::count i = 1; i < stale.n(); i++)
+    painters->addJob(&stale[i]->renderJob, false);
+  stale[0]->renderScore();
+  for(prim::count i = 1; i < stale.n(); i++)
+    painters->waitForJobToFinish(&stale[i]->renderJob, -1);
 }
 
 void Content::mouseMove(const juce::MouseEvent &e)
@@ -57,7 +140,7 @@ void Content::mouseMove(const juce::MouseEvent &e)
   if(!getDocument()->temporarilyHideHandles)
   {
     getDocument()->temporarilyHideHandles = true;
-    getPage(0)->repaint();
+    repaintHandles();
   }
 }
 
@@ -32,6 +32,30 @@ struct Content : public juce::Component, public DocumentHandler
 {
   Content(Document* document);
   ~Content();
+  
+  /**Brings the pages up to date with the main sections of the score, for
+  example after adding a page or changing the page size. The page components
+  are made again as they come into view.*/
+  void paginate(void);
+  
+  /**Makes components for the pages from first to last inclusive and removes
+  the rest. The page in focus and any page in the middle of an event are kept
+  so that their events can finish.*/
+  void showPages(prim::count first, prim::count last);
+  
+  ///Repaints the score on every page that has a component.
+  void repaintScores(void);
+  
+  ///Repaints the handles on every page that has a component.
+  void repaintHandles(void);
+  
+  /**Renders the score images of the shown pages that are out of date, each
+  page on its own thread. The first page to be painted does this for all of
+  them so that pages repainted together render at the same time.*/
+  void renderScores(void);
+  
+  ///Indices of the pages that have components
+  prim::Array<prim::count> shownPages;
 
   void mouseMove(const juce::MouseEvent &e);
   void paint(juce::Graphics& g);
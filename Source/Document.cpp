@@ -25,7 +25,9 @@
 
 #include "Document.h"
 
-#include "Interaction.h"
+#include "Events.h"
+#include "Journal.h"
+#include "Playback.h"
 #include "Representation.h"
 #include "Score.h"
 #include "Viewer.h"
@@ -34,12 +36,16 @@
 Document::Initialization::Initialization()
 {
   createdFromEmptyDocument = true;
+  recovered = false;
+  representation = 0;
 }
 
 Document::Initialization::Initialization(const prim::String& sourceFile,
   const prim::String& data)
 {
   createdFromEmptyDocument = false;
+  recovered = false;
+  representation = 0;
   metadata = data;
   sourceFilename = sourceFile;
 }
@@ -50,27 +56,53 @@ Document::Document(Document::Initialization* init) :
   useInches(false),
   showGrid(false),
   showFineGrid(false),
+  rhythmSeconds(10.0f),
   content(0),
   initialization(init),
   window(0),
   score(0),
   viewer(0),
-  representation(new Representation)
+  pacer(0),
+  playback(0),
+  journal(0),
+  representation(0)
 {
   score = new notation::Score(this);
   viewer = new Viewer(this);
+  pacer = new FramePacer;
+  playback = new Playback;
 
-  if(init->metadata.n())
-    representation->fromString(init->metadata);
+  //Adopt the representation if it was parsed while the file was loading.
+  if(init->representation)
+  {
+    representation = init->representation;
+    init->representation = 0;
+  }
   else
-    representation->createDefaultDocument();
+  {
+    representation = new Representation;
+    if(init->metadata.n())
+      representation->fromString(init->metadata);
+    else
+      representation->createDefaultDocument();
+  }
   filename = init->sourceFilename;
+  
+  //Bring a recovered document up to its last edit.
+  if(init->journal.n())
+    Journal::replay(representation, init->journal);
+  journal = new Journal(this);
 }
 
 Document::~Document()
 {
+  delete journal;
+  journal = 0;
   delete initialization;
-  interactions.RemoveAndDeleteAll();
+  delete pacer;
+  pacer = 0;
+  delete playback;
+  playback = 0;
 }
 
 DocumentHandler::DocumentHandler(Document* document)
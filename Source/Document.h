@@ -33,8 +33,11 @@
 
 //Forward declarations...
 struct Content;
+struct FramePacer;
 struct Interaction;
+struct Journal;
 struct Page;
+struct Playback;
 struct Window;
 struct Viewer;
 
@@ -63,6 +66,16 @@ public:
 
     prim::String sourceFilename;
     prim::String metadata;
+    
+    ///Edits to replay over the metadata when recovering from a crash
+    prim::String journal;
+    
+    ///Whether the document is being recovered from a crash
+    bool recovered;
+    
+    /**The metadata already parsed off the message thread, or null to parse
+    it when the document is made. The document takes ownership of it.*/
+    Representation* representation;
 
     Initialization();
     Initialization(const prim::String& sourceFile, const prim::String& data);
@@ -75,16 +88,29 @@ public:
   bool showGrid;
   bool showFineGrid;
   
+  ///Duration of the main section when the rhythm is played or exported
+  prim::number rhythmSeconds;
+  
   prim::String filename;
   
+  /**Record of the last PDF save, with the pages edited since then, so that
+  later saves paint and append only the changed pages*/
+  abcd::PDF::Revision lastSave;
+  
   Content* content;
   Initialization* initialization;
   Window* window;
   notation::Score* score;
   Viewer* viewer;
-  prim::List<Page*> pages;
+  FramePacer* pacer;
+  Playback* playback;
+  Journal* journal;
+  
+  /**One entry for each page of the score. Only the pages near the visible
+  part of the content have components, and the rest are null.*/
+  prim::Array<Page*> pages;
+  
   Representation* representation;
-  prim::List<Interaction*> interactions;
 
   Document(Initialization* initialization);
   ~Document();
@@ -110,10 +136,15 @@ public:
     {return document->initialization;}
   notation::Score* getScore(void){return document->score;}
   Viewer* getViewer(void){return document->viewer;}
+  FramePacer* getPacer(void){return document->pacer;}
+  Playback* getPlayback(void){return document->playback;}
+  Journal* getJournal(void){return document->journal;}
   Window* getWindow(void){return document->window;}
   
   prim::count getPageCount(void){return document->pages.n();}
-  prim::List<Page*>& getPages(void){return document->pages;}
+  prim::Array<Page*>& getPages(void){return document->pages;}
+  
+  ///Returns the component of a page, or null if it is not near the view.
   Page* getPage(prim::count i){return document->pages[i];}
   
   prim::count getCanvasCount(void);
@@ -124,8 +155,5 @@ public:
   Representation::Container* getContainer(void);
   
   void setDocumentTitle(prim::String title);
-  
-  prim::List<Interaction*>& getInteractions(void)
-    {return document->interactions;}
 };
 #endif
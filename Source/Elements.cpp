@@ -77,6 +77,28 @@ void Representation::Container::Translate(void)
   Element::Translate();
 }
 
+Representation::Section* Representation::Container::addMainSection(void)
+{
+  Section* s = new Section(0);
+  s->segments = 4;
+  s->scalarHeight = 1.0f;
+  s->scalarAccelerando = 0.0f;
+  AddObject(s);
+  return s;
+}
+
+void Representation::Container::removeMainSection(Section* section)
+{
+  for(prim::count i = Objects.n() - 1; i >= 0; i--)
+  {
+    if(Objects[i]->IsElement() == section)
+    {
+      Objects.RemoveAndDelete(i);
+      break;
+    }
+  }
+}
+
 bool Representation::Container::Interpret(void)
 {
   using namespace prim;
@@ -134,6 +156,10 @@ Representation::Section::Section(Section* parent) :
   segments = 5;
   scalarHeight = 0.6f;
   scalarAccelerando = 0.0f;
+  cachedWidth = 0.0f;
+  cachedHeight = 0.0f;
+  cachedRecurseDepth = 0;
+  cachedExponentialScale = 1.0f;
 }
 
 prim::XML::Element* Representation::Section::CreateChild(
@@ -205,3 +231,10 @@ void Representation::Section::Remove(void)
     }
   }
 }
+
+prim::math::Rectangle Representation::Section::cachedBounds(
+  prim::math::Vector pageSize)
+{
+  return prim::math::Rectangle(cachedBottomLeft.x, pageSize.y * -0.5f,
+    cachedBottomLeft.x + cachedWidth, pageSize.y * 0.5f);
+}
@@ -46,6 +46,13 @@ struct Representation::Container : public prim::XML::Element
   
   ///Default constructor (does not create child elements).
   Container();
+  
+  /**Adds a main section with default values after the last one. Each main
+  section is drawn on a page of its own.*/
+  Representation::Section* addMainSection(void);
+  
+  ///Removes a main section along with all of its children.
+  void removeMainSection(Representation::Section* section);
 
   //XML Callbacks
   prim::XML::Element* CreateChild(const prim::String& TagName);
@@ -77,6 +84,13 @@ struct Representation::Section : public prim::XML::Element
   
   void Remove(void);
   
+  /**Returns the area of the page that an edit to this section can change,
+  based on the cached data from the last paint. An edit only moves things that
+  lie between the left and right edges of the section, so the area is that
+  band over the full height of the page. Coordinates are in inches from the
+  center of the page.*/
+  prim::math::Rectangle cachedBounds(prim::math::Vector pageSize);
+  
   //XML Callbacks
   prim::XML::Element* CreateChild(const prim::String& TagName);
   void Translate(void);
@@ -28,7 +28,9 @@
 #include "Content.h"
 #include "Elements.h"
 #include "Interaction.h"
+#include "Journal.h"
 #include "Page.h"
+#include "Score.h"
 #include "Viewer.h"
 
 //-------//
@@ -61,20 +63,94 @@ void Tooltip::paint(juce::Graphics& g)
   g.drawSingleLineText(text.Merge(), 2, 14);
 }
 
+//-----------//
+//Frame Pacer//
+//-----------//
+
+void FramePacer::schedule(EventHandler* handler)
+{
+  for(prim::count i = 0; i < pending.n(); i++)
+    if(pending[i] == handler)
+      return;
+  
+  pending.Add() = handler;
+  if(!isTimerRunning())
+    startTimer(millisecondsPerFrame);
+}
+
+void FramePacer::unschedule(EventHandler* handler)
+{
+  for(prim::count i = pending.n() - 1; i >= 0; i--)
+    if(pending[i] == handler)
+      pending.Remove(i);
+}
+
+void FramePacer::apply(EventHandler* handler)
+{
+  for(prim::count i = 0; i < pending.n(); i++)
+  {
+    if(pending[i] == handler)
+    {
+      pending.Remove(i);
+      handler->applyFrame();
+      return;
+    }
+  }
+}
+
+void FramePacer::timerCallback(void)
+{
+  //Let the timer go quiet once the input has stopped.
+  if(!pending.n())
+  {
+    stopTimer();
+    return;
+  }
+  
+  while(pending.n())
+  {
+    EventHandler* handler = pending.first();
+    pending.Remove(0);
+    handler->applyFrame();
+  }
+}
+
+FramePacer::~FramePacer()
+{
+  stopTimer();
+}
+
 //--------------------//
 //Generic EventHandler//
 //--------------------//
 
 void EventHandler::stopEvent(void)
 {
+  getPacer()->unschedule(this);
   *ptrEventHandler = 0;
 }
 
+void EventHandler::requestFrame(void)
+{
+  getPacer()->schedule(this);
+}
+
+void EventHandler::applyPendingFrame(void)
+{
+  getPacer()->apply(this);
+}
+
 EventHandler::EventHandler(Document* document) : DocumentHandler(document),
   isRunning(false), ptrEventHandler(0), page(0)
 {
 }
 
+EventHandler::~EventHandler()
+{
+  if(getPacer())
+    getPacer()->unschedule(this);
+}
+
 void EventHandler::beginEvent(Page* page, EventHandler** ptrCurrentEventHandler,
                               prim::integer beginX, prim::integer beginY)
 {
@@ -96,6 +172,7 @@ void EventHandler::mouseMove(const juce::MouseEvent &e) {}
 void EventHandler::mouseDrag(const juce::MouseEvent &e) {}
 void EventHandler::mouseExit(const juce::MouseEvent &e) {}
 void EventHandler::keyPress(const juce::KeyPress &k) {}
+void EventHandler::applyFrame(void) {}
 
 //----------//
 //Drag Score//
@@ -116,6 +193,12 @@ void EventDragScore::handler(prim::integer beginX, prim::integer beginY)
 }
 
 void EventDragScore::mouseDrag(const juce::MouseEvent &e)
+{
+  //The pointer is read when the frame is applied, so just ask for one.
+  requestFrame();
+}
+
+void EventDragScore::applyFrame(void)
 {
   using namespace prim;
   using namespace math;
@@ -135,6 +218,7 @@ void EventDragScore::mouseDrag(const juce::MouseEvent &e)
 
 void EventDragScore::mouseUp(const juce::MouseEvent &e)
 {
+  applyPendingFrame();
   getDocument()->viewer->percentageZoom = oldZoom;
   getViewer()->positionPages(true);
   page->setMouseCursor(juce::MouseCursor(juce::MouseCursor::NormalCursor));
@@ -145,7 +229,8 @@ void EventDragScore::mouseUp(const juce::MouseEvent &e)
 //Drag Handle//
 //-----------//
 
-EventDragHandle::EventDragHandle(Document* document) : EventHandler(document) {}
+EventDragHandle::EventDragHandle(Document* document) : EventHandler(document),
+  dragX(0), dragY(0), edited(false), editedSection(0) {}
 
 void EventDragHandle::handler(prim::integer beginX, prim::integer beginY)
 {
@@ -153,6 +238,8 @@ void EventDragHandle::handler(prim::integer beginX, prim::integer beginY)
   
   anchorX = beginX;
   anchorY = beginY;
+  edited = false;
+  editedSection = 0;
   
   if(interaction.type == Interaction::CreateSection ||
      interaction.type == Interaction::ChangeMainSectionSegments ||
@@ -169,16 +256,27 @@ void EventDragHandle::handler(prim::integer beginX, prim::integer beginY)
   originalSegments = interaction.section->segments;
   
   tooltip = new Tooltip;
-  getPage(0)->addChildComponent(tooltip);
+  page->addChildComponent(tooltip);
+  
+  //Hide the handles for the duration of the drag.
+  getContent()->repaintHandles();
 }
 
 void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
+{
+  //Keep only the latest position until the next frame.
+  dragX = e.x;
+  dragY = e.y;
+  requestFrame();
+}
+
+void EventDragHandle::applyFrame(void)
 {
   using namespace prim;
   using namespace math;
   
-  Vector normal((number)e.x / (number)page->getWidth(),
-         (number)e.y / (number)page->getHeight());
+  Vector normal((number)dragX / (number)page->getWidth(),
+         (number)dragY / (number)page->getHeight());
   
   normal.x -= 0.5f;
   normal.y -= 0.5f;
@@ -188,6 +286,15 @@ void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
   
   normal.x *= getContainer()->sizePage.x;
   normal.y *= -getContainer()->sizePage.y;
+  
+  //The size and position of the main sections belong to the container.
+  edited = true;
+  editedSection = interaction.section;
+  if(interaction.type == Interaction::MainSectionPosition ||
+     interaction.type == Interaction::MainSectionWidth ||
+     (interaction.type == Interaction::SectionHeight &&
+      !interaction.section->parentSection))
+    editedSection = 0;
 
   if(interaction.type == Interaction::MainSectionPosition)
   {
@@ -222,8 +329,7 @@ void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
   else if(interaction.type == Interaction::SectionHeight)
   {
     Vector displace = normal - getContainer()->offsetMainSection;
-    if(interaction.section != 
-      getContainer()->GetChildOfType<Representation::Section>())
+    if(interaction.section->parentSection)
     {
       interaction.section->scalarHeight = Min((number)2.0f,
         Max((number)0.1f, displace.y / interaction.section->cachedHeight));
@@ -310,8 +416,9 @@ void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
       rs->parentSegment = interaction.segment;
       interaction.section->AddObject(rs);
     }
+    editedSection = rs;
     
-    number dist = (number)e.y - (number)anchorY;
+    number dist = (number)dragY - (number)anchorY;
     count segs = Min((count)15,
       Max((count)(dist / -20.0f + 2.0f), (count)2));
     rs->segments = segs;
@@ -320,7 +427,7 @@ void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
   }
   else if(interaction.type == Interaction::ChangeMainSectionSegments)
   {
-    number dist = (number)e.y - (number)anchorY;
+    number dist = (number)dragY - (number)anchorY;
     count segs = Min((count)15, Max((count)(dist / -20.0f) + 
       originalSegments, (count)2));
     interaction.section->segments = segs;
@@ -329,7 +436,7 @@ void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
   }
   else if(interaction.type == Interaction::DeleteSection)
   {
-    number dist = (number)e.y - (number)anchorY;
+    number dist = (number)dragY - (number)anchorY;
     count segs = Min((count)15, Max((count)(dist / -20.0f) + 
       originalSegments, (count)2));
     interaction.section->segments = segs; 
@@ -337,11 +444,25 @@ void EventDragHandle::mouseDrag(const juce::MouseEvent &e)
     tooltip->showTip((int)anchorX, (int)anchorY);
   }
   
-  getPage(0)->repaint();
+  //Let the rhythm preview follow the drag. This does nothing unless it plays.
+  getScore()->publishOnsets();
+  
+  //Repaint only the part of the page that the edit could have changed.
+  page->repaintSection(interaction.section);
 }
 
 void EventDragHandle::mouseUp(const juce::MouseEvent &e)
 {
+  applyPendingFrame();
+  
+  //Journal the state the drag left behind.
+  if(edited && editedSection)
+    getJournal()->recordSection(editedSection);
+  else if(edited)
+    getJournal()->recordContainer();
+  if(edited)
+    getScore()->sectionsChanged();
+  
   page->setMouseCursor(juce::MouseCursor(juce::MouseCursor::NormalCursor));
   delete tooltip;
   stopEvent();
@@ -352,7 +473,32 @@ void EventDragHandle::mouseUp(const juce::MouseEvent &e)
 //----------//
 
 EventZoomScore::EventZoomScore(Document* document) : 
-  EventHandler(document), oldZoom(1.0) {}
+  EventHandler(document), oldZoom(1.0), dragDistanceY(0)
+{
+  settle.zoom = this;
+}
+
+void EventZoomScore::Settle::timerCallback(void)
+{
+  zoom->settleZoom();
+}
+
+void EventZoomScore::settleZoom(void)
+{
+  settle.stopTimer();
+  if(!getViewer()->scalingSnapshots)
+    return;
+  
+  //The pages see that their size changed and render the score again.
+  getViewer()->scalingSnapshots = false;
+  getContent()->repaint();
+}
+
+void EventZoomScore::stopEvent(void)
+{
+  settleZoom();
+  EventHandler::stopEvent();
+}
 
 void EventZoomScore::handler(prim::integer beginX, prim::integer beginY)
 {
@@ -378,11 +524,18 @@ void EventZoomScore::handler(prim::integer beginX, prim::integer beginY)
 }
 
 void EventZoomScore::mouseDrag(const juce::MouseEvent &e)
+{
+  //Keep only the latest distance until the next frame.
+  dragDistanceY = (prim::number)e.getDistanceFromDragStartY();
+  requestFrame();
+}
+
+void EventZoomScore::applyFrame(void)
 {
   using namespace prim;
   using namespace math;
   
-  number dist = (number)e.getDistanceFromDragStartY();
+  number dist = dragDistanceY;
   number newZoom = oldZoom * exp(-dist / 100.0f);
 
   //Clamp the zoom.
@@ -392,12 +545,17 @@ void EventZoomScore::mouseDrag(const juce::MouseEvent &e)
   if(newZoom > 20000.0f)
     newZoom = 20000.0f;
   
+  /*Only move and resize the pages while the zoom is changing. They scale
+  what they last rendered until the zoom rests.*/
   getDocument()->viewer->percentageZoom = newZoom;
+  getViewer()->scalingSnapshots = true;
   getViewer()->positionPages(true);
+  settle.startTimer(millisecondsToSettle);
 }
 
 void EventZoomScore::mouseUp(const juce::MouseEvent &e)
 {
+  applyPendingFrame();
   getViewer()->positionPages(true);
   page->setMouseCursor(juce::MouseCursor(juce::MouseCursor::NormalCursor));
   stopEvent();
@@ -33,6 +33,7 @@
 //Forward Declarations
 struct Page;
 struct Interaction;
+class EventHandler;
 
 struct Tooltip : public juce::Component
 {
@@ -43,6 +44,34 @@ struct Tooltip : public juce::Component
   void paint(juce::Graphics& g);
 };
 
+/**Paces pointer input to the display refresh rate. An event handler stores
+the latest pointer state and asks for a frame; once per frame the pacer applies
+each waiting handler a single time, so however fast the input arrives the model
+changes and repaints happen at most once per frame. There is one pacer per
+document so that all pages share the same frame timer.*/
+struct FramePacer : public juce::Timer
+{
+  ///About sixty frames per second
+  static const int millisecondsPerFrame = 16;
+  
+  ///Handlers waiting to be applied on the next frame
+  prim::List<EventHandler*> pending;
+  
+  ///Asks for the handler to be applied on the next frame.
+  void schedule(EventHandler* handler);
+  
+  ///Forgets a waiting handler without applying it.
+  void unschedule(EventHandler* handler);
+  
+  ///Applies a waiting handler now instead of on the next frame.
+  void apply(EventHandler* handler);
+  
+  ///Applies all waiting handlers, and stops the timer after an idle frame.
+  void timerCallback(void);
+  
+  virtual ~FramePacer();
+};
+
 class EventHandler : public DocumentHandler
 {
 private:
@@ -53,6 +82,12 @@ protected:
   Page* page;
 
   virtual void stopEvent(void);
+  
+  ///Asks for applyFrame() to be called on the next display frame.
+  void requestFrame(void);
+  
+  ///Applies a frame that is still waiting, for example before a mouse up.
+  void applyPendingFrame(void);
 
 public:
   EventHandler(Document* document);
@@ -71,7 +106,11 @@ public:
   virtual void mouseDrag(const juce::MouseEvent &e);
   virtual void mouseExit(const juce::MouseEvent &e);
   virtual void keyPress(const juce::KeyPress &k);
-  virtual ~EventHandler() {}
+  
+  ///Applies the latest pointer state stored by the handler, once per frame.
+  virtual void applyFrame(void);
+  
+  virtual ~EventHandler();
 };
 
 class EventDragHandle : public EventHandler
@@ -82,11 +121,21 @@ public:
   prim::integer anchorY;
   prim::count originalSegments;
   Tooltip* tooltip;
+  
+  //Latest pointer position waiting for the next frame
+  prim::integer dragX;
+  prim::integer dragY;
+  
+  //Whether a frame changed the score, and the section it changed (or null
+  //for the container), so that the drag can be journaled when it ends
+  bool edited;
+  Representation::Section* editedSection;
 
   EventDragHandle(Document* document);
   virtual void handler(prim::integer beginX, prim::integer beginY);
   virtual void mouseDrag(const juce::MouseEvent &e);
   virtual void mouseUp(const juce::MouseEvent &e);
+  virtual void applyFrame(void);
   virtual ~EventDragHandle() {}
 };
 
@@ -100,6 +149,7 @@ public:
   virtual void handler(prim::integer beginX, prim::integer beginY);
   virtual void mouseDrag(const juce::MouseEvent &e);
   virtual void mouseUp(const juce::MouseEvent &e);
+  virtual void applyFrame(void);
   virtual ~EventDragScore() {}
 };
 
@@ -108,11 +158,34 @@ class EventZoomScore : public EventHandler
   prim::number oldZoom;
   prim::integer anchorX;
   prim::integer anchorY;
+  
+  //Latest vertical drag distance waiting for the next frame
+  prim::number dragDistanceY;
+  
+  /**Renders the pages again once the zoom has rested. Until then they only
+  scale their last rendering.*/
+  struct Settle : public juce::Timer
+  {
+    EventZoomScore* zoom;
+    void timerCallback(void);
+  };
+  Settle settle;
+  
+  ///Time the zoom has to rest before the pages are rendered again
+  static const int millisecondsToSettle = 250;
+  
+  ///Stops scaling the pages and renders them at the current zoom.
+  void settleZoom(void);
+  
+protected:
+  virtual void stopEvent(void);
+  
 public:
   EventZoomScore(Document* document);
   virtual void handler(prim::integer beginX, prim::integer beginY);
   virtual void mouseDrag(const juce::MouseEvent &e);
   virtual void mouseUp(const juce::MouseEvent &e);
+  virtual void applyFrame(void);
   virtual ~EventZoomScore() {}
 };
 #endif
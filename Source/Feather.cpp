@@ -0,0 +1,215 @@
+/*
+ ==============================================================================
+ 
+ This file is part of Blume
+ Copyright 2010 William Andrew Burnson
+ 
+ ------------------------------------------------------------------------------
+ 
+ Blume can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ 
+ Blume is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with Blume; if not, visit www.gnu.org/licenses or write to
+ the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ ==============================================================================
+ */
+
+#include "Feather.h"
+
+#include "Elements.h"
+
+using namespace prim;
+
+namespace notation
+{
+  ///An onset being merged, ordered by its position.
+  struct MergedOnset
+  {
+    number position;
+    count level;
+    
+    bool operator < (const MergedOnset& other) const
+    {
+      return position < other.position;
+    }
+  };
+  
+  void Feather::subdivide(number offset, number width, count segments,
+    number accelerando, number* boundaries)
+  {
+    boundaries[0] = offset;
+    if(segments < 1)
+      return;
+    boundaries[segments] = offset + width;
+    
+    //A nearly steady tempo is divided evenly to avoid dividing by zero.
+    if(math::Abs(accelerando) < 0.001f)
+    {
+      for(count i = 1; i < segments; i++)
+        boundaries[i] = offset + width * (number)i / (number)segments;
+      return;
+    }
+    
+    /*Each segment is d times as wide as the one before it, so boundary i lies
+    (1 - d^i) / (1 - d^n) of the way across. The powers are taken in double
+    precision so that no error builds up from segment to segment.*/
+    float64 d = accelerando > 0 ? 1.0 + (float64)accelerando :
+      1.0 / (1.0 - (float64)accelerando);
+    float64 dn = 1.0;
+    for(count i = 0; i < segments; i++)
+      dn *= d;
+    float64 scale = (float64)width / (1.0 - dn), di = 1.0;
+    for(count i = 1; i < segments; i++)
+    {
+      di *= d;
+      boundaries[i] = offset + (number)((1.0 - di) * scale);
+    }
+  }
+  
+  void Feather::flatten(Representation::Section* section, count parent,
+    number height)
+  {
+    count index = sections.n();
+    count segments = math::Max(section->segments, (count)0);
+    count firstOnset = 0;
+    if(index)
+      firstOnset = sectionOnsets[index - 1] + sectionSegments[index - 1] + 1;
+    
+    sections.Add(section);
+    sectionParents.Add(parent);
+    sectionLevels.Add(parent < 0 ? 1 : sectionLevels[parent] + 1);
+    sectionHeights.Add(height);
+    sectionOffsets.Add(0);
+    sectionWidths.Add(0);
+    sectionOnsets.Add(firstOnset);
+    sectionSegments.Add(segments);
+    sectionEnds.Add(0);
+    
+    //Children are listed last to first, the order the score paints them in.
+    const prim::List<XML::Object*>& objects = section->GetObjects();
+    for(count i = objects.n() - 1; i >= 0; i--)
+    {
+      Representation::Section* child =
+        dynamic_cast<Representation::Section*>(objects[i]->IsElement());
+      if(child && child->parentSegment >= 0 &&
+        child->parentSegment < segments)
+        flatten(child, index, height * section->scalarHeight);
+    }
+    sectionEnds[index] = sections.n();
+  }
+  
+  void Feather::evaluateRange(count first, count last)
+  {
+    for(count i = first; i <= last; i++)
+    {
+      count parent = sectionParents[i];
+      if(parent >= 0)
+      {
+        const number* b =
+          &positions[sectionOnsets[parent] + sections[i]->parentSegment];
+        sectionOffsets[i] = b[0];
+        sectionWidths[i] = b[1] - b[0];
+      }
+      
+      count onset = sectionOnsets[i], segments = sectionSegments[i];
+      subdivide(sectionOffsets[i], sectionWidths[i], segments,
+        sections[i]->scalarAccelerando, &positions[onset]);
+      for(count j = onset; j <= onset + segments; j++)
+      {
+        levels[j] = sectionLevels[i];
+        onsetSections[j] = i;
+      }
+    }
+  }
+  
+  void Feather::evaluateSubtree(count index, void* feather)
+  {
+    Feather* f = (Feather*)feather;
+    f->evaluateRange(f->subtrees[index], f->subtrees[index + 1] - 1);
+  }
+  
+  void Feather::evaluate(Representation::Section* mainSection, number offset,
+    number width)
+  {
+    sections.Clear();
+    sectionParents.Clear();
+    sectionLevels.Clear();
+    sectionHeights.Clear();
+    sectionOffsets.Clear();
+    sectionWidths.Clear();
+    sectionOnsets.Clear();
+    sectionSegments.Clear();
+    sectionEnds.Clear();
+    positions.Clear();
+    levels.Clear();
+    onsetSections.Clear();
+    subtrees.Clear();
+    if(!mainSection)
+      return;
+    
+    //Record the tree first so that the evaluation only touches flat arrays.
+    flatten(mainSection, -1, 1.0f);
+    count n = sections.n();
+    count onsetCount = sectionOnsets[n - 1] + sectionSegments[n - 1] + 1;
+    positions.n(onsetCount);
+    levels.n(onsetCount);
+    onsetSections.n(onsetCount);
+    sectionOffsets[0] = offset;
+    sectionWidths[0] = width;
+    evaluateRange(0, 0);
+    
+    /*Each child of the main section heads a contiguous run of sections that
+    depends only on the main section, so the runs can be done in parallel.*/
+    for(count i = 1; i < n; i++)
+      if(sectionParents[i] == 0)
+        subtrees.Add(i);
+    subtrees.Add(n);
+    if(onsetCount > parallelOnsets && subtrees.n() > 2)
+      Parallel::For(subtrees.n() - 1, evaluateSubtree, this);
+    else if(n > 1)
+      evaluateRange(1, n - 1);
+  }
+  
+  void Feather::merge(prim::Array<number>& mergedPositions,
+    prim::Array<count>& mergedLevels) const
+  {
+    mergedPositions.Clear();
+    mergedLevels.Clear();
+    count n = positions.n();
+    if(!n)
+      return;
+    
+    number scale = sectionWidths[0] != 0 ? 1.0f / sectionWidths[0] : 0;
+    prim::Array<MergedOnset> onsets;
+    onsets.n(n);
+    for(count i = 0; i < n; i++)
+    {
+      onsets[i].position = (positions[i] - sectionOffsets[0]) * scale;
+      onsets[i].level = levels[i];
+    }
+    onsets.Sort();
+    
+    mergedPositions.Reserve(n);
+    mergedLevels.Reserve(n);
+    for(count i = 0; i < n; i++)
+    {
+      if(mergedPositions.n() &&
+        math::Abs(onsets[i].position - mergedPositions.last()) < 0.00001f)
+      {
+        math::Decrease(mergedLevels.last(), onsets[i].level);
+        continue;
+      }
+      mergedPositions.Add(onsets[i].position);
+      mergedLevels.Add(onsets[i].level);
+    }
+  }
+}
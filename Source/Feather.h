@@ -0,0 +1,125 @@
+/*
+ ==============================================================================
+ 
+ This file is part of Blume
+ Copyright 2010 William Andrew Burnson
+ 
+ ------------------------------------------------------------------------------
+ 
+ Blume can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ 
+ Blume is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with Blume; if not, visit www.gnu.org/licenses or write to
+ the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ ==============================================================================
+ */
+
+#ifndef Feather_h
+#define Feather_h
+
+#include "Representation.h"
+
+namespace notation
+{
+  /**Evaluates a tree of beam sections into flat arrays of onsets, apart from
+  any drawing or user interface. A section divides its span into segments
+  whose widths grow or shrink geometrically with its accelerando, and each
+  child section subdivides one segment of its parent. The sections are listed
+  depth-first with each parent before its children, and each section owns a
+  contiguous run of onsets, one for each segment boundary. The results can be
+  shared by painting, playback, export and analysis without deriving the
+  geometry again.*/
+  struct Feather
+  {
+    //--------//
+    //Sections//
+    //--------//
+    
+    ///The section elements in depth-first order
+    prim::Array<Representation::Section*> sections;
+    
+    ///Index of the parent of each section, or -1 for the main section
+    prim::Array<prim::count> sectionParents;
+    
+    ///Depth of each section in the tree, starting at one
+    prim::Array<prim::count> sectionLevels;
+    
+    ///Height of each section relative to the main section
+    prim::Array<prim::number> sectionHeights;
+    
+    ///Left edge of each section
+    prim::Array<prim::number> sectionOffsets;
+    
+    ///Width of each section
+    prim::Array<prim::number> sectionWidths;
+    
+    ///Index of the first onset of each section
+    prim::Array<prim::count> sectionOnsets;
+    
+    ///Number of segments of each section
+    prim::Array<prim::count> sectionSegments;
+    
+    ///One past the index of the last section in the subtree of each section
+    prim::Array<prim::count> sectionEnds;
+    
+    //------//
+    //Onsets//
+    //------//
+    
+    ///Position of each onset
+    prim::Array<prim::number> positions;
+    
+    ///Depth of the section that each onset belongs to
+    prim::Array<prim::count> levels;
+    
+    ///Index of the section that each onset belongs to
+    prim::Array<prim::count> onsetSections;
+    
+    ///Number of onsets above which subtrees are evaluated in parallel
+    static const prim::count parallelOnsets = 1024 * 16;
+    
+    /**Evaluates the tree of the main section spanning the given width from
+    the given offset. Sections whose parent segment does not exist are left
+    out along with their children.*/
+    void evaluate(Representation::Section* mainSection, prim::number offset,
+      prim::number width);
+    
+    /**Lists the onsets in ascending order as fractions of the main section.
+    Onsets that coincide are merged, keeping the shallowest level.*/
+    void merge(prim::Array<prim::number>& mergedPositions,
+      prim::Array<prim::count>& mergedLevels) const;
+    
+    /**Computes the segment boundaries of a span. The boundaries array holds
+    one more value than there are segments. The first and last boundaries are
+    the edges of the span exactly, and the widths of the segments form a
+    geometric series so the boundaries are given in closed form.*/
+    static void subdivide(prim::number offset, prim::number width,
+      prim::count segments, prim::number accelerando,
+      prim::number* boundaries);
+    
+  private:
+    ///Lists a section and its children, recording the tree structure.
+    void flatten(Representation::Section* section, prim::count parent,
+      prim::number height);
+    
+    ///Evaluates a contiguous run of sections whose parents are already done.
+    void evaluateRange(prim::count first, prim::count last);
+    
+    ///Evaluates the subtree of one child of the main section.
+    static void evaluateSubtree(prim::count index, void* feather);
+    
+    ///First section of each subtree of the main section, and one past the end
+    prim::Array<prim::count> subtrees;
+  };
+}
+
+#endif
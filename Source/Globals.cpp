@@ -39,6 +39,8 @@ Blume::Globals::Globals(Blume* ptrApplication) :
   pixelsEdgeOfPageToDisplay(5),
   pixelsHorizontalDistanceBetweenPages(5),
   commandManager(0),
+  documentLoaders(0),
+  pagePainters(0),
   dontLetApplicationQuitBecauseOfNoWindowsOpen(false)
 {
   //Set the pointer to this globals class so other initialization can use it.
@@ -47,6 +49,10 @@ Blume::Globals::Globals(Blume* ptrApplication) :
   //Create an application command manager and register commands for it.
   commandManager = new juce::ApplicationCommandManager;
   commandManager->registerAllCommandsForTarget(application->getInstance());
+  
+  //Create one document loader and one page painter for each processor.
+  documentLoaders = new juce::ThreadPool((int)prim::Parallel::Processors());
+  pagePainters = new juce::ThreadPool((int)prim::Parallel::Processors());
 }
 
 Blume::Globals* globals(void)
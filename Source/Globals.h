@@ -46,6 +46,12 @@ struct Blume::Globals
   prim::List<Window*> listWindows;
 
   juce::ApplicationCommandManager* commandManager;
+  
+  ///Worker threads that read and parse documents being opened
+  juce::ThreadPool* documentLoaders;
+  
+  ///Worker threads that render the score images of pages
+  juce::ThreadPool* pagePainters;
 
   void addWindow(Window* window);
   
@@ -56,6 +62,10 @@ struct Blume::Globals
   Globals(Blume* ptrApplication);
   ~Globals()
   {
+    //Wait for documents still loading before anything else goes away.
+    delete documentLoaders;
+    delete pagePainters;
+    
     //Delete the application command manager.
     delete commandManager;
   }
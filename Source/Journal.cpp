@@ -0,0 +1,489 @@
+/*
+ ==============================================================================
+ 
+ This file is part of Blume
+ Copyright 2010 William Andrew Burnson
+ 
+ ------------------------------------------------------------------------------
+ 
+ Blume can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ 
+ Blume is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with Blume; if not, visit www.gnu.org/licenses or write to
+ the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ ==============================================================================
+ */
+
+#include "Journal.h"
+
+#include "Elements.h"
+
+///Lock held on the folder of this session while the application runs
+static juce::InterProcessLock* sessionLock = 0;
+
+///Folder that holds the files of the documents of this session
+static juce::File sessionFolder;
+
+///Folders of abandoned sessions and the locks held on them until recovered
+static juce::Array<juce::File> abandonedFolders;
+static juce::OwnedArray<juce::InterProcessLock> abandonedLocks;
+
+Journal::Journal(Document* document) : juce::Thread("Journal"),
+  DocumentHandler(document), current(0), hasSnapshot(false),
+  operationsSinceSnapshot(0), lastSnapshotTime(0), replica(0), generation(0)
+{
+  juce::String name = juce::Uuid().toString();
+  snapshotFile = getSessionFolder().getChildFile(name + ".xml");
+  journalFile = getSessionFolder().getChildFile(name + ".journal");
+  startThread();
+  startTimer(millisecondsPerBatch);
+  
+  //A recovered document is written out at once in case of another crash.
+  if(getInitialization()->recovered)
+  {
+    snapshot();
+    handOver();
+  }
+}
+
+Journal::~Journal()
+{
+  stopTimer();
+  signalThreadShouldExit();
+  notify();
+  stopThread(4000);
+  delete pending.exchange(0);
+  delete current;
+  delete replica;
+  
+  //The document closed normally, so there is nothing to recover.
+  snapshotFile.deleteFile();
+  journalFile.deleteFile();
+}
+
+juce::File Journal::getRecoveryFolder(void)
+{
+  juce::File folder = juce::File::getSpecialLocation(
+    juce::File::userApplicationDataDirectory).getChildFile(
+    "Blume").getChildFile("Recovery");
+  folder.createDirectory();
+  return folder;
+}
+
+juce::File Journal::getSessionFolder(void)
+{
+  if(!sessionLock)
+  {
+    sessionFolder = getRecoveryFolder().getChildFile(
+      juce::Uuid().toString());
+    sessionFolder.createDirectory();
+    sessionLock = new juce::InterProcessLock(getLockName(sessionFolder));
+    sessionLock->enter();
+  }
+  return sessionFolder;
+}
+
+juce::String Journal::getLockName(const juce::File& folder)
+{
+  return "Blume-Recovery-" + folder.getFileName();
+}
+
+//--------------//
+//Message Thread//
+//--------------//
+
+void Journal::appendPath(prim::String& s, Representation::Section* section)
+{
+  //Find the index of each section among its siblings, from the bottom up.
+  prim::Array<prim::count> indices;
+  for(Representation::Section* c = section; c; c = c->parentSection)
+  {
+    prim::XML::Element* parent = c->parentSection;
+    if(!parent)
+      parent = getContainer();
+    prim::count i = 0;
+    while(parent->GetChildOfType<Representation::Section>(i) != c)
+      i++;
+    indices.Add(i);
+  }
+  
+  for(prim::count i = indices.n() - 1; i >= 0; i--)
+  {
+    s &= (prim::integer)indices[i];
+    if(i)
+      s &= "/";
+  }
+}
+
+void Journal::markPageChanged(Representation::Section* section)
+{
+  //Each page draws one main section and everything beneath it.
+  Representation::Section* main = section;
+  while(main->parentSection)
+    main = main->parentSection;
+  
+  Representation::Container* c = getContainer();
+  prim::count n = c->CountChildrenOfType<Representation::Section>();
+  prim::count page = 0;
+  while(page < n && c->GetChildOfType<Representation::Section>(page) != main)
+    page++;
+  getDocument()->lastSave.PageChanged(page);
+}
+
+void Journal::record(const prim::String& operation)
+{
+  //The first edit captures the state the journal applies to.
+  if(!hasSnapshot)
+    snapshot();
+  
+  if(!current)
+    current = new Batch;
+  current->operations &= operation;
+  current->operations++;
+  operationsSinceSnapshot++;
+}
+
+void Journal::recordContainer(void)
+{
+  Representation::Container* c = getContainer();
+  prim::number values[11] = {c->sizePage.x, c->sizePage.y,
+    c->sizeMainSection.x, c->sizeMainSection.y, c->offsetMainSection.x,
+    c->offsetMainSection.y, c->sizeGrid.x, c->sizeGrid.y, c->sizeSubgrid.x,
+    c->sizeSubgrid.y, c->scalarBeamSlant};
+  getDocument()->lastSave.AllPagesChanged();
+  
+  prim::String s = "container";
+  for(prim::count i = 0; i < 11; i++)
+  {
+    s &= " ";
+    s.AppendNumber(values[i], 7);
+  }
+  record(s);
+}
+
+void Journal::recordSection(Representation::Section* section)
+{
+  prim::String s = "section ";
+  appendPath(s, section);
+  s &= " ";
+  s &= (prim::integer)section->parentSegment;
+  s &= " ";
+  s &= (prim::integer)section->segments;
+  s &= " ";
+  s.AppendNumber(section->scalarHeight, 7);
+  s &= " ";
+  s.AppendNumber(section->scalarAccelerando, 7);
+  record(s);
+  markPageChanged(section);
+}
+
+void Journal::recordRemoval(Representation::Section* section)
+{
+  prim::String s = "remove ";
+  appendPath(s, section);
+  record(s);
+  
+  //Removing a main section moves the pages after it.
+  if(section->parentSection)
+    markPageChanged(section);
+  else
+    getDocument()->lastSave.AllPagesChanged();
+}
+
+void Journal::recordFilename(void)
+{
+  prim::String s = "file ";
+  s &= getDocument()->filename;
+  record(s);
+}
+
+void Journal::snapshot(void)
+{
+  if(!current)
+    current = new Batch;
+  
+  //The snapshot will contain the operations waiting in the batch.
+  current->earlier &= current->operations;
+  current->operations.Clear();
+  current->snapshot = true;
+  current->filename = getDocument()->filename;
+  hasSnapshot = true;
+  operationsSinceSnapshot = 0;
+  lastSnapshotTime = juce::Time::getMillisecondCounter();
+}
+
+void Journal::handOver(void)
+{
+  //Keep collecting if the background thread has not taken the last batch.
+  if(!current || pending.get())
+    return;
+  pending.set(current);
+  current = 0;
+  notify();
+}
+
+void Journal::timerCallback(void)
+{
+  juce::uint32 elapsed = juce::Time::getMillisecondCounter() -
+    lastSnapshotTime;
+  if(operationsSinceSnapshot >= operationsPerSnapshot ||
+    (operationsSinceSnapshot > 0 && elapsed >= millisecondsPerSnapshot))
+      snapshot();
+  handOver();
+}
+
+//--------//
+//Recovery//
+//--------//
+
+void Journal::findAbandonedSessions(juce::Array<juce::File>& folders)
+{
+  juce::Array<juce::File> sessions;
+  getRecoveryFolder().findChildFiles(sessions, juce::File::findDirectories,
+    false);
+  
+  for(int i = 0; i < sessions.size(); i++)
+  {
+    //A session that is still running holds the lock on its folder.
+    if(sessionLock && sessions[i] == sessionFolder)
+      continue;
+    juce::InterProcessLock* lock =
+      new juce::InterProcessLock(getLockName(sessions[i]));
+    if(!lock->enter(0))
+    {
+      delete lock;
+      continue;
+    }
+    
+    juce::Array<juce::File> snapshots;
+    sessions[i].findChildFiles(snapshots, juce::File::findFiles, false,
+      "*.xml");
+    if(!snapshots.size())
+    {
+      sessions[i].deleteRecursively();
+      delete lock;
+      continue;
+    }
+    abandonedFolders.add(sessions[i]);
+    abandonedLocks.add(lock);
+    folders.add(sessions[i]);
+  }
+}
+
+void Journal::releaseSession(const juce::File& folder)
+{
+  folder.deleteRecursively();
+  int i = abandonedFolders.indexOf(folder);
+  if(i < 0)
+    return;
+  abandonedFolders.remove(i);
+  abandonedLocks.remove(i);
+}
+
+void Journal::endSession(void)
+{
+  abandonedFolders.clear();
+  abandonedLocks.clear();
+  if(!sessionLock)
+    return;
+  sessionFolder.deleteRecursively();
+  delete sessionLock;
+  sessionLock = 0;
+}
+
+//----------//
+//Any Thread//
+//----------//
+
+void Journal::recover(const juce::File& folder,
+  prim::List<Document::Initialization*>& documents)
+{
+  juce::Array<juce::File> snapshots;
+  folder.findChildFiles(snapshots, juce::File::findFiles, false, "*.xml");
+  
+  for(int i = 0; i < snapshots.size(); i++)
+  {
+    /*The snapshot starts with a line giving its number and a line giving the
+    file of the document, followed by the metadata.*/
+    juce::String snapshot = snapshots[i].loadFileAsString();
+    int firstBreak = snapshot.indexOfChar('\n');
+    int secondBreak = snapshot.indexOfChar(firstBreak + 1, '\n');
+    juce::String header = snapshot.substring(0, firstBreak);
+    juce::String fileLine = snapshot.substring(firstBreak + 1, secondBreak);
+    if(firstBreak < 0 || secondBreak < 0 || !header.startsWith("generation ")
+      || !fileLine.startsWith("file "))
+        continue;
+    prim::String filename = fileLine.substring(5).toRawUTF8();
+    prim::String data = snapshot.substring(secondBreak + 1).toRawUTF8();
+    
+    /*Replay the journal only if it belongs to this snapshot, and only up to
+    its last complete line.*/
+    juce::String operations =
+      snapshots[i].withFileExtension("journal").loadFileAsString();
+    int headerEnd = operations.indexOfChar('\n');
+    if(headerEnd < 0 || operations.substring(0, headerEnd) != header)
+      operations = juce::String::empty;
+    else
+      operations = operations.substring(headerEnd + 1,
+        operations.lastIndexOfChar('\n') + 1);
+    
+    //The last file named by the journal is the one the document saves to.
+    juce::StringArray lines = juce::StringArray::fromLines(operations);
+    for(int j = 0; j < lines.size(); j++)
+      if(lines[j].startsWith("file "))
+        filename = lines[j].substring(5).toRawUTF8();
+    
+    Document::Initialization* init =
+      new Document::Initialization(filename, data);
+    init->journal = operations.toRawUTF8();
+    init->recovered = true;
+    documents.Add() = init;
+  }
+}
+
+/**Finds the section at a path of child indices from the container. If the
+last index is one past the end, a section is added there.*/
+static Representation::Section* findSection(Representation::Container* c,
+  const juce::String& path)
+{
+  juce::StringArray indices = juce::StringArray::fromTokens(path, "/", "");
+  Representation::Section* s = 0;
+  for(int i = 0; i < indices.size(); i++)
+  {
+    prim::XML::Element* parent = s;
+    if(!parent)
+      parent = c;
+    prim::count index = (prim::count)indices[i].getLargeIntValue();
+    prim::count n = parent->CountChildrenOfType<Representation::Section>();
+    if(index < n)
+      s = parent->GetChildOfType<Representation::Section>(index);
+    else if(index == n && i == indices.size() - 1)
+    {
+      if(!s)
+        return c->addMainSection();
+      Representation::Section* child = new Representation::Section(s);
+      s->AddObject(child);
+      return child;
+    }
+    else
+      return 0;
+  }
+  return s;
+}
+
+void Journal::replay(Representation* representation,
+  prim::String& operations)
+{
+  Representation::Container* c = representation->getContainer();
+  juce::StringArray lines = juce::StringArray::fromLines(
+    juce::String::fromUTF8(operations.Merge()));
+  
+  for(int i = 0; i < lines.size(); i++)
+  {
+    juce::StringArray t = juce::StringArray::fromTokens(lines[i], " ", "");
+    if(t[0] == "container" && t.size() == 12)
+    {
+      c->sizePage.x = t[1].getFloatValue();
+      c->sizePage.y = t[2].getFloatValue();
+      c->sizeMainSection.x = t[3].getFloatValue();
+      c->sizeMainSection.y = t[4].getFloatValue();
+      c->offsetMainSection.x = t[5].getFloatValue();
+      c->offsetMainSection.y = t[6].getFloatValue();
+      c->sizeGrid.x = t[7].getFloatValue();
+      c->sizeGrid.y = t[8].getFloatValue();
+      c->sizeSubgrid.x = t[9].getFloatValue();
+      c->sizeSubgrid.y = t[10].getFloatValue();
+      c->scalarBeamSlant = t[11].getFloatValue();
+    }
+    else if(t[0] == "section" && t.size() == 6)
+    {
+      if(Representation::Section* s = findSection(c, t[1]))
+      {
+        s->parentSegment = (prim::count)t[2].getLargeIntValue();
+        s->segments = (prim::count)t[3].getLargeIntValue();
+        s->scalarHeight = t[4].getFloatValue();
+        s->scalarAccelerando = t[5].getFloatValue();
+      }
+    }
+    else if(t[0] == "remove" && t.size() == 2)
+    {
+      Representation::Section* s = findSection(c, t[1]);
+      if(s && s->parentSection)
+        s->Remove();
+      else if(s)
+        c->removeMainSection(s);
+    }
+  }
+}
+
+//-----------------//
+//Background Thread//
+//-----------------//
+
+void Journal::createReplica(void)
+{
+  //Repeat what the document did when it was made.
+  Document::Initialization* init = getInitialization();
+  replica = new Representation;
+  if(init->metadata.n())
+    replica->fromString(init->metadata);
+  else
+    replica->createDefaultDocument();
+  if(init->journal.n())
+    replay(replica, init->journal);
+}
+
+void Journal::write(Batch* batch)
+{
+  if(!replica)
+    createReplica();
+  replay(replica, batch->earlier);
+  
+  juce::String operations = juce::String::fromUTF8(batch->operations.Merge());
+  if(!batch->snapshot)
+    journalFile.appendText(operations, false, false);
+  else
+  {
+    prim::String header = "generation ";
+    header &= (prim::integer)++generation;
+    header++;
+    
+    /*Replacing the snapshot is atomic. If the journal is not replaced after
+    it, the old journal no longer matches and is ignored on recovery.*/
+    prim::String s = header;
+    s &= "file ";
+    s &= batch->filename;
+    s++;
+    prim::String metadata;
+    replica->toString(metadata);
+    s &= metadata;
+    snapshotFile.replaceWithText(juce::String::fromUTF8(s.Merge()), false,
+      false);
+    journalFile.replaceWithText(juce::String::fromUTF8(header.Merge()) +
+      operations, false, false);
+  }
+  
+  replay(replica, batch->operations);
+}
+
+void Journal::run(void)
+{
+  while(!threadShouldExit())
+  {
+    wait(millisecondsPerBatch);
+    if(Batch* batch = pending.exchange(0))
+    {
+      write(batch);
+      delete batch;
+    }
+  }
+}
@@ -0,0 +1,201 @@
+/*
+ ==============================================================================
+ 
+ This file is part of Blume
+ Copyright 2010 William Andrew Burnson
+ 
+ ------------------------------------------------------------------------------
+ 
+ Blume can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ 
+ Blume is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with Blume; if not, visit www.gnu.org/licenses or write to
+ the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ ==============================================================================
+ */
+
+#ifndef Journal_h
+#define Journal_h
+
+#include "Document.h"
+
+/**Keeps a write-ahead journal of the edits to a document so that they can be
+recovered after a crash. Each edit is recorded on the message thread as one
+short line of text describing the new state of the container or of a section,
+and the lines are collected into a batch. About once a second the batch is
+handed to a background thread through a single-slot mailbox, and that thread
+appends it to the journal file, so the message thread never touches the disk.
+The background thread also replays each batch over a copy of the
+representation of its own, and every so often it writes that copy out as a
+full snapshot and starts the journal over, so the message thread never
+serializes the document either. Each snapshot is numbered, and its journal
+begins with the same number, so a journal left over from an older snapshot is
+never replayed over a newer one.
+
+The files of each session of the application live in a folder of their own,
+guarded by a lock held for as long as the session runs. The files of a
+document are removed when it closes, so a folder whose lock is free at startup
+belongs to a session that did not finish, while the folders of other running
+instances are left alone. Each operation sets a state rather than changing it,
+so replaying an operation that the snapshot already contains has no effect.*/
+struct Journal :
+  public juce::Thread,
+  public juce::Timer,
+  public DocumentHandler
+{
+  ///Time between handing batches to the background thread
+  static const int millisecondsPerBatch = 1000;
+  
+  ///Time between snapshots while the document is being edited
+  static const int millisecondsPerSnapshot = 60000;
+  
+  ///Number of operations after which a snapshot is taken anyway
+  static const prim::count operationsPerSnapshot = 500;
+  
+  /**Starts a journal for the document. The files are only written once the
+  document is first edited, unless the document was itself recovered.*/
+  Journal(Document* document);
+  
+  ///Stops the background thread and removes the files of the document.
+  ~Journal();
+  
+  //--------------//
+  //Message Thread//
+  //--------------//
+  
+  /**Records the sizes and offsets of the container. Since they apply to
+  every page, every page is marked as changed for the next save.*/
+  void recordContainer(void);
+  
+  /**Records the state of a section and marks its page as changed for the
+  next save. A section that has just been added is created again when the
+  journal is replayed.*/
+  void recordSection(Representation::Section* section);
+  
+  /**Records that a section is about to be removed along with its children,
+  and marks the pages that this changes for the next save.*/
+  void recordRemoval(Representation::Section* section);
+  
+  ///Records the file the document is saved to.
+  void recordFilename(void);
+  
+  ///Hands the waiting batch to the background thread and takes snapshots.
+  void timerCallback(void);
+  
+  /**Takes the locks of the sessions that did not finish and returns their
+  folders. Folders without any documents are removed at once.*/
+  static void findAbandonedSessions(juce::Array<juce::File>& folders);
+  
+  /**Releases the lock of an abandoned session and removes its folder, once
+  its documents have been reopened with journals of their own.*/
+  static void releaseSession(const juce::File& folder);
+  
+  ///Releases the lock of this session and removes its folder.
+  static void endSession(void);
+  
+  //----------//
+  //Any Thread//
+  //----------//
+  
+  /**Collects the documents left behind in the folder of an abandoned session,
+  each with the snapshot as its metadata and the journal to replay. A journal
+  that does not begin with the number of its snapshot is ignored.*/
+  static void recover(const juce::File& folder,
+    prim::List<Document::Initialization*>& documents);
+  
+  ///Applies the operations of a journal to a representation.
+  static void replay(Representation* representation,
+    prim::String& operations);
+  
+  //-----------------//
+  //Background Thread//
+  //-----------------//
+  
+  ///Writes each batch handed over by the message thread.
+  void run(void);
+  
+private:
+  ///Operations and possibly a request for a snapshot on their way to the disk
+  struct Batch
+  {
+    ///Whether to write a snapshot after the earlier operations
+    bool snapshot;
+    
+    ///File the document saves to at the time of the snapshot
+    prim::String filename;
+    
+    ///Operations that the snapshot already contains
+    prim::String earlier;
+    
+    ///Journal lines that follow the snapshot or the previous batch
+    prim::String operations;
+    
+    Batch() : snapshot(false) {}
+  };
+  
+  ///Batch being collected on the message thread
+  Batch* current;
+  
+  ///Batch waiting for the background thread to write it
+  juce::Atomic<Batch*> pending;
+  
+  ///Snapshot file and journal file of this document
+  juce::File snapshotFile;
+  juce::File journalFile;
+  
+  ///Whether a snapshot has been taken since the journal started
+  bool hasSnapshot;
+  
+  ///Operations recorded since the last snapshot
+  prim::count operationsSinceSnapshot;
+  
+  ///Time of the last snapshot in milliseconds
+  juce::uint32 lastSnapshotTime;
+  
+  ///Copy of the representation kept up to date by the background thread
+  Representation* replica;
+  
+  ///Number of the last snapshot written by the background thread
+  prim::count generation;
+  
+  ///Returns the folder that holds the folders of all sessions.
+  static juce::File getRecoveryFolder(void);
+  
+  ///Returns the folder of this session, taking its lock the first time.
+  static juce::File getSessionFolder(void);
+  
+  ///Returns the name of the lock that guards the folder of a session.
+  static juce::String getLockName(const juce::File& folder);
+  
+  ///Writes the path of a section as child indices from the container.
+  void appendPath(prim::String& s, Representation::Section* section);
+  
+  ///Marks the page of a section as changed for the next save.
+  void markPageChanged(Representation::Section* section);
+  
+  ///Adds a line to the current batch, taking a first snapshot if needed.
+  void record(const prim::String& operation);
+  
+  ///Asks the background thread for a snapshot after the waiting operations.
+  void snapshot(void);
+  
+  ///Hands the current batch to the background thread if it is free.
+  void handOver(void);
+  
+  ///Builds the replica from the document as the journal found it.
+  void createReplica(void);
+  
+  ///Writes one batch to the files.
+  void write(Batch* batch);
+};
+
+#endif
@@ -34,8 +34,112 @@
 #include "Main.h"
 
 #include "Globals.h"
+#include "Journal.h"
+#include "Representation.h"
 #include "Window.h"
 
+///Opens the window of a loaded document on the message thread.
+struct DocumentLoaded : public juce::CallbackMessage
+{
+  Document::Initialization* initialization;
+  
+  DocumentLoaded(Document::Initialization* initialization) :
+    initialization(initialization) {}
+  
+  ~DocumentLoaded()
+  {
+    //Only happens if the application quit before the message arrived.
+    if(initialization)
+    {
+      delete initialization->representation;
+      delete initialization;
+    }
+  }
+  
+  void messageCallback(void)
+  {
+    if(!globals())
+      return;
+    new Window(initialization);
+    initialization = 0;
+  }
+};
+
+/**Reads one file, extracts its metadata and parses it on a worker thread,
+then hands the document to the message thread to open its window.*/
+struct DocumentLoader : public juce::ThreadPoolJob
+{
+  prim::String file;
+  
+  DocumentLoader(const juce::String& file) :
+    juce::ThreadPoolJob("Document Loader"), file(file.toRawUTF8()) {}
+  
+  JobStatus runJob(void)
+  {
+    prim::String metadata;
+    juce::String name = file.Merge();
+    int startIndex = name.length() - 4;
+    if(startIndex > 0)
+    {
+      juce::String extension = name.substring(startIndex).toLowerCase();
+      if(extension == juce::String(".pdf"))
+        abcd::PDF::RetrievePDFMetadataAsString(file, metadata);
+      else if(extension == juce::String(".xml"))
+        prim::File::ReadAsUTF8(file, metadata);
+    }
+    if(!metadata.n() || shouldExit())
+      return jobHasFinished;
+    
+    Document::Initialization* init =
+      new Document::Initialization(file, metadata);
+    init->representation = new Representation;
+    init->representation->fromString(init->metadata);
+    (new DocumentLoaded(init))->post();
+    return jobHasFinished;
+  }
+};
+
+///Releases an abandoned session once its documents have been opened.
+struct SessionRecovered : public juce::CallbackMessage
+{
+  juce::File folder;
+  
+  SessionRecovered(const juce::File& folder) : folder(folder) {}
+  
+  void messageCallback(void)
+  {
+    if(globals())
+      Journal::releaseSession(folder);
+  }
+};
+
+/**Reads and parses the documents of a session that did not finish on a
+worker thread, then hands each one to the message thread to open its window.*/
+struct SessionRecoverer : public juce::ThreadPoolJob
+{
+  juce::File folder;
+  
+  SessionRecoverer(const juce::File& folder) :
+    juce::ThreadPoolJob("Session Recoverer"), folder(folder) {}
+  
+  JobStatus runJob(void)
+  {
+    prim::List<Document::Initialization*> recovered;
+    Journal::recover(folder, recovered);
+    for(prim::count i = 0; i < recovered.n(); i++)
+    {
+      Document::Initialization* init = recovered[i];
+      init->representation = new Representation;
+      init->representation->fromString(init->metadata);
+      (new DocumentLoaded(init))->post();
+    }
+    
+    //Posted last so that the documents have their own journals by then.
+    (new SessionRecovered(folder))->post();
+    return jobHasFinished;
+  }
+};
+
 ///Initializes the application with a splash screen and a single window.
 void Blume::initialise(const juce::String& commandLine)
 {
@@ -45,7 +149,16 @@ void Blume::initialise(const juce::String& commandLine)
   if(!globals)
   {
     globals = new Globals(this);
-    new Window(new Document::Initialization());
+    
+    //Reopen the documents of the sessions that did not finish.
+    juce::Array<juce::File> sessions;
+    Journal::findAbandonedSessions(sessions);
+    for(int i = 0; i < sessions.size(); i++)
+      globals->documentLoaders->addJob(new SessionRecoverer(sessions[i]),
+        true);
+    
+    if(!sessions.size())
+      new Window(new Document::Initialization());
   }
 }
 
@@ -53,6 +166,8 @@ void Blume::initialise(const juce::String& commandLine)
 void Blume::shutdown()
 {
   delete globals;
+  globals = 0;
+  Journal::endSession();
 }
 
 ///Removes all windows from view and goes through the quitting procedure.
@@ -78,28 +193,10 @@ void Blume::anotherInstanceStarted(const juce::String& commandLine)
     return;
   }
 
+  //Load the files side by side. Each window opens as its document is ready.
   for(int i = 0; i < size; i++)
-    droppedfiles.set(i, droppedfiles[i].unquoted());
-
-	for(int i = 0; i < droppedfiles.size(); i++)
-  {
-    juce::String j_file = droppedfiles[i];
-    prim::String file = j_file.toRawUTF8();
-    prim::String metadata;
-    
-    int startIndex = j_file.length() - 4;
-    if(startIndex > 0)
-    {
-      juce::String extension = j_file.substring(startIndex).toLowerCase();
-      if(extension == juce::String(".pdf"))
-        abcd::PDF::RetrievePDFMetadataAsString(file, metadata);
-      else if(extension == juce::String(".xml"))
-        prim::File::ReadAsUTF8(file, metadata);
-    }
-      
-    if(metadata.n())
-      new Window(new Document::Initialization(file, metadata));
-  }
+    globals->documentLoaders->addJob(
+      new DocumentLoader(droppedfiles[i].unquoted()), true);
 }
 
 //Start Blume using the JUCE macro.
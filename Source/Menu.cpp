@@ -69,6 +69,8 @@ juce::PopupMenu Menu::getMenuForIndex(int index,
     menu.addCommandItem(acm, Commands::FileSaveAs);
     //menu.addCommandItem(acm, Commands::FileSaveAsXML);
     menu.addSeparator();
+    menu.addCommandItem(acm, Commands::FileExportClickTrack);
+    menu.addSeparator();
     menu.addCommandItem(acm, Commands::FileQuit);
   }
   else if(name == String("View"))
@@ -78,6 +80,8 @@ juce::PopupMenu Menu::getMenuForIndex(int index,
     menu.addSeparator();  
     menu.addCommandItem(acm, Commands::ViewUseCentimeters);
     menu.addCommandItem(acm, Commands::ViewUseInches);
+    menu.addSeparator();
+    menu.addCommandItem(acm, Commands::ViewPreviewRhythm);
   }
   else if(name == String("Page"))
   {
@@ -90,6 +94,9 @@ juce::PopupMenu Menu::getMenuForIndex(int index,
     menu.addCommandItem(acm, Commands::PageA3);
     menu.addCommandItem(acm, Commands::PageTabloid);
     menu.addCommandItem(acm, Commands::PageB3);
+    menu.addSeparator();
+    menu.addCommandItem(acm, Commands::PageAddPage);
+    menu.addCommandItem(acm, Commands::PageRemovePage);
   }
   
   return menu;
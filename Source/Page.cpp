@@ -25,42 +25,72 @@
  
 #include "Page.h"
 
+#include "Content.h"
 #include "Dialogs.h"
 #include "Elements.h"
 #include "Interaction.h"
+#include "Journal.h"
 #include "Renderer.h"
 #include "Score.h"
 #include "Viewer.h"
 
-Page::Page(Document* document) : DocumentHandler(document),
-  currentEvent(0), eventDragHandle(document), eventDragScore(document), eventZoomScore(document)
+Page::Page(Document* document, prim::count pageIndex) :
+  DocumentHandler(document), pageIndex(pageIndex), scoreImagePageWidth(0),
+  scoreCanvas(0), renderJob(this), overlay(document, this), currentEvent(0),
+  eventDragHandle(document), eventDragScore(document), eventZoomScore(document)
 {
+  overlay.setInterceptsMouseClicks(false, false);
+  addAndMakeVisible(&overlay);
 }
 
 Page::~Page()
 {
 }
 
+//-------------//
+//HandleOverlay//
+//-------------//
+HandleOverlay::HandleOverlay(Document* document, Page* page) :
+  DocumentHandler(document), page(page)
+{
+}
+
+void HandleOverlay::paint(juce::Graphics& g)
+{
+  if(getDocument()->temporarilyHideHandles)
+    return;
+  
+  Renderer::Properties properties;
+  properties.graphicsContext = &g;
+  properties.componentContext = this;
+  properties.canvas = getCanvas(page->getPageIndex());
+  properties.indexOfLayer = notation::Score::Page::handleLayer;
+  getScore()->Create<Renderer>(&properties);
+}
+
 //-------//
 //Helpers//
 //-------//
 prim::count Page::getPageIndex(void)
 {
-  for(prim::count i = 0; i < getPageCount(); i++)
-    if(getPage(i) == this)
-      return i;
+  return pageIndex;
+}
 
-  return -1; //This shouldn't happen!
+prim::List<Interaction*>& Page::getInteractions(void)
+{
+  return static_cast<notation::Score::Page*>(
+    getCanvas(pageIndex))->interactions;
 }
 
-void Page::paint(juce::Graphics& g)
+void Page::paintScore(juce::Graphics& g)
 {
   using namespace prim;
   Renderer::Properties properties;
 
   properties.graphicsContext = &g;
   properties.componentContext = this;
-  properties.indexOfCanvas = getPageIndex();
+  properties.canvas = scoreCanvas;
+  properties.visibleArea = scoreVisibleArea;
   
   g.fillAll(juce::Colours::white);
   g.setColour(juce::Colours::black);
@@ -70,10 +100,121 @@ void Page::paint(juce::Graphics& g)
   getScore()->Create<Renderer>(&properties);
 }
 
+void Page::paint(juce::Graphics& g)
+{
+  //Only the part of the page inside the content area is ever seen.
+  juce::Rectangle<int> visible = getViewer()->visiblePixels(this);
+  if(visible.isEmpty())
+    return;
+  
+  //While zooming, scale the last rendering rather than making a new one.
+  if(getViewer()->scalingSnapshots && getWidth() != scoreImagePageWidth)
+  {
+    paintScaledScore(g);
+    return;
+  }
+  
+  //Render this page together with any others waiting to be painted.
+  if(scoreImageIsStale())
+    getContent()->renderScores();
+  
+  g.drawImageAt(scoreImage, visible.getX(), visible.getY());
+}
+
+bool Page::scoreImageIsStale(void)
+{
+  juce::Rectangle<int> visible = getViewer()->visiblePixels(this);
+  if(visible.isEmpty())
+    return false;
+  if(getViewer()->scalingSnapshots && getWidth() != scoreImagePageWidth)
+    return false;
+  return visible != scoreImageArea || getWidth() != scoreImagePageWidth ||
+    !scoreInvalid.isEmpty();
+}
+
+void Page::prepareScore(void)
+{
+  juce::Rectangle<int> visible = getViewer()->visiblePixels(this);
+  
+  //Start over if the page moved or was resized (for example when zooming).
+  if(visible != scoreImageArea || getWidth() != scoreImagePageWidth)
+  {
+    scoreImageArea = visible;
+    scoreImagePageWidth = getWidth();
+    
+    //Software images can be drawn into on any thread.
+    scoreImage = juce::Image(juce::Image::RGB, visible.getWidth(),
+      visible.getHeight(), false, juce::SoftwareImageType());
+    scoreInvalid.clear();
+    scoreInvalid.add(visible);
+  }
+  
+  scoreCanvas = getCanvas(pageIndex);
+  scoreVisibleArea = getViewer()->visiblePageArea(this);
+}
+
+void Page::renderScore(void)
+{
+  //Render the parts of the score that changed since the last paint.
+  if(!scoreInvalid.isEmpty())
+  {
+    juce::Graphics ig(scoreImage);
+    ig.setOrigin(-scoreImageArea.getX(), -scoreImageArea.getY());
+    ig.reduceClipRegion(scoreInvalid);
+    paintScore(ig);
+    scoreInvalid.clear();
+  }
+}
+
+Page::RenderJob::RenderJob(Page* page) :
+  juce::ThreadPoolJob("Page Render"), page(page) {}
+
+juce::ThreadPoolJob::JobStatus Page::RenderJob::runJob(void)
+{
+  page->renderScore();
+  return jobHasFinished;
+}
+
+void Page::paintScaledScore(juce::Graphics& g)
+{
+  //Parts of the page the image does not cover are left blank.
+  g.fillAll(juce::Colours::white);
+  g.setColour(juce::Colours::black);
+  g.setOpacity(0.1f);
+  g.drawRect(0,0,getWidth(),getHeight());
+  if(!scoreImage.isValid() || scoreImagePageWidth <= 0)
+    return;
+  
+  //A fast resampling is enough since the page is rendered again afterwards.
+  float scale = (float)getWidth() / (float)scoreImagePageWidth;
+  g.setOpacity(1.0f);
+  g.setImageResamplingQuality(juce::Graphics::lowResamplingQuality);
+  g.drawImageTransformed(scoreImage, juce::AffineTransform::translation(
+    (float)scoreImageArea.getX(), (float)scoreImageArea.getY()).scaled(
+    scale, scale));
+}
+
+void Page::resized(void)
+{
+  overlay.setBounds(getLocalBounds());
+}
+
+void Page::repaintScore(void)
+{
+  scoreInvalid.clear();
+  scoreInvalid.add(getLocalBounds());
+  repaint();
+}
+
+void Page::repaintHandles(void)
+{
+  overlay.repaint();
+}
+
 bool Page::isSomePageInEvent(void)
 {
   for(prim::count i = 0; i < getPageCount(); i++)
-    if(getPage(i)->currentEvent)
+    if(getPage(i) && getPage(i)->currentEvent)
       return true;
   return false;
 }
@@ -83,7 +224,7 @@ void Page::cancelAllOtherPageEvents(Page* thisPage)
   for(prim::count i = 0; i < getPageCount(); i++)
   {
     Page* testPage = getPage(i);
-    if(testPage != thisPage && testPage->currentEvent)
+    if(testPage && testPage != thisPage && testPage->currentEvent)
       testPage->currentEvent->cancel();
   }
 }
@@ -115,7 +256,7 @@ void Page::mouseMove(const juce::MouseEvent &e)
     if(getDocument()->temporarilyHideHandles)
     {
       getDocument()->temporarilyHideHandles = false;
-      repaint();
+      getContent()->repaintHandles();
     }
 
     if(Interaction* i = isUnderHandle(e.x, e.y))
@@ -197,6 +338,39 @@ Interaction* Page::isUnderHandle(prim::integer x, prim::integer y)
   return bestin;
 }
 
+void Page::repaintRegion(const prim::math::Rectangle& inches)
+{
+  using namespace prim;
+  using namespace prim::math;
+  
+  //Handles are drawn at a constant size on screen, so pad by pixels.
+  const number pixelsHandleMargin = 16.0f;
+  
+  Vector pageSize = getContainer()->sizePage;
+  number sx = (number)getWidth() / pageSize.x;
+  number sy = (number)getHeight() / pageSize.y;
+  
+  number left = (inches.Left() + pageSize.x * 0.5f) * sx - pixelsHandleMargin;
+  number right = (inches.Right() + pageSize.x * 0.5f) * sx + pixelsHandleMargin;
+  number top = (pageSize.y * 0.5f - inches.Top()) * sy - pixelsHandleMargin;
+  number bottom = (pageSize.y * 0.5f - inches.Bottom()) * sy +
+    pixelsHandleMargin;
+  
+  int x = (int)left, y = (int)top;
+  juce::Rectangle<int> area(x, y, (int)right - x + 1, (int)bottom - y + 1);
+  scoreInvalid.add(area);
+  repaint(area);
+}
+
+void Page::repaintSection(Representation::Section* section)
+{
+  //The main sections share their size and position, so all pages change.
+  if(!section || !section->parentSection)
+    getContent()->repaintScores();
+  else
+    repaintRegion(section->cachedBounds(getContainer()->sizePage));
+}
+
 void Page::ClickAndDrag(prim::integer x, prim::integer y)
 {
   getDocument()->temporarilyHideHandles = true;
@@ -214,21 +388,35 @@ void Page::DoubleClick(prim::integer x, prim::integer y)
 {
   if(Interaction* handle = isUnderHandle(x, y))
   {
+    //Section whose part of the page changes (null for the whole page)
+    Representation::Section* damaged = handle->section;
+    
     switch(handle->type)
     {
     case Interaction::MainSectionPosition:
-      getContainer()->offsetMainSection = prim::math::Inches(0, 0); break;
+      getContainer()->offsetMainSection = prim::math::Inches(0, 0);
+      getJournal()->recordContainer();
+      damaged = 0;
+      break;
       
     case Interaction::MainSectionWidth:
       getContainer()->sizeMainSection.x = getContainer()->sizePage.x *
-        (prim::number)(9.0 / 11.0); break;
+        (prim::number)(9.0 / 11.0);
+      getJournal()->recordContainer();
+      damaged = 0;
+      break;
         
     case Interaction::SectionHeight:
-      if(getContainer()->GetChildOfType<Representation::Section>() ==
-        handle->section)
+      if(!handle->section->parentSection)
+      {
         getContainer()->sizeMainSection.y = getContainer()->sizePage.y * 0.25f;
+        getJournal()->recordContainer();
+      }
       else
+      {
         handle->section->scalarHeight = 0.6f;
+        getJournal()->recordSection(handle->section);
+      }
       break;
       
     case Interaction::SectionAccelerandoLeft:
@@ -241,6 +429,7 @@ void Page::DoubleClick(prim::integer x, prim::integer y)
         {
           parentSection->scalarAccelerando =
             -ValueChooserComponent::lastValueReturned;
+          getJournal()->recordSection(parentSection);
         }
       }     
       break;
@@ -258,6 +447,7 @@ void Page::DoubleClick(prim::integer x, prim::integer y)
           rs->parentSegment = parentSegment;
           rs->segments = (prim::count)ValueChooserComponent::lastValueReturned;
           parentSection->AddObject(rs);
+          getJournal()->recordSection(rs);
         }
       }
       break;
@@ -271,15 +461,22 @@ void Page::DoubleClick(prim::integer x, prim::integer y)
         {
           section->segments = (prim::count)
             ValueChooserComponent::lastValueReturned;
+          getJournal()->recordSection(section);
         }
       }
       break;
       
     case Interaction::DeleteSection:
+      //The section is gone after removal, so repaint its area first.
+      repaintSection(handle->section);
+      if(handle->section->parentSection)
+        getJournal()->recordRemoval(handle->section);
       handle->section->Remove();
-      break;
+      getScore()->sectionsChanged();
+      return;
     }
-    repaint();
+    repaintSection(damaged);
+    getScore()->sectionsChanged();
   }
 }
 
@@ -324,7 +521,7 @@ void Page::Click(prim::integer x, prim::integer y)
 void Page::Pausing(prim::integer x, prim::integer y)
 {
   getDocument()->temporarilyHideHandles = true;
-  repaint();
+  repaintHandles();
 }
 
 /*Some old code from another application that can do selection-based exports,
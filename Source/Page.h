@@ -34,6 +34,16 @@
 //Forward declarations...
 #include "Events.h"
 
+/**A transparent component laid over the page that paints only the interaction
+handles, so that showing, hiding or changing them never repaints the score.*/
+struct HandleOverlay : public juce::Component, public DocumentHandler
+{
+  Page* page;
+  
+  HandleOverlay(Document* document, Page* page);
+  void paint(juce::Graphics& g);
+};
+
 struct Page :
   public juce::Component, 
   //public juce::FileDragAndDropTarget,
@@ -45,17 +55,80 @@ struct Page :
   //-----------//
   prim::math::Vector pixelsTopLeft;
   prim::math::Vector pixelsDimensions;
+  
+  ///Index of the page and its canvas in the score
+  prim::count pageIndex;
 
   //----------------------//
   //Constructor/Destructor//
   //----------------------//
-  Page(Document* document);
+  Page(Document* document, prim::count pageIndex);
   virtual ~Page();
 
   //-----------//
   //Paint Event//
   //-----------//
   void paint(juce::Graphics& g);
+  void resized(void);
+  
+  //-----------//
+  //Score Cache//
+  //-----------//
+  /*The score is rendered into an image covering the visible part of the page.
+  Repaints that do not change the score, such as those of the handle overlay,
+  only copy the image back to the screen.*/
+  juce::Image scoreImage;
+  juce::Rectangle<int> scoreImageArea;
+  juce::RectangleList<int> scoreInvalid;
+  
+  ///Width of the page when the score image was rendered
+  int scoreImagePageWidth;
+  
+  ///Canvas of the page, looked up by prepareScore() for renderScore()
+  bbs::abstracts::Portfolio::Canvas* scoreCanvas;
+  
+  ///Visible part of the page in inches, found by prepareScore()
+  prim::math::Rectangle scoreVisibleArea;
+  
+  /**Draws the score image scaled to the current size of the page, for when
+  the zoom is changing. A page with no image yet is drawn blank.*/
+  void paintScaledScore(juce::Graphics& g);
+  
+  ///Renders the score (without handles) to a graphics context.
+  void paintScore(juce::Graphics& g);
+  
+  /**Returns whether the score image has to be rendered before the page can
+  be painted.*/
+  bool scoreImageIsStale(void);
+  
+  /**Gets the score image ready to be rendered on another thread. It starts
+  a new image if the page moved or was resized, and looks up the canvas and
+  the visible area, which may only be read on the message thread.*/
+  void prepareScore(void);
+  
+  /**Renders the parts of the score image that are out of date. Different
+  pages may be rendered on several threads at once while the message thread
+  waits for them. prepareScore() must be called first.*/
+  void renderScore(void);
+  
+  ///Renders the score image of a page on one of the page painters.
+  struct RenderJob : public juce::ThreadPoolJob
+  {
+    Page* page;
+    
+    RenderJob(Page* page);
+    JobStatus runJob(void);
+  };
+  
+  RenderJob renderJob;
+  
+  ///Marks the whole score as changed and repaints it.
+  void repaintScore(void);
+  
+  ///Repaints the handle overlay only.
+  void repaintHandles(void);
+  
+  HandleOverlay overlay;
 
   //---------------//
   //Events/Gestures//
@@ -70,9 +143,23 @@ struct Page :
   //Helpers//
   //-------//
   prim::count getPageIndex(void);
+  
+  ///Returns the handles of the canvas of this page from its last paint.
+  prim::List<Interaction*>& getInteractions(void);
+  
   bool isSomePageInEvent(void);
   void cancelAllOtherPageEvents(Page* thisPage);
   Interaction* isUnderHandle(prim::integer x, prim::integer y);
+  
+  /**Repaints only the part of the page covered by a rectangle given in inches
+  from the center of the page, with a margin for the interaction handles.*/
+  void repaintRegion(const prim::math::Rectangle& inches);
+  
+  /**Repaints the part of the page that an edit to the section can change. The
+  main sections are sized and positioned from the container, so an edit to
+  one of them repaints every page. The score is not told that its sections
+  changed; that is left for when the edit is complete.*/
+  void repaintSection(Representation::Section* section);
 
   //------------//
   //Event Mapper//
@@ -0,0 +1,253 @@
+/*
+ ==============================================================================
+ 
+ This file is part of Blume
+ Copyright 2010 William Andrew Burnson
+ 
+ ------------------------------------------------------------------------------
+ 
+ Blume can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ 
+ Blume is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with Blume; if not, visit www.gnu.org/licenses or write to
+ the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ ==============================================================================
+ */
+
+#include "Playback.h"
+
+using namespace prim;
+
+Playback::Schedule::Schedule() : seconds(0), nextRetired(0) {}
+
+Playback::Playback() : deviceManager(0), current(0),
+  sampleRate(defaultSampleRate), loopPosition(0), nextOnset(0),
+  clickLength(0), voiceCount(0)
+{
+}
+
+Playback::~Playback()
+{
+  stop();
+  delete pending.exchange(0);
+  delete current;
+  current = 0;
+}
+
+void Playback::publish(Schedule* schedule)
+{
+  collect();
+  delete pending.exchange(schedule);
+}
+
+void Playback::collect(void)
+{
+  //Take the whole stack at once so that the audio thread can keep pushing.
+  Schedule* schedule = retired.exchange(0);
+  while(schedule)
+  {
+    Schedule* next = schedule->nextRetired;
+    delete schedule;
+    schedule = next;
+  }
+}
+
+bool Playback::start(void)
+{
+  if(deviceManager)
+    return true;
+  
+  deviceManager = new juce::AudioDeviceManager;
+  if(deviceManager->initialise(0, 2, 0, true).isNotEmpty())
+  {
+    delete deviceManager;
+    deviceManager = 0;
+    return false;
+  }
+  deviceManager->addAudioCallback(this);
+  return true;
+}
+
+void Playback::stop(void)
+{
+  if(!deviceManager)
+    return;
+  
+  //Once the callback is removed the audio thread no longer runs it.
+  deviceManager->removeAudioCallback(this);
+  delete deviceManager;
+  deviceManager = 0;
+  collect();
+}
+
+bool Playback::isPlaying(void)
+{
+  return deviceManager != 0;
+}
+
+count Playback::loopLength(void)
+{
+  if(!current)
+    return 0;
+  return (count)(current->seconds * sampleRate);
+}
+
+count Playback::onsetSample(count i, count length)
+{
+  return (count)(current->positions[i] * (number)length);
+}
+
+void Playback::takePendingSchedule(void)
+{
+  Schedule* schedule = pending.exchange(0);
+  if(!schedule)
+    return;
+  
+  //Carry the phase of the loop over to the new schedule.
+  count oldLength = loopLength();
+  number phase = oldLength > 0 ? (number)loopPosition / (number)oldLength : 0;
+  
+  //Push the old schedule onto the retired stack for the message thread.
+  if(current)
+  {
+    Schedule* top;
+    do
+    {
+      top = retired.get();
+      current->nextRetired = top;
+    }
+    while(!retired.compareAndSetBool(current, top));
+  }
+  current = schedule;
+  count length = loopLength();
+  loopPosition = math::Min((count)(phase * (number)length),
+    math::Max(length - 1, (count)0));
+  
+  //Find the first onset that has not yet sounded in this pass.
+  count low = 0, high = current->positions.n();
+  while(low < high)
+  {
+    count middle = (low + high) / 2;
+    if(onsetSample(middle, length) < loopPosition)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  nextOnset = low;
+}
+
+void Playback::renderVoices(float* destination, count samples)
+{
+  for(count i = voiceCount - 1; i >= 0; i--)
+  {
+    Voice& v = voices[i];
+    const float* click = &clicks[v.click * clickLength + v.offset];
+    count n = math::Min(samples, clickLength - v.offset);
+    juce::FloatVectorOperations::add(destination, click, (int)n);
+    v.offset += n;
+    
+    //Finished voices are replaced by the last one.
+    if(v.offset >= clickLength)
+      voices[i] = voices[--voiceCount];
+  }
+}
+
+void Playback::audioDeviceIOCallback(const float** inputChannelData,
+  int numInputChannels, float** outputChannelData, int numOutputChannels,
+  int numSamples)
+{
+  //Render into the first open channel and copy it to the others.
+  float* output = 0;
+  for(int c = 0; c < numOutputChannels; c++)
+  {
+    if(!outputChannelData[c])
+      continue;
+    juce::zeromem(outputChannelData[c], sizeof(float) * numSamples);
+    if(!output)
+      output = outputChannelData[c];
+  }
+  if(!output)
+    return;
+  
+  takePendingSchedule();
+  
+  count done = 0;
+  while(done < numSamples)
+  {
+    count length = loopLength();
+    if(length <= 0)
+    {
+      renderVoices(&output[done], numSamples - done);
+      break;
+    }
+    
+    //Render up to the next onset or the end of the loop, whichever is first.
+    count onsets = current->positions.n();
+    count next = length;
+    if(nextOnset < onsets)
+      next = math::Min(onsetSample(nextOnset, length), length);
+    count segment = math::Min((count)numSamples - done,
+      math::Max(next - loopPosition, (count)0));
+    renderVoices(&output[done], segment);
+    done += segment;
+    loopPosition += segment;
+    
+    if(loopPosition >= length)
+    {
+      loopPosition = 0;
+      nextOnset = 0;
+    }
+    else if(nextOnset < onsets &&
+      onsetSample(nextOnset, length) <= loopPosition)
+    {
+      //Start the click at exactly this sample.
+      count level = current->levels[nextOnset++];
+      if(voiceCount < maximumVoices && clickLength > 0)
+      {
+        Voice& v = voices[voiceCount++];
+        v.click = sound::LevelClicks::ForLevel(level);
+        v.offset = 0;
+      }
+    }
+  }
+  
+  for(int c = 0; c < numOutputChannels; c++)
+    if(outputChannelData[c] && outputChannelData[c] != output)
+      juce::FloatVectorOperations::copy(outputChannelData[c], output,
+        numSamples);
+}
+
+void Playback::audioDeviceAboutToStart(juce::AudioIODevice* device)
+{
+  sampleRate = device ? device->getCurrentSampleRate() : 0;
+  if(sampleRate <= 0)
+    sampleRate = defaultSampleRate;
+  
+  //The clicks sound the same as in an exported click track.
+  number seconds = sound::LevelClicks::Seconds();
+  clickLength = (count)(sampleRate * seconds);
+  clicks.n(clickLength * clickCount);
+  for(count i = 0; i < clickCount; i++)
+  {
+    number frequency = sound::LevelClicks::Frequency(i);
+    number amplitude = sound::LevelClicks::Amplitude(i);
+    for(count j = 0; j < clickLength; j++)
+      clicks[i * clickLength + j] = (float)sound::LevelClicks::Sample(
+        frequency, seconds, amplitude, (number)j / (number)sampleRate);
+  }
+  voiceCount = 0;
+}
+
+void Playback::audioDeviceStopped(void)
+{
+  voiceCount = 0;
+}
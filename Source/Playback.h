@@ -0,0 +1,141 @@
+/*
+ ==============================================================================
+ 
+ This file is part of Blume
+ Copyright 2010 William Andrew Burnson
+ 
+ ------------------------------------------------------------------------------
+ 
+ Blume can be redistributed and/or modified under the terms of the
+ GNU General Public License, as published by the Free Software Foundation;
+ either version 3 of the License, or (at your option) any later version.
+ 
+ Blume is distributed in the hope that it will be useful, but
+ WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with Blume; if not, visit www.gnu.org/licenses or write to
+ the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+ Boston, MA 02111-1307 USA
+ 
+ ==============================================================================
+ */
+
+#ifndef Playback_h
+#define Playback_h
+
+#include "Libraries.h"
+
+/**Plays the onsets of the score as a looping click track so that the rhythm
+can be heard while the handles are dragged. The message thread publishes each
+new set of onsets as an immutable Schedule, and the audio callback picks it up
+at the start of its next buffer. The handoff only uses atomic operations:
+pending is a single-slot mailbox that carries a new schedule to the audio
+thread, and retired is a lock-free stack that carries the replaced ones back.
+The audio thread therefore never waits for the message thread to collect, and
+the message thread does all the deleting, so the callback never locks or
+allocates. The callback can be driven without a device (for example to render
+offline) by calling audioDeviceAboutToStart with a null device first.*/
+struct Playback : public juce::AudioIODeviceCallback
+{
+  ///An immutable list of onsets that is handed to the audio thread.
+  struct Schedule
+  {
+    ///Onset positions as fractions of the loop in ascending order
+    prim::Array<prim::number> positions;
+    
+    ///Level of each onset in the section tree, starting at one
+    prim::Array<prim::count> levels;
+    
+    ///Duration of one pass through the loop
+    prim::number seconds;
+    
+    ///The schedule retired before this one, while it waits to be collected
+    Schedule* nextRetired;
+    
+    Schedule();
+  };
+  
+  ///Sample rate used when the callback is driven without a device
+  static const int defaultSampleRate = 44100;
+  
+  ///Number of clicks, one for each level of the section tree
+  static const prim::count clickCount = prim::sound::LevelClicks::Count;
+  
+  ///Number of clicks that can sound at the same time
+  static const prim::count maximumVoices = 32;
+
+  Playback();
+  ~Playback();
+  
+  //--------------//
+  //Message Thread//
+  //--------------//
+  
+  /**Hands a new schedule to the audio thread, which takes ownership of it. A
+  schedule published before the audio thread took it is deleted.*/
+  void publish(Schedule* schedule);
+  
+  ///Deletes the schedules the audio thread has finished with, if any.
+  void collect(void);
+  
+  ///Opens the default audio device and starts playing.
+  bool start(void);
+  
+  ///Stops playing and closes the audio device.
+  void stop(void);
+  
+  ///Returns whether the audio device is playing.
+  bool isPlaying(void);
+  
+  //------------//
+  //Audio Thread//
+  //------------//
+  
+  void audioDeviceIOCallback(const float** inputChannelData,
+    int numInputChannels, float** outputChannelData, int numOutputChannels,
+    int numSamples);
+  
+  ///Renders the clicks at the sample rate of the device.
+  void audioDeviceAboutToStart(juce::AudioIODevice* device);
+  
+  void audioDeviceStopped(void);
+  
+private:
+  ///A click that is sounding and how far into it playback has reached
+  struct Voice
+  {
+    prim::count click;
+    prim::count offset;
+  };
+  
+  juce::Atomic<Schedule*> pending;
+  juce::Atomic<Schedule*> retired;
+  juce::AudioDeviceManager* deviceManager;
+  
+  //The rest is only touched by the audio thread while the device runs.
+  Schedule* current;
+  double sampleRate;
+  prim::count loopPosition;
+  prim::count nextOnset;
+  prim::Array<float> clicks;
+  prim::count clickLength;
+  Voice voices[maximumVoices];
+  prim::count voiceCount;
+  
+  ///Returns the length of the loop of the current schedule in samples.
+  prim::count loopLength(void);
+  
+  ///Returns the sample within the loop at which an onset sounds.
+  prim::count onsetSample(prim::count i, prim::count length);
+  
+  ///Takes a newly published schedule, keeping the phase of the loop.
+  void takePendingSchedule(void);
+  
+  ///Mixes the sounding clicks into part of a buffer.
+  void renderVoices(float* destination, prim::count samples);
+};
+
+#endif
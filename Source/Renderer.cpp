@@ -32,11 +32,14 @@ void Renderer::Paint(bbs::abstracts::Portfolio* PortfolioToPaint,
   properties = PortfolioProperties->Interface<Properties>();
 
   //Give the painter methods access to the abstract canvas methods and members.
-  properties->internalPointerToCanvas = 
-    PortfolioToPaint->Canvases[properties->indexOfCanvas];
+  bbs::abstracts::Portfolio::Canvas* canvas = properties->canvas;
+  properties->internalPointerToCanvas = canvas;
 
-  //Paint the current canvas.
-  PortfolioToPaint->Canvases[properties->indexOfCanvas]->Paint(this);
+  //Paint the current canvas, or just one of its layers.
+  if(properties->indexOfLayer < 0)
+    canvas->Paint(this);
+  else
+    canvas->Layers[properties->indexOfLayer]->Paint(this);
 
   //Set the properties pointer back to null to be safe.
   properties = 0;
@@ -91,37 +94,58 @@ juce::Colour Renderer::ConvertPrimColorToJuceColor(prim::colors::RGB color)
     (prim::byte)(prim::colors::Component::b(color) * 255.0f));
 }
 
-void Renderer::DrawPath(prim::Path& p, bool Stroke, bool Fill, bool ClosePath,
-                        prim::number StrokeWidth)
+juce::AffineTransform Renderer::CalculatePageTransform(void)
 {
   using namespace prim;
   using namespace prim::math;
 
-  //Make sure that we are inside a valid paint event.
-  if(!properties)
-    return;
-
-  //Create a JUCE path from the Prim path.
-  juce::Path jp;
-  ConvertPrimPathToJucePath(p, jp);
-
   //Determine the dimensions of the current canvas and the appropriate scale.
   Vector pageDimensions =
     Inches(properties->internalPointerToCanvas->Dimensions);
   number scaleToFitPage =
     (number)properties->componentContext->getWidth() / pageDimensions.x;
 
-  //Calculate the affine transform so that the image is scaled to the page.
+  //Map the current space onto the page with y increasing downwards.
   StateMatrix<RasterState> m = State.Forwards();
   juce::AffineTransform jat(
     (float)m.a, (float)m.c, (float)m.e,
     (float)m.b, (float)m.d, (float)m.f);
   jat = jat.translated(0, (float)-pageDimensions.y);
-  jat = jat.scaled((float)scaleToFitPage, (float)-scaleToFitPage);
+  return jat.scaled((float)scaleToFitPage, (float)-scaleToFitPage);
+}
+
+void Renderer::DrawPath(prim::Path& p, bool Stroke, bool Fill, bool ClosePath,
+                        prim::number StrokeWidth)
+{
+  using namespace prim;
+  using namespace prim::math;
+
+  //Make sure that we are inside a valid paint event.
+  if(!properties)
+    return;
+
+  //Create a JUCE path from the Prim path.
+  juce::Path jp;
+  ConvertPrimPathToJucePath(p, jp);
+
+  //Calculate the affine transform so that the image is scaled to the page.
+  juce::AffineTransform jat = CalculatePageTransform();
 
   //Get the JUCE graphics context.
   juce::Graphics* g = properties->graphicsContext;
 
+  /*Skip the path if it lies entirely outside of the region being repainted,
+  so that a partial repaint does not rasterize the rest of the page.*/
+  juce::Rectangle<float> bounds = jp.getBoundsTransformed(jat);
+  if(Stroke)
+  {
+    float halfStroke = (float)(StrokeWidth * (number)jat.mat00) * 0.5f;
+    bounds = bounds.expanded(halfStroke, halfStroke);
+  }
+  if(!g->clipRegionIntersects(bounds.getSmallestIntegerContainer().expanded(
+    1, 1)))
+    return;
+
   //Fill path if necessary.
   if(Fill)
   {
@@ -145,3 +169,124 @@ void Renderer::DrawPath(prim::Path& p, bool Stroke, bool Fill, bool ClosePath,
     g->strokePath(jp, juce::PathStrokeType((float)scaledStrokeWidth), jat);
   }
 }
+
+void Renderer::DrawLines(const prim::Array<prim::math::Line>& Lines,
+  prim::number StrokeWidth, LineCap Cap)
+{
+  using namespace prim;
+  using namespace prim::math;
+
+  //Make sure that we are inside a valid paint event.
+  if(!properties || !Lines.n())
+    return;
+
+  juce::AffineTransform jat = CalculatePageTransform();
+  float width = (float)(StrokeWidth * (number)jat.mat00);
+  float halfWidth = width * 0.5f;
+  float extension = (Cap == LineCaps::Square ? halfWidth : 0.0f);
+
+  /*Lines which are horizontal or vertical on screen become rectangles, which
+  JUCE fills without any path rasterization. Round caps and slanted lines are
+  collected into a single path and stroked once.*/
+  juce::RectangleList<float> rectangles;
+  juce::Path slanted;
+  for(count i = 0; i < Lines.n(); i++)
+  {
+    const prim::math::Line& l = Lines.GetConstItem(i);
+    float ax = (float)l.a.x, ay = (float)l.a.y;
+    float bx = (float)l.b.x, by = (float)l.b.y;
+    jat.transformPoint(ax, ay);
+    jat.transformPoint(bx, by);
+
+    if(Cap != LineCaps::Round && (ax == bx || ay == by))
+    {
+      float left = juce::jmin(ax, bx), right = juce::jmax(ax, bx);
+      float top = juce::jmin(ay, by), bottom = juce::jmax(ay, by);
+      if(ax == bx)
+      {
+        left -= halfWidth; right += halfWidth;
+        top -= extension; bottom += extension;
+      }
+      else
+      {
+        top -= halfWidth; bottom += halfWidth;
+        left -= extension; right += extension;
+      }
+      rectangles.addWithoutMerging(juce::Rectangle<float>(left, top,
+        right - left, bottom - top));
+    }
+    else
+    {
+      slanted.startNewSubPath(ax, ay);
+      slanted.lineTo(bx, by);
+    }
+  }
+
+  juce::Graphics* g = properties->graphicsContext;
+  g->setColour(ConvertPrimColorToJuceColor(State.TopState().StrokeColor));
+  if(!rectangles.isEmpty())
+    g->fillRectList(rectangles);
+  if(!slanted.isEmpty())
+  {
+    juce::PathStrokeType::EndCapStyle capStyle = juce::PathStrokeType::butt;
+    if(Cap == LineCaps::Square)
+      capStyle = juce::PathStrokeType::square;
+    else if(Cap == LineCaps::Round)
+      capStyle = juce::PathStrokeType::rounded;
+    g->strokePath(slanted, juce::PathStrokeType(width,
+      juce::PathStrokeType::mitered, capStyle));
+  }
+}
+
+void Renderer::DrawRectangles(
+  const prim::Array<prim::math::Rectangle>& Rectangles,
+  prim::number StrokeWidth)
+{
+  using namespace prim;
+  using namespace prim::math;
+
+  //Make sure that we are inside a valid paint event.
+  if(!properties || !Rectangles.n())
+    return;
+
+  //Rotated spaces need real paths, which the base painter builds.
+  juce::AffineTransform jat = CalculatePageTransform();
+  if(jat.mat01 != 0 || jat.mat10 != 0)
+  {
+    bbs::abstracts::Painter::DrawRectangles(Rectangles, StrokeWidth);
+    return;
+  }
+
+  float halfWidth = (float)(StrokeWidth * (number)jat.mat00) * 0.5f;
+  juce::RectangleList<float> rectangles;
+  for(count i = 0; i < Rectangles.n(); i++)
+  {
+    const prim::math::Rectangle& r = Rectangles.GetConstItem(i);
+    float ax = (float)r.Left(), ay = (float)r.Bottom();
+    float bx = (float)r.Right(), by = (float)r.Top();
+    jat.transformPoint(ax, ay);
+    jat.transformPoint(bx, by);
+    juce::Rectangle<float> box(juce::Point<float>(ax, ay),
+      juce::Point<float>(bx, by));
+
+    if(StrokeWidth <= 0)
+    {
+      rectangles.addWithoutMerging(box);
+      continue;
+    }
+
+    //Each edge is a thin rectangle centered on the edge of the box.
+    juce::Rectangle<float> outer = box.expanded(halfWidth, halfWidth);
+    float w = halfWidth * 2.0f;
+    rectangles.addWithoutMerging(outer.withHeight(w));
+    rectangles.addWithoutMerging(outer.withTrimmedTop(outer.getHeight() - w));
+    rectangles.addWithoutMerging(outer.withWidth(w));
+    rectangles.addWithoutMerging(outer.withTrimmedLeft(outer.getWidth() - w));
+  }
+
+  juce::Graphics* g = properties->graphicsContext;
+  prim::colors::RGB color = StrokeWidth <= 0 ? State.TopState().FillColor :
+    State.TopState().StrokeColor;
+  g->setColour(ConvertPrimColorToJuceColor(color));
+  g->fillRectList(rectangles);
+}
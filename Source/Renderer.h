@@ -37,14 +37,26 @@ struct Renderer : public bbs::abstracts::Painter
   {
     juce::Graphics* graphicsContext;
     juce::Component* componentContext;
-    prim::count indexOfCanvas;
+    
+    /**The canvas to paint. It is looked up on the message thread beforehand,
+    since the canvas list of the portfolio must not be indexed from several
+    threads at once.*/
+    bbs::abstracts::Portfolio::Canvas* canvas;
+    
+    ///Index of the canvas layer to paint, or -1 to paint the canvas itself.
+    prim::count indexOfLayer;
+    
+    /**Part of the page that can be seen, in inches from its bottom-left
+    corner. Anything outside it may be left out. If it is empty, the whole
+    page is painted.*/
+    prim::math::Rectangle visibleArea;
 
   protected:
     bbs::abstracts::Portfolio::Canvas* internalPointerToCanvas;
 
   public:
-    Properties() : graphicsContext(0), componentContext(0), indexOfCanvas(-1), 
-      internalPointerToCanvas(0) {}
+    Properties() : graphicsContext(0), componentContext(0), canvas(0),
+      indexOfLayer(-1), internalPointerToCanvas(0) {}
 
     friend struct Renderer;
   };
@@ -65,10 +77,23 @@ public:
   ///Converts a Prim color to a JUCE color.
   juce::Colour ConvertPrimColorToJuceColor(prim::colors::RGB color);
 
+  ///Calculates the transform from the current space to component pixels.
+  juce::AffineTransform CalculatePageTransform(void);
+
   ///Maps the Prim path object to a JUCE path object and draws it.
   virtual void DrawPath(prim::Path& p,
     bool Stroke = true, bool Fill = false, bool ClosePath = false,
     prim::number StrokeWidth = 0.0);
+
+  /**Draws axis-aligned lines as one rectangle list and strokes the rest as a
+  single path.*/
+  virtual void DrawLines(const prim::Array<prim::math::Line>& Lines,
+    prim::number StrokeWidth, LineCap Cap = LineCaps::Butt);
+
+  ///Draws the rectangles as one rectangle list when the space is unrotated.
+  virtual void DrawRectangles(
+    const prim::Array<prim::math::Rectangle>& Rectangles,
+    prim::number StrokeWidth = 0);
 };
 
 #endif
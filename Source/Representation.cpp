@@ -35,11 +35,7 @@ void Representation::createDefaultDocument(void)
 {
   delete Root;
   Root = new Container;
-  Section* s = new Section(0);
-  s->segments = 4;
-  s->scalarHeight = 1.0f;
-  s->scalarAccelerando = 0.0f;
-  Root->AddObject(s);
+  getContainer()->addMainSection();
 }
 
 prim::XML::Element* Representation::CreateRootElement(prim::String& RootTagName)
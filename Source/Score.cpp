@@ -26,7 +26,10 @@
 #include "Score.h"
 
 #include "Elements.h"
+#include "Feather.h"
 #include "Interaction.h"
+#include "Playback.h"
+#include "Renderer.h"
 #include "Viewer.h"
 
 using namespace prim;
@@ -36,39 +39,8 @@ using namespace bbs;
 using namespace bbs::abstracts;
 using namespace abcd;
 
-number ZoomConstant = 1.0;
-
 namespace notation
 {
-  struct PositionInfo
-  {
-    count Level;
-    number Position;
-    
-    bool operator < (const PositionInfo& Other) const
-    {
-      return Position < Other.Position;
-    }
-    bool operator <= (const PositionInfo& Other) const
-    {
-      return Position <= Other.Position;
-    }
-    bool operator == (const PositionInfo& Other) const
-    {
-      return Position == Other.Position;
-    }
-    bool operator > (const PositionInfo& Other) const
-    {
-      return Position > Other.Position;
-    }
-    bool operator >= (const PositionInfo& Other) const
-    {
-      return Position >= Other.Position;
-    }
-  };
-  
-  List<PositionInfo> State;
-  
   Score::Score(Document* Document) : DocumentHandler(Document)
   {
   }
@@ -77,53 +49,195 @@ namespace notation
   {
     Canvases.RemoveAndDeleteAll();
   }
+  
+  void Score::paginate(void)
+  {
+    //List the main sections in order.
+    prim::Array<Representation::Section*> sections;
+    const prim::List<XML::Object*>& objects = getContainer()->GetObjects();
+    for(count i = 0; i < objects.n(); i++)
+      if(Representation::Section* s =
+        dynamic_cast<Representation::Section*>(objects[i]->IsElement()))
+          sections.Add(s);
+    
+    //Make the pages again only if the main sections have changed.
+    bool changed = sections.n() != Canvases.n();
+    for(count i = 0; i < sections.n() && !changed; i++)
+      changed = static_cast<Page*>(Canvases[i])->section != sections[i];
+    if(changed)
+    {
+      Canvases.RemoveAndDeleteAll();
+      for(count i = 0; i < sections.n(); i++)
+        Canvases.Add() = new Page(getDocument(), *this, sections[i]);
+    }
+    
+    for(count i = 0; i < Canvases.n(); i++)
+      Canvases[i]->Dimensions = getContainer()->sizePage;
+  }
 
-  Score::Page::Page(Document* document, Score& score) :
-    DocumentHandler(document)
+  void Score::mergeOnsets(prim::Array<number>& positions,
+    prim::Array<count>& levels)
   {
-    Page::score = &score;
+    positions.Clear();
+    levels.Clear();
+    Feather feather;
+    prim::Array<number> pagePositions;
+    prim::Array<count> pageLevels;
+    for(count i = 0; i < Canvases.n(); i++)
+    {
+      feather.evaluate(static_cast<Page*>(Canvases[i])->section, 0, 1.0f);
+      feather.merge(pagePositions, pageLevels);
+      
+      //The end of each page is the start of the next.
+      for(count j = 0; j < pagePositions.n(); j++)
+      {
+        number x = pagePositions[j] + (number)i;
+        if(positions.n() && Abs(x - positions.last()) < 0.00001f)
+        {
+          Decrease(levels.last(), pageLevels[j]);
+          continue;
+        }
+        positions.Add(x);
+        levels.Add(pageLevels[j]);
+      }
+    }
   }
 
-  void Score::Page::PaintSection(Painter* Painter,
-    Representation::Section* section,
-    prim::number width, prim::number height, prim::number xOffset, bool up,
-    prim::number beamSlant, prim::count recursion)
+  bool Score::exportClickTrack(const prim::String& filename, number seconds,
+    bool wav)
   {
-    number TotalWidth = width;
-    number Segments = (number)section->segments;
-    number accel = section->scalarAccelerando;
-    number percentage;
-    if(accel >= 0)
-      percentage = 1.0f / (accel + 1.0f);
-    else
-      percentage = 1.0f / (-accel + 1.0f);
+    sound::ClickTrack track;
+    track.AddLevelClicks();
+
+    //The positions are measured in pages.
+    prim::Array<number> positions;
+    prim::Array<count> levels;
+    mergeOnsets(positions, levels);
+    prim::Array<sound::ClickTrack::Onset> onsets;
+    onsets.Reserve(positions.n());
+    for(count i = 0; i < positions.n(); i++)
+      onsets.Add(sound::ClickTrack::Onset(positions[i] * seconds,
+        sound::LevelClicks::ForLevel(levels[i])));
 
-    number W1 = TotalWidth / Segments * percentage;
+    //Leave room for the last click to ring out.
+    return track.Render(filename, onsets,
+      seconds * (number)Canvases.n() + 0.5f, 2,
+      wav ? sound::Stream16Bit::Formats::WAV :
+      sound::Stream16Bit::Formats::AIFF);
+  }
 
-    number deltaX = 2.0f * (TotalWidth - W1 * Segments) / 
-      (Segments * Segments - Segments);
+  void Score::publishOnsets(void)
+  {
+    if(!getPlayback()->isPlaying())
+      return;
     
-    if(accel >= 0)
-    {
-      //Have to reverse the algorithm so that the accels and decels are
-      //symmetric.
-      W1 = deltaX * (Segments - 1.0f) + W1; //Transform W1 into W2...
-      deltaX *= -1.0f; //Reverse the delta...
-    }
+    //The preview loops over all of the pages.
+    number pages = (number)Max(Canvases.n(), (count)1);
+    Playback::Schedule* schedule = new Playback::Schedule;
+    schedule->seconds = getDocument()->rhythmSeconds * pages;
+    mergeOnsets(schedule->positions, schedule->levels);
+    for(count i = 0; i < schedule->positions.n(); i++)
+      schedule->positions[i] /= pages;
+    getPlayback()->publish(schedule);
+  }
+
+  void Score::sectionsChanged(void)
+  {
+    publishOnsets();
     
-    number d;
-    if(accel > 0)
-      d = (number)1.0f + accel;
-    else
-      d = (number)1.0f / ((number)1.0f - accel);
+#ifdef BLUME_WRITE_ONSET_INFO
+    //Write out the onsets for analysis.
+    prim::Array<number> positions;
+    prim::Array<count> levels;
+    mergeOnsets(positions, levels);
+    if(!positions.n())
+      return;
     
-    if(Abs(accel) < 0.001f)
-      W1 = TotalWidth / Segments;
-    else
+    prim::number mindist = 1.0;
+    for(count i = 1; i < positions.n(); i++)
+      mindist = math::Min(mindist, positions[i] - positions[i - 1]);
+    prim::String s;
+    s += "INFO BEGIN";
+    s += "Minimum Distance: ";
+    s &= mindist;
+    s++;
+    for(count i = 0; i < positions.n(); i++)
     {
-      number dn = 1.0f; for(count i = 0; i < Segments; i++) dn *= d;
-      W1 = TotalWidth * (1.0f - d) / (1 - dn);
+      for(count j = 1; j < levels[i]; j++)
+        s &= "  ";
+      if(positions[i] == 0.0)
+        s &= "0.0000000";
+      else if(positions[i] == 1.0)
+        s &= "1.0000000";
+      else
+      {
+        prim::String x = math::NumberToString(positions[i], 7);
+        for(count k = 9 - x.n(); k > 0; k--)
+          x &= "0";
+        s &= x;
+      }
+      
+      s++;
     }
+    s &= "INFO END";
+    prim::String f =
+      juce::File::getSpecialLocation(
+      juce::File::userDesktopDirectory).getFullPathName().toRawUTF8();
+    f &= "/Info.txt";
+    prim::File::Write(f, (const byte*)s.Merge(), s.n());
+    /*
+    prim::Console c;
+    c += s;
+    c++;
+    */
+#endif
+  }
+
+  Score::Page::Page(Document* document, Score& score,
+    Representation::Section* section) : DocumentHandler(document)
+  {
+    Page::score = &score;
+    Page::section = section;
+    Layers.Add() = new Handles(this);
+  }
+  
+  Score::Page::~Page()
+  {
+    Layers.RemoveAndDeleteAll();
+    interactions.RemoveAndDeleteAll();
+  }
+  
+  Score::Page::Handles::Handles(Page* page)
+  {
+    Handles::page = page;
+  }
+  
+  void Score::Page::Handles::Paint(Painter* Painter)
+  {
+    //Handles are only for editing on screen, so they never go in a PDF.
+    if(!Painter->Interface<Renderer>() ||
+      page->getDocument()->temporarilyHideHandles)
+      return;
+    
+    Painter->Translate(page->getContainer()->sizePage * 0.5f);
+    page->DrawHandles(Painter);
+    Painter->UndoTransformation();
+  }
+
+  count Score::Page::PaintSection(Painter* Painter, const Feather& feather,
+    prim::count index, prim::number height, prim::number beamSlant,
+    prim::number pixelsPerInch, prim::number zoomConstant,
+    const prim::math::Rectangle& visible, prim::Path& bands)
+  {
+    Representation::Section* section = feather.sections[index];
+    count recursion = feather.sectionLevels[index];
+    count segments = feather.sectionSegments[index];
+    bool up = recursion % 2 == 1;
+    number TotalWidth = feather.sectionWidths[index];
+    number xOffset = feather.sectionOffsets[index];
+    const number* xSubOffsets =
+      &feather.positions[feather.sectionOnsets[index]];
+    height *= feather.sectionHeights[index];
     
     number y = height * section->scalarHeight * (up ? 1.0f : -1.0f);
     
@@ -142,59 +256,90 @@ namespace notation
     number x = xOffset;
     Vector off = getContainer()->offsetMainSection;
     
-    Vector leftaccel = Vector(x + off.x, y1 + off.y);
-    getInteractions().Add() = new Interaction(leftaccel, section,
-      Interaction::SectionAccelerandoLeft, 0.05f * ZoomConstant, false, false, true);
-    
-    Vector sectionheight = Vector(x + off.x + TotalWidth * 0.5f, y + off.y);
-    getInteractions().Add() = new Interaction(sectionheight, section,
-      Interaction::SectionHeight, 0.12f * ZoomConstant, false, true, false);
-      
-    Vector deletesection = Vector(x + off.x + TotalWidth, y2 + off.y);
-    if(recursion > 1)
-    {
-      getInteractions().Add() = new Interaction(deletesection, section,
-        Interaction::DeleteSection, 0.05f * ZoomConstant, true, false, false);
-    }
-    else
-    {
-      getInteractions().Add() = new Interaction(deletesection, section,
-        Interaction::ChangeMainSectionSegments, 0.03f * ZoomConstant, false, false, true);    
-    }
-      
     section->cachedHeight = height * (up ? 1.0f : -1.0f);
     section->cachedWidth = TotalWidth;
     section->cachedRecurseDepth = recursion;
     section->cachedBottomLeft = Vector(x + off.x, off.y);
     section->cachedExponentialScale = exponentialsize;
     
-    number* xSubOffsets = new number[section->segments + 1];
-    number currentW = W1;
-    for(count i = 0; i <= section->segments; i++)
+    /*Children divide the segments of their parent, so a subtree lies within
+    the span of its section and is skipped as a whole when that span is out of
+    view. Otherwise the section itself is only drawn if its ticks or beam can
+    be seen.*/
+    if(!visible.IsEmpty())
+    {
+      number beam = 0.05f * zoomConstant * exponentialsize;
+      number bottom = Min(Min(y1, y2), (number)0) - beam;
+      number top = Max(Max(y1, y2), (number)0) + beam;
+      prim::math::Rectangle bounds(xOffset + off.x, bottom + off.y,
+        xOffset + TotalWidth + off.x, top + off.y);
+      bounds.Order();
+      if(bounds.Right() < visible.Left() || bounds.Left() > visible.Right())
+        return feather.sectionEnds[index];
+      if(bounds.Top() < visible.Bottom() || bounds.Bottom() > visible.Top())
+        return index + 1;
+    }
+    
+    /*A handle can only be hit if it is at least its own radius away from its
+    neighbors. The radii are constant on screen, so at low zoom the handles of
+    narrow sections are left out rather than piled on top of each other.*/
+    number handleSpacing = Abs(TotalWidth) * 0.5f;
+    if(handleSpacing >= 0.12f * zoomConstant)
     {
-      PositionInfo pi;
-      pi.Level = recursion;
-      pi.Position = x;
-      State.Add() = pi;
+      Vector leftaccel = Vector(x + off.x, y1 + off.y);
+      interactions.Add() = new Interaction(leftaccel, section,
+        Interaction::SectionAccelerandoLeft, 0.05f * zoomConstant, false,
+        false, true);
       
-      xSubOffsets[i] = x;
+      Vector sectionheight = Vector(x + off.x + TotalWidth * 0.5f, y + off.y);
+      interactions.Add() = new Interaction(sectionheight, section,
+        Interaction::SectionHeight, 0.12f * zoomConstant, false, true, false);
+        
+      Vector deletesection = Vector(x + off.x + TotalWidth, y2 + off.y);
+      if(recursion > 1)
+      {
+        interactions.Add() = new Interaction(deletesection, section,
+          Interaction::DeleteSection, 0.05f * zoomConstant, true, false,
+          false);
+      }
+      else
+      {
+        interactions.Add() = new Interaction(deletesection, section,
+          Interaction::ChangeMainSectionSegments, 0.03f * zoomConstant, false,
+          false, true);    
+      }
+    }
+    
+    /*When the segments are closer together than the screen can show, the
+    section and everything beneath it are filled in as a single band under the
+    beam, and the subtree is skipped.*/
+    number spacing = Abs(TotalWidth) / (number)Max(segments, (count)1);
+    if(pixelsPerInch > 0 && spacing * pixelsPerInch < (number)detailPixels)
+    {
+      bands.AddComponent(Vector(xOffset, 0) + off);
+      bands.AddCurve(Vector(xOffset, y1) + off);
+      bands.AddCurve(Vector(xOffset + TotalWidth, y2) + off);
+      bands.AddCurve(Vector(xOffset + TotalWidth, 0) + off);
+      bands.AddCurve(Vector(xOffset, 0) + off);
+      return feather.sectionEnds[index];
+    }
+    
+    prim::Array<prim::math::Line> ticks;
+    ticks.Reserve(segments + 1);
+    for(count i = 0; i <= segments; i++)
+    {
+      x = xSubOffsets[i];
       number y = ((x - xOffset) / TotalWidth) * (y2 - y1) + y1;
       
       Vector Start(x, 0), End(x, y);
       Start += off; End += off;
+      ticks.Add(prim::math::Line(Start, End));
       
-      prim::Path p;
-      bbs::Shapes::AddLine(p, Start, End, 0.01f * ZoomConstant);
-      Painter->DrawPath(p, false, true);
-      
-      number oldX = x;
-      x += currentW;
-      currentW *= d;
-      
-      if(i == section->segments)
+      if(i == segments ||
+        Abs(xSubOffsets[i + 1] - x) < 0.03f * zoomConstant)
         continue;
       
-      number createX = oldX;//(x + oldX) * 0.5f;
+      number createX = x;
       number createY = height * -0.0f;
       Vector createSectionPos(createX + off.x, createY + off.y);
       bool alreadyHasSection = false;
@@ -209,19 +354,20 @@ namespace notation
         }
       }
       if(!alreadyHasSection)
-        getInteractions().Add() = new Interaction(createSectionPos, section,
-          Interaction::CreateSection, 0.03f * ZoomConstant, false, false, true, i);
+        interactions.Add() = new Interaction(createSectionPos, section,
+          Interaction::CreateSection, 0.03f * zoomConstant, false, false, true, i);
     }
-    xSubOffsets[section->segments] = xOffset + TotalWidth;
+    Painter->DrawLines(ticks, 0.01f * zoomConstant,
+      Painter::LineCaps::Square);
     
     prim::Path p;
     Vector Start(xOffset, y1), End(xOffset + TotalWidth, y2);
     Start += off; End += off;
     {
       Vector tl = Start, bl = Start, tr = End, br = End;
-      number beamsize = 0.05f * ZoomConstant;
-      tl.x -= 0.005f * ZoomConstant; bl.x -= 0.005f * ZoomConstant;
-      tr.x += 0.005f * ZoomConstant; br.x += 0.005f * ZoomConstant;
+      number beamsize = 0.05f * zoomConstant;
+      tl.x -= 0.005f * zoomConstant; bl.x -= 0.005f * zoomConstant;
+      tr.x += 0.005f * zoomConstant; br.x += 0.005f * zoomConstant;
       tl.y += exponentialsize * beamsize;
       bl.y -= exponentialsize * beamsize;
       tr.y += exponentialsize * beamsize;
@@ -233,72 +379,79 @@ namespace notation
       p.AddCurve(tl);
     }
     Painter->DrawPath(p, false, true);
-    
-    for(count i = section->CountChildrenOfType<Representation::Section>() - 1;
-      i >= 0; i--)
-    {
-      Representation::Section* s =
-        section->GetChildOfType<Representation::Section>(i);
-      count ps = s->parentSegment;
-      if(ps < section->segments)
-        PaintSection(Painter, s, xSubOffsets[ps + 1] - xSubOffsets[ps],
-          height * section->scalarHeight, xSubOffsets[ps], !up, beamSlant,
-          recursion + 1);
-    }
-    
-    delete [] xSubOffsets;
+    return index + 1;
   }
   
-  void Score::Page::DrawGridlines(Painter* Painter)
+  void Score::Page::DrawGridlines(Painter* Painter,
+    const prim::math::Rectangle& visible)
   {
     Vector pageSize = getContainer()->sizePage;
     Vector gridSize = getContainer()->sizeGrid;
     Vector subgridSize = getContainer()->sizeSubgrid;
     
-    count gridcountX = (count)(pageSize.x / gridSize.x * 0.5f) + 2;
-    count gridcountY = (count)(pageSize.y / gridSize.y * 0.5f) + 2;
-    count subgridcountX = (count)(pageSize.x / subgridSize.x * 0.5f) + 2;
-    count subgridcountY = (count)(pageSize.y / subgridSize.y * 0.5f) + 2;
-    
-    prim::Path p1, p2;
+    //Only the parts of the lines crossing the visible area are drawn.
+    prim::math::Rectangle area(pageSize * -0.5f, pageSize * 0.5f);
+    if(!visible.IsEmpty())
+      area = prim::math::Rectangle::Intersection(area, visible);
+    if(area.IsEmpty())
+      return;
     
-    for(count i = -subgridcountX; i <= subgridcountX; i++)
-      bbs::Shapes::AddLine(p1,
-      Vector((number)i * subgridSize.x, pageSize.y * 0.5f),
-      Vector((number)i * subgridSize.x, pageSize.y * -0.5f), 0.005f); 
-    for(count i = -subgridcountY; i <= subgridcountY; i++)
-      bbs::Shapes::AddLine(p1,
-      Vector(pageSize.x * 0.5f, (number)i * subgridSize.y),
-      Vector(pageSize.x * -0.5f, (number)i * subgridSize.y), 0.005f);
-          
-    for(count i = -gridcountX; i <= gridcountX; i++)
-      bbs::Shapes::AddLine(p2,
-      Vector((number)i * gridSize.x, pageSize.y * 0.5f),
-      Vector((number)i * gridSize.x, pageSize.y * -0.5f), 0.01f);
-    for(count i = -gridcountY; i <= gridcountY; i++)
-      bbs::Shapes::AddLine(p2,
-      Vector(pageSize.x * 0.5f, (number)i * gridSize.y),
-      Vector(pageSize.x * -0.5f, (number)i * gridSize.y), 0.01f);
+    prim::Array<prim::math::Line> subgrid, grid;
+    AddGridlines(subgrid, area, subgridSize);
+    AddGridlines(grid, area, gridSize);
       
-    Painter->FillColor(LightGray);
+    //The lines run to the edges of the area, so their caps are never seen.
+    Painter->StrokeColor(LightGray);
     if(getDocument()->showFineGrid)
-      Painter->DrawPath(p1, false, true);
-    Painter->FillColor(Gray);
+      Painter->DrawLines(subgrid, 0.005f);
+    Painter->StrokeColor(Gray);
     if(getDocument()->showGrid)
-      Painter->DrawPath(p2, false, true);    
-    Painter->FillColor(Black);
+      Painter->DrawLines(grid, 0.01f);
+    Painter->StrokeColor(Black);
+  }
+  
+  void Score::Page::AddGridlines(prim::Array<prim::math::Line>& lines,
+    const prim::math::Rectangle& area, prim::math::Vector spacing)
+  {
+    //Casting truncates toward zero, so one extra line is taken on each side.
+    count left = (count)(area.Left() / spacing.x) - 1;
+    count right = (count)(area.Right() / spacing.x) + 1;
+    count bottom = (count)(area.Bottom() / spacing.y) - 1;
+    count top = (count)(area.Top() / spacing.y) + 1;
+    lines.Reserve(right - left + top - bottom + 2);
+    
+    for(count i = left; i <= right; i++)
+    {
+      number x = (number)i * spacing.x;
+      if(x >= area.Left() && x <= area.Right())
+        lines.Add(prim::math::Line(Vector(x, area.Top()),
+          Vector(x, area.Bottom())));
+    }
+    for(count i = bottom; i <= top; i++)
+    {
+      number y = (number)i * spacing.y;
+      if(y >= area.Bottom() && y <= area.Top())
+        lines.Add(prim::math::Line(Vector(area.Right(), y),
+          Vector(area.Left(), y)));
+    }
   }
   
   void Score::Page::DrawHandles(Painter* Painter)
   {
-    number thickness = 0.01f * ZoomConstant;
+    number zoomConstant = 1.0f / getViewer()->percentageZoom;
+    number thickness = 0.01f * zoomConstant;
+    
+    /*Handles are batched by color. A handle takes the color of the last of its
+    shapes in the order cross, rectangle, circle.*/
+    const count colorCount = 3;
+    prim::colors::RGB colors[colorCount] = {Red, Green, Blue};
+    prim::Array<prim::math::Line> lines[colorCount];
+    prim::Array<prim::math::Rectangle> boxes[colorCount];
+    prim::Path circles;
        
-    for(count i = getInteractions().n() - 1; i >= 0; i--)
+    for(count i = interactions.n() - 1; i >= 0; i--)
     {
-      Painter->FillColor(Red);
-      Painter->StrokeColor(Blue);
-      
-      Interaction* interaction = getInteractions()[i];
+      Interaction* interaction = interactions[i];
       Vector c = interaction->position;
       number r = interaction->radius;
       Vector tl, tr, bl, br;
@@ -307,165 +460,111 @@ namespace notation
       bl.y = br.y = c.y - r;
       tl.y = tr.y = c.y + r;
       
-      prim::Path pf, ps;
+      count color = 0;
+      if(interaction->drawRectangle)
+        color = 1;
+      if(interaction->drawCircle)
+        color = 2;
+      
       if(interaction->drawCross)
       {
-        bbs::Shapes::AddLine(pf, tl, br, thickness);
-        bbs::Shapes::AddLine(pf, bl, tr, thickness);
-        Painter->FillColor(Red);
-        Painter->StrokeColor(Red);
+        lines[color].Add(prim::math::Line(tl, br));
+        lines[color].Add(prim::math::Line(bl, tr));
       }
       if(interaction->drawRectangle)
-      {
-        bbs::Shapes::AddLine(pf, tl, tr, thickness);
-        bbs::Shapes::AddLine(pf, tr, br, thickness);
-        bbs::Shapes::AddLine(pf, br, bl, thickness);
-        bbs::Shapes::AddLine(pf, bl, tl, thickness);
-        Painter->FillColor(Green);
-        Painter->StrokeColor(Green);         
-      }
+        boxes[color].Add(prim::math::Rectangle(bl, tr));
       if(interaction->drawCircle)
-      {
-        bbs::Shapes::AddCircle(ps, c, r);
-        Painter->FillColor(Blue);
-        Painter->StrokeColor(Blue);
-      }
-      
-      Painter->DrawPath(pf, false, true);
-      Painter->DrawPath(ps, true, false, true, thickness);
+        bbs::Shapes::AddCircle(circles, c, r);
+    }
+    
+    for(count i = 0; i < colorCount; i++)
+    {
+      Painter->StrokeColor(colors[i]);
+      Painter->DrawLines(lines[i], thickness, Painter::LineCaps::Square);
+      Painter->DrawRectangles(boxes[i], thickness);
     }
+    Painter->StrokeColor(Blue);
+    Painter->DrawPath(circles, true, false, true, thickness);
     Painter->FillColor(Black);
     Painter->StrokeColor(Black);    
   }
   
   void Score::Page::Paint(Painter* Painter)
   {
-    ZoomConstant = 1.0 / getViewer()->percentageZoom;
-    
-    State.RemoveAll();
+    //Handles and lines keep the same size on screen at any zoom.
+    number zoomConstant = 1.0f / getViewer()->percentageZoom;
     
     Vector pageSize = getContainer()->sizePage;
     Painter->FillColor(Black);  
+    Painter->StrokeColor(Black);
     
     Painter->Translate(pageSize * 0.5f);
     {
       //Caches some objects.
-      Representation::Section* s =
-        getContainer()->GetChildOfType<Representation::Section>();
+      Representation::Section* s = section;
       Vector ssize = getContainer()->sizeMainSection;
       Vector off = getContainer()->offsetMainSection;
           
       //Remove existing interactive handles.
-      getInteractions().RemoveAndDeleteAll();
+      interactions.RemoveAndDeleteAll();
+      
+      //Find the visible part of the page relative to its center.
+      prim::math::Rectangle visible;
+      if(Renderer* renderer = Painter->Interface<Renderer>())
+        visible = renderer->properties->visibleArea;
+      if(!visible.IsEmpty())
+      {
+        visible.Order();
+        visible = prim::math::Rectangle(visible.a - pageSize * 0.5f,
+          visible.b - pageSize * 0.5f);
+        
+        //Leave room for things that reach into view, such as the handles.
+        visible.Dilate(0.15f * zoomConstant);
+      }
       
       //Draw the grid lines.
-      DrawGridlines(Painter);
+      DrawGridlines(Painter, visible);
       
       //Add an offset changer.
       Vector crosspos = off;
       crosspos.y += ssize.y * 0.5f;
-      getInteractions().Add() = new Interaction(crosspos, s,
-        Interaction::MainSectionPosition, 0.08f * ZoomConstant, true, false, false);
+      interactions.Add() = new Interaction(crosspos, s,
+        Interaction::MainSectionPosition, 0.08f * zoomConstant, true, false, false);
         
       //Add an main width changers.
       Vector lwidthchanger = off, rwidthchanger = off;
       lwidthchanger.y = rwidthchanger.y = off.y + ssize.y * 0.5f;
       lwidthchanger.x -= ssize.x * 0.5f;
       rwidthchanger.x += ssize.x * 0.5f;
-      getInteractions().Add() = new Interaction(lwidthchanger, s,
-        Interaction::MainSectionWidth, 0.12f * ZoomConstant, false, true, false);        
-      getInteractions().Add() = new Interaction(rwidthchanger, s,
-        Interaction::MainSectionWidth, 0.12f * ZoomConstant, false, true, false);
+      interactions.Add() = new Interaction(lwidthchanger, s,
+        Interaction::MainSectionWidth, 0.12f * zoomConstant, false, true, false);        
+      interactions.Add() = new Interaction(rwidthchanger, s,
+        Interaction::MainSectionWidth, 0.12f * zoomConstant, false, true, false);
 
-      //Draw the beam sections.
-      PaintSection(Painter, s, ssize.x, ssize.y, ssize.x * -0.5f, true,
-        getContainer()->scalarBeamSlant, 1);
+      //Lay out and draw the beam sections.
+      Feather feather;
+      feather.evaluate(s, ssize.x * -0.5f, ssize.x);
+      
+      //Only the screen needs detail limited to what its pixels can show.
+      number pixelsPerInch = 0;
+      if(Painter->Interface<Renderer>())
+        pixelsPerInch = getViewer()->pixelsPerInch();
+      prim::Path bands;
+      for(count i = 0; i < feather.sections.n();)
+        i = PaintSection(Painter, feather, i, ssize.y,
+          getContainer()->scalarBeamSlant, pixelsPerInch, zoomConstant,
+          visible, bands);
+      if(bands.Components.n())
+        Painter->DrawPath(bands, false, true);
       
       //Draw the ground line.
       Vector GroundLeft(getContainer()->sizeMainSection.x * -0.5f - 0.005f, 0),
         GroundRight(getContainer()->sizeMainSection.x * 0.5f + 0.005f, 0);   
       GroundLeft += off; GroundRight += off;
-      prim::Path p;
-      Shapes::AddLine(p, GroundLeft, GroundRight, 0.04f * ZoomConstant, false, false, false);
-      Painter->DrawPath(p, false, true);
-
-      //Draw all the interactive handles.
-      if(!getDocument()->temporarilyHideHandles)
-        DrawHandles(Painter);
+      prim::Array<prim::math::Line> ground;
+      ground.Add(prim::math::Line(GroundLeft, GroundRight));
+      Painter->DrawLines(ground, 0.04f * zoomConstant);
     }
     Painter->UndoTransformation();
-    
-    
-    //Find maximum
-    if(!State.n())
-      return;
-      
-    prim::number min = State[0].Position, max = min;
-    for(count i = 0; i < State.n(); i++)
-    {
-      min = prim::math::Min(min, State[i].Position);
-      max = prim::math::Max(max, State[i].Position);
-    }
-    for(count i = 0; i < State.n(); i++)
-    {
-      State[i].Position += -min;
-      State[i].Position = State[i].Position / (max - min);
-    }
-    prim::number mindist = 1.0;
-    
-    for(count i = 0; i < State.n(); i++)
-    {
-      for(count j = 0; j < State.n(); j++)
-      {
-        if(i == j) continue;
-        if(math::Abs(State[i].Position - State[j].Position) < 0.00001 &&
-          State[i].Level < State[j].Level)
-        {
-          State.Remove(j);
-          i = 0;
-          j = -1;
-        }
-      }
-    }
-    State.Sort();
-    for(count i = 1; i < State.n(); i++)
-    {
-      mindist = math::Min(mindist, State[i].Position - State[i - 1].Position);
-    }
-    prim::String s;
-    s += "INFO BEGIN";
-    s += "Minimum Distance: ";
-    s &= mindist;
-    s++;
-    for(count i = 0; i < State.n(); i++)
-    {
-      PositionInfo p = State[i];
-      for(count j = 1; j < p.Level; j++)
-        s &= "  ";
-      if(p.Position == 0.0)
-        s &= "0.0000000";
-      else if(p.Position == 1.0)
-        s &= "1.0000000";
-      else
-      {
-        prim::String x = math::NumberToString(p.Position, 7);
-        for(count k = 9 - x.n(); k > 0; k--)
-          x &= "0";
-        s &= x;
-      }
-      
-      s++;
-    }
-    s &= "INFO END";
-    prim::String f =
-      juce::File::getSpecialLocation(
-      juce::File::userDesktopDirectory).getFullPathName().toRawUTF8();
-    f &= "/Info.txt";
-    prim::File::Write(f, (const byte*)s.Merge(), s.n());
-    /*
-    prim::Console c;
-    c += s;
-    c++;
-    */
   }
 }
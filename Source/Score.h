@@ -30,23 +30,92 @@
 
 namespace notation
 {
+  struct Feather;
+  
   struct Score : public bbs::abstracts::Portfolio, public DocumentHandler
   {
     Score(Document* Document);
     ~Score();
+    
+    /**Makes one page for each main section of the container, in order, and
+    sizes them all to the page size of the container. If the main sections
+    have not changed, the existing pages are kept.*/
+    void paginate(void);
+
+    /**Lists the onsets of the beam sections in ascending order, along with
+    their levels in the section tree. Positions are measured in pages, so the
+    main section of page i spans from i to i + 1.*/
+    void mergeOnsets(prim::Array<prim::number>& positions,
+      prim::Array<prim::count>& levels);
+
+    /**Writes the onsets of the beam sections to an AIFF or WAV file as a
+    click track. Each page spans the given number of seconds, and each level
+    of the section tree has its own click.*/
+    bool exportClickTrack(const prim::String& filename, prim::number seconds,
+      bool wav);
+
+    /**Hands the onsets of the beam sections to the rhythm preview if it is
+    playing. Each page lasts for the rhythm duration of the document.*/
+    void publishOnsets(void);
+
+    /**Called once an edit of the sections is complete. Hands the new onsets
+    to the rhythm preview. If BLUME_WRITE_ONSET_INFO is defined, the onsets
+    are also written to Info.txt on the desktop for analysis.*/
+    void sectionsChanged(void);
 
     struct Page : public Portfolio::Canvas, public DocumentHandler
     {
       Score* score;
+      
+      ///The main section drawn on this page
+      Representation::Section* section;
+      
+      ///The handles from the last paint, relative to the center of the page
+      prim::List<Interaction*> interactions;
+      
+      /**The interaction handles are painted in their own layer so that the
+      screen can show, hide or update them without repainting the score.*/
+      struct Handles : public Canvas::Layer
+      {
+        Page* page;
+        
+        Handles(Page* page);
+        
+        void Paint(bbs::abstracts::Painter* Painter);
+      };
+      
+      ///Index of the handle layer in Layers
+      static const prim::count handleLayer = 0;
 
-      Page(Document* document, Score& score);
+      Page(Document* document, Score& score,
+        Representation::Section* section);
+      ~Page();
       
-      void PaintSection(bbs::abstracts::Painter* Painter,
-        Representation::Section* section,
-        prim::number width, prim::number height, prim::number xOffset, bool up,
-        prim::number beamSlant, prim::count recursion);
+      ///Segment spacing in screen pixels below which a section is a band
+      static const prim::count detailPixels = 2;
+      
+      /**Draws one section of an evaluated feather along with its handles.
+      The height is that of the main section. If the segments are too fine
+      to see at the given pixels-per-inch, the section and its subtree are
+      added to the bands to be filled instead; zero pixels-per-inch draws
+      everything. Sizes meant to stay the same on screen are multiplied by the
+      zoom constant. Sections outside the visible area, relative to the
+      center of the page, are skipped unless the area is empty. Returns the
+      index of the next section to draw.*/
+      prim::count PaintSection(bbs::abstracts::Painter* Painter,
+        const Feather& feather, prim::count index, prim::number height,
+        prim::number beamSlant, prim::number pixelsPerInch,
+        prim::number zoomConstant, const prim::math::Rectangle& visible,
+        prim::Path& bands);
 
-      void DrawGridlines(bbs::abstracts::Painter* Painter);
+      /**Draws the grid lines that cross the visible area, or the whole page
+      if the area is empty.*/
+      void DrawGridlines(bbs::abstracts::Painter* Painter,
+        const prim::math::Rectangle& visible);
+      
+      ///Adds the lines of a grid with the given spacing that cross the area.
+      static void AddGridlines(prim::Array<prim::math::Line>& lines,
+        const prim::math::Rectangle& area, prim::math::Vector spacing);
       
       void DrawHandles(bbs::abstracts::Painter* Painter);
 
@@ -31,13 +31,64 @@
 #include "Page.h"
 #include "Score.h"
 
+prim::number Viewer::pixelsPerInch(void)
+{
+  /*The desktop resolution does not tell the physical size of the display, so
+  the screen is taken to have the customary 96 dots-per-inch.*/
+  return 96.0f * percentageZoom;
+}
+
+juce::Rectangle<int> Viewer::visiblePixels(Page* page)
+{
+  juce::Rectangle<int> visible = page->getLocalBounds();
+  if(juce::Component* parent = page->getParentComponent())
+    visible = visible.getIntersection(
+      page->getLocalArea(parent, parent->getLocalBounds()));
+  return visible;
+}
+
+prim::math::Rectangle Viewer::visiblePageArea(Page* page)
+{
+  using namespace prim;
+  using namespace math;
+  
+  juce::Rectangle<int> visible = visiblePixels(page);
+  if(visible.isEmpty() || !page->getWidth())
+    return prim::math::Rectangle();
+  
+  //Pixels run downwards from the top of the page and inches upwards.
+  Vector inPageDimensions =
+    Inches(getCanvas(page->getPageIndex())->Dimensions);
+  number inchesPerPixel = inPageDimensions.x / (number)page->getWidth();
+  return prim::math::Rectangle(
+    (number)visible.getX() * inchesPerPixel,
+    inPageDimensions.y - (number)visible.getBottom() * inchesPerPixel,
+    (number)visible.getRight() * inchesPerPixel,
+    inPageDimensions.y - (number)visible.getY() * inchesPerPixel);
+}
+
+prim::count Viewer::pageAtPixel(prim::number x)
+{
+  prim::count low = 0, high = pixelsPageSizes.n() - 1;
+  while(low < high)
+  {
+    prim::count middle = (low + high + 1) / 2;
+    if(pixelsPageLefts[middle] <= x)
+      low = middle;
+    else
+      high = middle - 1;
+  }
+  return low;
+}
+
 void Viewer::positionPages(bool optimize)
 {
   using namespace prim;
   using namespace math;
   
   //Make sure there are pages to position.
-  if(!getPageCount())
+  count pageCount = getPageCount();
+  if(!pageCount)
     return;
   
   //Get the work area dimensions and focus point.
@@ -46,66 +97,41 @@ void Viewer::positionPages(bool optimize)
   Vector work_area_focus(
     work_area.x * focusScreenRelative.x, work_area.y * focusScreenRelative.y);
   
-  //Get the current resolution of the desktop.
-  const juce::Desktop& desktop = juce::Desktop::getInstance();
-  juce::Rectangle<int> desktop_rectangle = desktop.getDisplays().getTotalBounds(false);
-  Vector desktop_resolution((number)desktop_rectangle.getWidth(),
-                            (number)desktop_rectangle.getHeight());
-  
-  //Calculate the screen's dots-per-inch.
-  number dpi = desktop_resolution.Mag();
-  //dpi /= globals()->inDisplayDiagonalSize;
-  dpi = 96.0f;
-  
-  //Take into account the zoom.
-  dpi *= percentageZoom;
-  
-  //Go through each page and calculate its pixel dimensions.
-  List<Vector> pixelsPageDimensions;
-  for(count i = 0; i < getCanvasCount(); i++)
-  {
-    Inches inPageDimensions = getCanvas(i)->Dimensions;
-    pixelsPageDimensions.Add() = Vector(inPageDimensions.x * dpi, 
-                                        inPageDimensions.y * dpi);
-  }
+  //Get the screen's dots-per-inch at the current zoom.
+  number dpi = pixelsPerInch();
+  number gap = (number)globals()->pixelsHorizontalDistanceBetweenPages;
   
-  //Determine the index of the focus page.
-  bool foundPointer = false;
-  for(count i = 0; i < getPageCount(); i++)
+  /*Lay the pages out in a row, each rounded to whole pixels. The left edges
+  are kept as a running sum so that a page can be found and placed without
+  visiting the ones before it. This only has to be done again when the zoom
+  or the pages change.*/
+  if(dpi != pixelsPerInchOfLayout || pixelsPageSizes.n() != pageCount)
   {
-    if(getPage(i) == focusPage)
+    pixelsPerInchOfLayout = dpi;
+    pixelsPageLefts.n(pageCount + 1);
+    pixelsPageSizes.n(pageCount);
+    pixelsPageLefts[0] = 0;
+    pixelsPagesHeight = 0;
+    for(count i = 0; i < pageCount; i++)
     {
-      foundPointer = true;
-      focusIndex = i;
-      break;
+      Inches inPageDimensions = getCanvas(i)->Dimensions;
+      Vector pixelsDimensions(inPageDimensions.x * dpi + 0.5f,
+                              inPageDimensions.y * dpi + 0.5f);
+      pixelsDimensions.x = (number)((int)pixelsDimensions.x);
+      pixelsDimensions.y = (number)((int)pixelsDimensions.y);
+      pixelsPageSizes[i] = pixelsDimensions;
+      pixelsPageLefts[i + 1] = pixelsPageLefts[i] + pixelsDimensions.x + gap;
+      pixelsPagesHeight = Max(pixelsPagesHeight, pixelsDimensions.y);
     }
   }
   
-  /*Use the old focus index, or the first or last page if the pointer was 
-   invalid.*/
-  if(!foundPointer)
-  {
-    if(focusIndex < 0)
-    {
-      //Totally out of bounds... just reset to the first page.
-      focusIndex = 0;
-      focusPage = getPages().first();
-    }
-    else if(focusIndex >= getPageCount())
-    {
-      //Totally out of bounds... just reset to the last page.
-      focusIndex = getPageCount() - 1;
-      focusPage = getPages().last();
-    }
-    else
-    {
-      //Index is OK, just look up new pointer.
-      focusPage = getPage(focusIndex);
-    }
-  }
+  //Use the page in focus if it has one, or else the last known index.
+  if(focusPage)
+    focusIndex = focusPage->getPageIndex();
+  focusIndex = Min(Max(focusIndex, (count)0), pageCount - 1);
   
   //Calculate the focal pixel of the focal page.
-  Vector page_focus_dimensions = pixelsPageDimensions[focusIndex];
+  Vector page_focus_dimensions = pixelsPageSizes[focusIndex];
   Vector page_focus(page_focus_dimensions.x * focusPageRelative.x,
                     page_focus_dimensions.y * focusPageRelative.y);
   
@@ -113,11 +139,7 @@ void Viewer::positionPages(bool optimize)
   Vector bias;
   
   //First compute the leading bias.
-  for(count i = 0; i < focusIndex; i++)
-  {
-    bias.x -= pixelsPageDimensions[i].x + 
-    globals()->pixelsHorizontalDistanceBetweenPages;
-  }
+  bias.x -= pixelsPageLefts[focusIndex];
   
   //Now add the focus bias.
   bias.x -= page_focus.x;
@@ -131,16 +153,8 @@ void Viewer::positionPages(bool optimize)
   if(optimize)
   {
     prim::number edge = (prim::number)globals()->pixelsEdgeOfPageToDisplay;
-    prim::number totalWidth = 0;
-    prim::number maxHeight = 0;
-    for(count i = 0; i < getPageCount(); i++)
-    {
-      totalWidth += pixelsPageDimensions[i].x;
-      if(i)
-        totalWidth += 
-        (prim::number)globals()->pixelsHorizontalDistanceBetweenPages;
-      maxHeight = Max(maxHeight, pixelsPageDimensions[i].y);
-    }
+    prim::number totalWidth = pixelsPageLefts[pageCount] - gap;
+    prim::number maxHeight = pixelsPagesHeight;
     
     //Horizontal consideration...
     if(totalWidth <= getContent()->getWidth())
@@ -163,26 +177,23 @@ void Viewer::positionPages(bool optimize)
       bias.y = (number)getContent()->getHeight() - edge - maxHeight;
   }
   
-  //Now set the position of the pages.
-  number left = 0;
-  
   //Rounding error correction
-  left += 0.5f;
   bias += 0.5f;
-  
-  left = (number)((int)left);
   bias.x = (number)((int)bias.x);
   bias.y = (number)((int)bias.y);
   
-  for(count i = 0; i < getPageCount(); i++)
+  /*Only the pages in view and one on either side have components, so that
+  the next page is ready as it scrolls into view.*/
+  count first = Max(pageAtPixel(-bias.x) - 1, (count)0);
+  count last = Min(pageAtPixel(work_area.x - bias.x) + 1, pageCount - 1);
+  getContent()->showPages(first, last);
+  
+  const prim::Array<count>& shown = getContent()->shownPages;
+  for(count j = 0; j < shown.n(); j++)
   {
-    
-    Vector pixelsTopLeft = Vector(left + bias.x, bias.y);
-    Vector pixelsDimensions = pixelsPageDimensions[i];
-    
-    pixelsDimensions += 0.5f;
-    pixelsDimensions.x = (number)((int)pixelsDimensions.x);
-    pixelsDimensions.y = (number)((int)pixelsDimensions.y);
+    count i = shown[j];
+    Vector pixelsTopLeft = Vector(pixelsPageLefts[i] + bias.x, bias.y);
+    Vector pixelsDimensions = pixelsPageSizes[i];
     
     getPage(i)->pixelsTopLeft = pixelsTopLeft;
     getPage(i)->pixelsDimensions = pixelsDimensions;
@@ -195,17 +206,15 @@ void Viewer::positionPages(bool optimize)
                                (int)pixelsDimensions.y);
     
     if(old_bounds != new_bounds)
-      getDocument()->pages[i]->setBounds(new_bounds);
-    
-    left += pixelsDimensions.x + 
-      globals()->pixelsHorizontalDistanceBetweenPages;
+      getPage(i)->setBounds(new_bounds);
   }
   
   return;
 }
 
 Viewer::Viewer(Document* document) : DocumentHandler(document), 
-  percentageZoom(0.75f), focusPage(0), focusIndex(0)
+  percentageZoom(0.75f), scalingSnapshots(false), focusPage(0), focusIndex(0),
+  pixelsPagesHeight(0), pixelsPerInchOfLayout(0)
 {
   using namespace prim;
   using namespace math;
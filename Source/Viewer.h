@@ -40,6 +40,20 @@ struct Viewer : public DocumentHandler
 
   ///Zoom level normalized around one. 1.0 = 100%, 0.5 = 50%, etc.
   prim::number percentageZoom;
+  
+  /**While the zoom is being dragged, the pages scale the score they last
+  rendered instead of rendering it again at every step.*/
+  bool scalingSnapshots;
+  
+  ///Returns the number of screen pixels per inch of page at the current zoom.
+  prim::number pixelsPerInch(void);
+
+  ///Returns the part of a page inside the content area in page pixels.
+  juce::Rectangle<int> visiblePixels(Page* page);
+  
+  /**Returns the part of a page inside the content area in inches from the
+  bottom-left corner of the page.*/
+  prim::math::Rectangle visiblePageArea(Page* page);
 
   ///A pointer to the current page.
   Page* focusPage;
@@ -60,6 +74,24 @@ struct Viewer : public DocumentHandler
   the screen. This commonly occurs when the user drags the page "too far" and
   leaves a lot of blank space which could otherwise show more information.*/
   void positionPages(bool optimize = false);
+  
+  /**Left edge of each page in pixels from the left edge of the first page.
+  The extra last entry is the width of all the pages and the gaps after
+  them.*/
+  prim::Array<prim::number> pixelsPageLefts;
+  
+  ///Size of each page in pixels
+  prim::Array<prim::math::Vector> pixelsPageSizes;
+  
+  ///Height of the tallest page in pixels
+  prim::number pixelsPagesHeight;
+  
+  ///Resolution the pages were last laid out at, or zero to lay them out again
+  prim::number pixelsPerInchOfLayout;
+  
+  /**Returns the index of the page at a horizontal distance in pixels from the
+  left edge of the first page. The gap after a page belongs to it.*/
+  prim::count pageAtPixel(prim::number x);
 
   Viewer(Document* document);
 };
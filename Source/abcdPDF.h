@@ -46,6 +46,209 @@ namespace abcd
   {
     friend class bbs::abstracts::Portfolio;
   public:
+    /**Open-addressing hash table from 64-bit keys to indices. Several entries
+    may share a key, so a lookup walks the probe sequence of the key and the
+    caller tests each candidate it returns.*/
+    struct FormTable
+    {
+      ///Index plus one stored in each slot, or zero for an empty slot.
+      prim::Array<prim::count> Slots;
+
+      ///Key of the entry in each slot.
+      prim::Array<prim::uint64> Keys;
+
+      ///Number of slots in use.
+      prim::count Used;
+
+      FormTable() : Used(0) {}
+
+      ///Removes all entries.
+      void Clear(void)
+      {
+        Slots.Clear();
+        Keys.Clear();
+        Used = 0;
+      }
+
+      ///Scrambles the key so that every bit affects the slot (MurmurHash3).
+      static prim::uint64 Mix(prim::uint64 Key)
+      {
+        Key ^= Key >> 33;
+        Key *= (prim::uint64)0xff51afd7ed558ccdULL;
+        Key ^= Key >> 33;
+        Key *= (prim::uint64)0xc4ceb9fe1a85ec53ULL;
+        return Key ^ (Key >> 33);
+      }
+
+      /**Returns the next index stored under the key, or -1 once there are no
+      more. The position starts at -1 and is advanced by each call.*/
+      prim::count Find(prim::uint64 Key, prim::count& Position) const
+      {
+        if(!Slots.n())
+          return -1;
+        prim::count Mask = Slots.n() - 1;
+        Position = Position < 0 ? (prim::count)(Mix(Key) & (prim::uint64)Mask) :
+          (Position + 1) & Mask;
+        for(; Slots[Position]; Position = (Position + 1) & Mask)
+          if(Keys[Position] == Key)
+            return Slots[Position] - 1;
+        return -1;
+      }
+
+      ///Adds an index under the key, growing the table to stay under 3/4 full.
+      void Insert(prim::uint64 Key, prim::count Index)
+      {
+        using namespace prim;
+        if((Used + 1) * 4 > Slots.n() * 3)
+        {
+          Array<count> OldSlots;
+          Array<uint64> OldKeys;
+          OldSlots.MoveFrom(Slots);
+          OldKeys.MoveFrom(Keys);
+          count Size = OldSlots.n() ? OldSlots.n() * 2 : 16;
+          Slots.n(Size);
+          Keys.n(Size);
+          for(count i = 0; i < Size; i++)
+            Slots[i] = 0;
+          Used = 0;
+          for(count i = 0; i < OldSlots.n(); i++)
+            if(OldSlots[i])
+              Insert(OldKeys[i], OldSlots[i] - 1);
+        }
+        count Mask = Slots.n() - 1;
+        count Position = (count)(Mix(Key) & (uint64)Mask);
+        while(Slots[Position])
+          Position = (Position + 1) & Mask;
+        Slots[Position] = Index + 1;
+        Keys[Position] = Key;
+        Used++;
+      }
+    };
+
+    /**\brief Remembers what the last save of a document wrote, so that the
+    next save to the same file can be appended to it as an incremental update
+    instead of rewriting it. \details The caller marks the pages that it
+    changes with PageChanged, or all of them with AllPagesChanged. The next
+    save to the same file then paints only those pages, each into a content
+    stream with resources of its own, and appends them in place of their old
+    page and content objects, keeping the object numbers, together with the
+    metadata. Fonts and forms that the file already has are referred to by
+    number; a font is embedded again only if a page draws characters that
+    are missing from its subset. A page that comes out the same as it was
+    last appended is left out. If every page changed, or the number of pages
+    changed, the whole file is written again. Keep one of these per document
+    and pass it in with Properties::LastSave.*/
+    class Revision
+    {
+    public:
+      ///The objects of a page in the file
+      struct Page
+      {
+        ///Object numbers of the page dictionary and its content stream
+        prim::count Header, Content;
+
+        ///Hash of what the page drew when last appended, or zero if unknown
+        prim::uint64 Hash;
+
+        ///Whether the page has changed since the last save
+        bool Changed;
+      };
+
+      ///A Form XObject in the file that later pages can refer to
+      struct Form
+      {
+        ///Hash and operators of the content stream
+        prim::uint64 Hash;
+        prim::String Content;
+
+        ///Stroke width that the bounding box was padded by
+        prim::number StrokeWidth;
+
+        ///Object number of the form
+        prim::count Number;
+      };
+
+      ///The file that was last written
+      prim::String Filename;
+
+      ///The length of the file after it was written
+      prim::count FileLength;
+
+      ///The offset of the last cross-reference section in the file
+      prim::count XRefLocation;
+
+      ///One more than the highest object number in the file
+      prim::count Size;
+
+      ///Object numbers of the catalog, info, page tree and metadata
+      prim::count Root, Info, PageTree, Metadata;
+
+      ///Hash of the metadata object as last written
+      prim::uint64 MetadataHash;
+
+      ///The pages of the file in order
+      prim::Array<Page> Pages;
+
+      ///Each embedded font, the number of its font dictionary, and its glyphs
+      prim::Array<const bbs::Font*> Fonts;
+      prim::Array<prim::count> FontNumbers;
+      prim::Array<prim::byte> FontCharacterUsage;
+
+      ///The forms in the file and an index of them by the hash of content
+      prim::Array<Form> Forms;
+      FormTable FormsByContent;
+
+      ///Settings that every page was painted with, given by the caller
+      prim::String PageSettings;
+
+      ///Whether every page has changed since the last save
+      bool AllChanged;
+
+      ///Marks a page as changed so that the next save paints it again.
+      void PageChanged(prim::count Index)
+      {
+        if(Index >= 0 && Index < Pages.n())
+          Pages[Index].Changed = true;
+        else
+          AllChanged = true;
+      }
+
+      ///Marks every page as changed, so that the next save rewrites the file.
+      void AllPagesChanged(void)
+      {
+        AllChanged = true;
+      }
+
+      /**Notes anything besides the pages themselves that the pages are
+      painted with, such as drawing settings. If it differs from the last
+      save, every page has changed.*/
+      void SetPageSettings(const prim::String& Settings)
+      {
+        if(Settings != PageSettings)
+          AllChanged = true;
+        PageSettings = Settings;
+      }
+
+      ///Forgets the last save so that the next one rewrites the whole file.
+      void Clear(void)
+      {
+        Filename.Clear();
+        FileLength = XRefLocation = Size = 0;
+        Root = Info = PageTree = Metadata = 0;
+        MetadataHash = 0;
+        Pages.Clear();
+        Fonts.Clear();
+        FontNumbers.Clear();
+        FontCharacterUsage.Clear();
+        Forms.Clear();
+        FormsByContent.Clear();
+        AllChanged = true;
+      }
+
+      Revision() : FileLength(0), XRefLocation(0), Size(0), Root(0), Info(0),
+        PageTree(0), Metadata(0), MetadataHash(0), AllChanged(true) {}
+    };
+
     /**\brief Properties structure to supply the PDF class with additional
     PDF-specific information.*/
     class Properties : public bbs::abstracts::Painter::Properties
@@ -76,11 +279,47 @@ namespace abcd
       concern.*/
       bool UseCMYKInsteadOfRGB;
 
+      /**Embeds only the glyphs of each TrueType font that were actually used
+      by the text on the pages. This is on by default and reduces the font
+      payload from the size of the whole font program to a few kilobytes. If
+      a font can not be subset, the whole program is embedded instead.*/
+      bool SubsetFonts;
+
+      /**Writes a PDF 1.5 file in which all of the objects that are not
+      streams are packed into compressed object streams, and the classic
+      cross-reference table is replaced by a compressed cross-reference
+      stream. This makes files with many small objects much smaller. Content
+      streams (including the metadata) are left as they are, so the metadata
+      can still be retrieved. Since PDF/X-1a requires PDF 1.3, the file no
+      longer claims PDF/X conformance. This is off by default.*/
+      bool UseObjectStreams;
+
+      /**The record of the last save of this document, or null. If the file
+      is being saved to the same filename and has not changed on disk since
+      then, only the changed objects are appended to it and Output holds just
+      the appended update (which is empty if nothing changed). The record is
+      updated after each save. Incremental updates are not made with object
+      streams.*/
+      Revision* LastSave;
+
+      ///Set by the painter if Output is an incremental update.
+      bool WroteIncrementalUpdate;
+
+      /**Paints the canvases at the same time on several threads, each into
+      its own content stream, and then assembles the pages in order. Each
+      page names its own resources, which refer to the fonts and forms shared
+      by the whole file. The canvases must be safe to paint at the same time.
+      This is off by default.*/
+      bool PaintCanvasesInParallel;
+
       Properties() : CTMMultiplier(1.0f), ExtraData(0),
-      ExtraDataLength(0), UseCMYKInsteadOfRGB(true) {}
+      ExtraDataLength(0), UseCMYKInsteadOfRGB(true), SubsetFonts(true),
+      UseObjectStreams(false), LastSave(0), WroteIncrementalUpdate(false),
+      PaintCanvasesInParallel(false) {}
     };
 
-    ///Method to search an existing PDF file for BBS created metadata.
+    /**Method to search an existing PDF file for BBS created metadata. If the
+    file has incremental updates, the metadata of the last one is returned.*/
     static prim::count RetrievePDFMetadata(prim::String Filename, 
       prim::byte*& ByteData)
     {
@@ -111,6 +350,7 @@ namespace abcd
         if(FoundIndex)
         {
           HexStart = i + CodeLength;
+          HexLength = 0;
           for(count k = HexStart; k < SearchLimit; k++)
           {
             if(WholeFile[k] == (byte)'|')
@@ -119,7 +359,9 @@ namespace abcd
               break;
             }
           }
-          break;
+
+          //Keep searching since later incremental updates supersede this.
+          i = HexStart + HexLength;
         }
       }
 
@@ -231,6 +473,10 @@ namespace abcd
       ///The object's PDF content stream
       prim::String Content;
 
+      /**\brief Indicates whether the object is a stream, in which case the
+      content is written as one even if it is empty.*/
+      bool IsStream;
+
       /**\brief A list of pending cross-references to be inserted into
       dictionaries*/
       prim::List<XRef> DictionaryXRefs;
@@ -241,7 +487,8 @@ namespace abcd
 
       /**\brief Default constructor turns on auto-brackets and zeroes
       everything else.*/
-      Object() : XRefIndex(0), XRefOffset(0), NoAutoBrackets(false) {}
+      Object() : XRefIndex(0), XRefOffset(0), NoAutoBrackets(false),
+        IsStream(false) {}
 
       /**\brief Inserts an object cross-reference to be committed to the
       current end of the dictionary string.*/
@@ -302,13 +549,284 @@ namespace abcd
 
     ///A list of pointers to valid Font objects.
     prim::List<bbs::Font*> FontList;
+
+    /**Flags for each of the 256 character codes of each font in the font
+    list indicating whether the code was drawn, so that the embedded fonts
+    can be subset.*/
+    prim::Array<prim::byte> FontCharacterUsage;
     
     ///The number of images used.
     prim::List<Object*> ImageList;
 
+    /**Describes a path which has been written once as a Form XObject so that
+    later occurrences can invoke it with Do instead of repeating operators.*/
+    struct Form
+    {
+      ///Path the form was requested for by address, or null if unknown.
+      const prim::Path* Source;
+
+      ///Stroke, fill and close flags the form was recorded with.
+      prim::count Mode;
+
+      ///Stroke width used to pad the bounding box.
+      prim::number StrokeWidth;
+
+      ///Hash of the content stream used to find identical forms quickly.
+      prim::uint64 Hash;
+
+      ///The Form XObject whose content stream holds the path operators.
+      Object* XObject;
+    };
+
+    ///The Form XObjects created for reused paths, named /Fm0, /Fm1, etc.
+    prim::Array<Form> FormList;
+
+    ///Forms of the form list by the hash of their content stream.
+    FormTable FormsByContent;
+
+    ///Forms of the form list by source path, mode and stroke width.
+    FormTable FormsByPath;
+
+    ///Returns the key of a form in the table of forms by path.
+    static prim::uint64 PathKey(const prim::Path* Source, prim::count Mode,
+      prim::number StrokeWidth)
+    {
+      prim::uint64 Key = HashData((const prim::byte*)&Source, sizeof(Source));
+      Key = HashData((const prim::byte*)&Mode, sizeof(Mode), Key);
+      return HashData((const prim::byte*)&StrokeWidth, sizeof(StrokeWidth),
+        Key);
+    }
+
+    ///Adds a form to the form list and to its tables.
+    Form& AddForm(const Form& NewForm)
+    {
+      Form& f = FormList.AddOne();
+      f = NewForm;
+      FormsByContent.Insert(f.Hash, FormList.n() - 1);
+      if(f.Source)
+        FormsByPath.Insert(PathKey(f.Source, f.Mode, f.StrokeWidth),
+          FormList.n() - 1);
+      return f;
+    }
+
+    /**Returns the index of the form whose content is exactly the given
+    operators and which was recorded with the given stroke width, or -1.*/
+    prim::count FindFormByContent(const prim::String& Operators,
+      prim::number StrokeWidth, prim::uint64 Hash) const
+    {
+      prim::count Position = -1;
+      for(prim::count i; (i = FormsByContent.Find(Hash, Position)) >= 0;)
+      {
+        const Form& f = FormList.GetConstItem(i);
+        if(f.StrokeWidth == StrokeWidth && f.XObject->Content == Operators)
+          return i;
+      }
+      return -1;
+    }
+
     ///Default constructor for the PDF painter
     PDF() : RasterObject(0) {}
 
+    /**A canvas painted into a painter of its own on a worker thread. Once
+    its objects are taken over, the maps give the object in the file for
+    each font, form and image name used by the page.*/
+    struct Recording
+    {
+      ///The canvas being painted
+      bbs::abstracts::Portfolio::Canvas* Canvas;
+
+      ///The painter that holds the page content until it is taken over
+      PDF* Recorder;
+
+      ///The page object that the resources are written to
+      Object* PageHeader;
+
+      ///Index in the font list of the file for each font of the recorder
+      prim::Array<prim::count> Fonts;
+
+      ///Form XObject in the file for each form of the recorder
+      prim::Array<Object*> Forms;
+    };
+
+    ///Paints one canvas of the recordings into its own content stream.
+    static void RecordCanvas(prim::count Index, void* Recordings)
+    {
+      Recording& r = ((Recording*)Recordings)[Index];
+      r.Recorder->RasterObject = r.Recorder->CreatePDFObject();
+      r.Recorder->PaintCanvasContent(r.Canvas);
+    }
+
+    /**Takes over the objects of a recording, which start with its page
+    content, and merges its fonts and forms with those already in the file.
+    Forms that are already in the file are deleted.*/
+    void AdoptRecording(Recording& r)
+    {
+      using namespace prim;
+      PDF* Recorder = r.Recorder;
+
+      r.Fonts.n(Recorder->FontList.n());
+      for(count i = 0; i < Recorder->FontList.n(); i++)
+      {
+        count f = 0;
+        while(f < FontList.n() && FontList[f] != Recorder->FontList[i])
+          f++;
+        if(f == FontList.n())
+        {
+          FontList.Append(Recorder->FontList[i]);
+          FontCharacterUsage.n(FontList.n() * 256);
+          for(count j = 0; j < 256; j++)
+            FontCharacterUsage[f * 256 + j] = 0;
+        }
+        for(count j = 0; j < 256; j++)
+          FontCharacterUsage[f * 256 + j] |=
+            Recorder->FontCharacterUsage[i * 256 + j];
+        r.Fonts[i] = f;
+      }
+
+      //Remember the recorder forms that are already in the file by address.
+      FormTable Duplicates;
+      r.Forms.n(Recorder->FormList.n());
+      for(count i = 0; i < Recorder->FormList.n(); i++)
+      {
+        const Form& g = Recorder->FormList.GetConstItem(i);
+        count f = FindFormByContent(g.XObject->Content, g.StrokeWidth, g.Hash);
+        if(f >= 0)
+        {
+          r.Forms[i] = FormList[f].XObject;
+          Duplicates.Insert((uint64)(uintptr)g.XObject, i);
+          continue;
+        }
+
+        //Path addresses are only known to the recorder.
+        Form NewForm = g;
+        NewForm.Source = 0;
+        r.Forms[i] = AddForm(NewForm).XObject;
+      }
+
+      //Keep the objects in the order they were recorded in.
+      for(count i = 0; i < Recorder->Objects.n(); i++)
+      {
+        Object* o = Recorder->Objects[i];
+        count Position = -1;
+        if(Duplicates.Find((uint64)(uintptr)o, Position) >= 0)
+          delete o;
+        else
+          Objects.Append(o);
+      }
+      Recorder->Objects.RemoveAll();
+    }
+
+    /**Writes the resources of a recorded page, naming the fonts, images and
+    forms as the recorder did, and deletes the recorder.*/
+    void WriteRecordingResources(Recording& r,
+      const prim::List<Object*>& FontParents)
+    {
+      using namespace prim;
+      PDF* Recorder = r.Recorder;
+      String& d = r.PageHeader->Dictionary;
+
+      d += "/Resources";
+      d += "  <<";
+      d += "    /Font <<";
+      for(count i = 0; i < r.Fonts.n(); i++)
+      {
+        d += "      /F";
+        d &= (integer)i;
+        d &= " ";
+        r.PageHeader->InsertDictionaryXRef(FontParents[r.Fonts[i]]);
+      }
+      d += "    >>";
+      d += "    /XObject <<";
+      for(count i = 0; i < Recorder->ImageList.n(); i++)
+      {
+        d += "      /Im";
+        d &= (integer)i;
+        d &= " ";
+        r.PageHeader->InsertDictionaryXRef(Recorder->ImageList[i]);
+      }
+      for(count i = 0; i < r.Forms.n(); i++)
+      {
+        d += "      /Fm";
+        d &= (integer)i;
+        d &= " ";
+        r.PageHeader->InsertDictionaryXRef(r.Forms[i]);
+      }
+      d += "    >>";
+      d += "  >>";
+
+      delete Recorder;
+      r.Recorder = 0;
+    }
+
+    ///Writes the content stream of a canvas to the current raster object.
+    void PaintCanvasContent(bbs::abstracts::Portfolio::Canvas* c)
+    {
+      using namespace prim;
+      using namespace bbs::abstracts;
+      Object* PageContent = RasterObject;
+
+      //Get a reference to the list of layers.
+      List<Portfolio::Canvas::Layer*>& ll = c->Layers;
+
+      /*Convert device space into inches and divide by the
+      CTMMultiplier, which allows applications which have static
+      curve segmenting algorithms to produce smoother curves. For
+      example FoxIt apparently uses the unit value as its step for
+      segmentation meaning that if you are operating in inches then
+      you have no chance of getting a smooth curve. Working in a
+      "multiplied" CTM (in which the vectors themselves are multiplied
+      by a number, allows the smoothing methods to work well on the
+      unit assumption (which is not part of the PDF standard, and a
+      poor algorithm, but it is a popular alternative viewer...)*/
+      number CTMInches = (number)72 / PDFProperties->CTMMultiplier;
+      PageContent->Content += CTMInches;
+      PageContent->Content -= "0 0";
+      PageContent->Content -= CTMInches;
+      PageContent->Content -= "0 0 cm";
+      
+
+      if(PDFProperties->UseCMYKInsteadOfRGB)
+      {
+        //Use CMYK color (to do rough conversions later from RGB).
+        PageContent->Content += "/DeviceCMYK cs";
+        PageContent->Content += "/DeviceCMYK CS";
+      }
+      else
+      {
+        //Use RGB color which does not require conversion.
+        PageContent->Content += "/DeviceRGB cs";
+        PageContent->Content += "/DeviceRGB CS";
+      }
+
+
+      //Save transformation matrix.
+      PageContent->Content += "q";
+
+      //Draw the main canvas layer.
+      c->Paint(this);
+
+      //Loop through each layer in the canvas and draw it.
+      for(count j=0;j<ll.n();j++)
+      {
+        //Save transformation matrix.
+        PageContent->Content += "q";
+
+        //Draw individual layer.
+        ll[j]->Paint(this);
+
+        //Revert the transformation matrix.
+        PageContent->Content += "Q";
+      }
+
+      //Revert the transformation matrix.
+      PageContent->Content += "Q";
+
+      //Write the page content object's dictionary.
+      PageContent->IsStream = true;
+      PageContent->Dictionary &= "/Length";
+      PageContent->Dictionary -= (integer)PageContent->Content.ByteLength();
+    }
+
     ///Properties of the PDF file
     PDF::Properties* PDFProperties;
 
@@ -355,6 +873,17 @@ namespace abcd
           Objects[i]->ContentXRefs,Objects[i]->Content);
       }
 
+      //Write a PDF 1.5 file with object and cross-reference streams instead.
+      Revision* LastSave = PDFProperties ? PDFProperties->LastSave : 0;
+      if(PDFProperties && PDFProperties->UseObjectStreams)
+      {
+        if(LastSave)
+          LastSave->Clear();
+        CommitObjectsAsStreams(ByteStream, RootObject, InfoObject);
+        DeleteObjects();
+        return;
+      }
+
       //Write the header.
       ByteStream = "%PDF-1.3"; //Can be adjusted as necessary.
       ByteStream += "%";
@@ -381,44 +910,7 @@ namespace abcd
         table of contents at the end of the file.*/
         CurrentObject->XRefOffset=ByteStream.ByteLength();
 
-        //Begin the object.
-        ByteStream &= (integer)XRefObject;
-        ByteStream &= " 0 obj";
-        ByteStream++;
-
-        //Decide whether or not to make brackets appear.
-        if(!CurrentObject->NoAutoBrackets)
-        {
-          ByteStream &= "<<";
-          ByteStream++;
-        }
-
-        //Write the dictionary.
-        ByteStream &= CurrentObject->Dictionary;
-        ByteStream++;
-
-        //Close brackets if they were done before.
-        if(!CurrentObject->NoAutoBrackets)
-        {
-          ByteStream &= ">>";
-          ByteStream++;
-        }
-
-        //If there is a content stream then write it.
-        if(CurrentObject->Content.n()>0)
-        {
-          ByteStream &= "stream";
-          ByteStream++;
-          ByteStream &= CurrentObject->Content;
-          ByteStream++;
-          ByteStream &= "endstream";
-          ByteStream++;
-        }
-
-        //End the object.
-        ByteStream &= "endobj";
-        ByteStream++;
-        ByteStream++;
+        WriteObject(ByteStream, *CurrentObject);
       }
 
       //Write the XRef table of contents found at the end of the PDF file.
@@ -466,6 +958,144 @@ namespace abcd
       ByteStream += (integer)XRefLocation;
       ByteStream += "%%EOF";
 
+      //Remember where the update next time has to chain to.
+      if(LastSave)
+        LastSave->XRefLocation = XRefLocation;
+
+      DeleteObjects();
+    }
+
+    ///Hashes data with 64-bit FNV-1a, optionally continuing a previous hash.
+    static prim::uint64 HashData(const prim::byte* Data, prim::count Length,
+      prim::uint64 Hash = (prim::uint64)14695981039346656037ULL)
+    {
+      for(prim::count i = 0; i < Length; i++)
+        Hash = (Hash ^ (prim::uint64)Data[i]) * (prim::uint64)1099511628211ULL;
+      return Hash;
+    }
+
+    ///Hashes the dictionary and content of an object as they will be written.
+    static prim::uint64 HashObject(const Object& o)
+    {
+      prim::uint64 Hash = HashData((const prim::byte*)o.Dictionary.Merge(),
+        o.Dictionary.ByteLength());
+      prim::byte Separator = (o.NoAutoBrackets ? 1 : 0) | (o.IsStream ? 2 : 0);
+      Hash = HashData(&Separator, 1, Hash);
+      return HashData((const prim::byte*)o.Content.Merge(),
+        o.Content.ByteLength(), Hash);
+    }
+
+    /**Determines whether the changed pages can be appended to the file of
+    the last save as an incremental update. The file must be saved to the same
+    name and still be the length it was after the last save (so that it has
+    not been replaced in the meantime), and the pages must be the same in
+    number with at least one of them unchanged.*/
+    bool CanAppendIncrementalUpdate(prim::count Pages)
+    {
+      Revision* r = PDFProperties ? PDFProperties->LastSave : 0;
+      if(!r || PDFProperties->UseObjectStreams || PDFProperties->Filename == ""
+        || r->Filename != PDFProperties->Filename || !r->FileLength ||
+        r->AllChanged || r->Pages.n() != Pages)
+          return false;
+      return prim::File::Length(PDFProperties->Filename.Merge()) ==
+        r->FileLength;
+    }
+
+    /**Writes the objects followed by a cross-reference section for just
+    those objects and a trailer pointing back to the previous section. The
+    objects must already be numbered. If there are none, nothing is
+    written.*/
+    void CommitIncrementalUpdate(prim::String& ByteStream)
+    {
+      using namespace prim;
+      Revision& r = *PDFProperties->LastSave;
+      PDFProperties->WroteIncrementalUpdate = true;
+      ByteStream.Clear();
+      if(!Objects.n())
+        return;
+
+      for(count i = 0; i < Objects.n(); i++)
+      {
+        Objects[i]->CommitXRefList(Objects[i]->DictionaryXRefs,
+          Objects[i]->Dictionary);
+        Objects[i]->CommitXRefList(Objects[i]->ContentXRefs,
+          Objects[i]->Content);
+      }
+
+      //The file ends with %%EOF and no line break.
+      ByteStream++;
+      Array<XRefEntry> Entries;
+      for(count i = 0; i < Objects.n(); i++)
+      {
+        Object* o = Objects[i];
+        o->XRefOffset = r.FileLength + ByteStream.ByteLength();
+        Entries.Add(XRefEntry(o->XRefIndex, o->XRefOffset));
+        WriteObject(ByteStream, *o);
+      }
+      Entries.Sort();
+
+      //Write a subsection for each run of consecutive object numbers.
+      count XRefLocation = r.FileLength + ByteStream.ByteLength();
+      ByteStream &= "xref";
+      ByteStream++;
+      for(count i = 0; i < Entries.n();)
+      {
+        count j = i + 1;
+        while(j < Entries.n() && Entries[j].Number == Entries[j - 1].Number + 1)
+          j++;
+        ByteStream &= (integer)Entries[i].Number;
+        ByteStream &= " ";
+        ByteStream &= (integer)(j - i);
+        ByteStream++;
+        for(; i < j; i++)
+        {
+          ByteStream.AppendInteger(Entries[i].Offset,10);
+          ByteStream &= " 00000 n";
+          ByteStream.Append(13,10);
+        }
+      }
+
+      //Write the trailer chained to the previous cross-reference section.
+      ByteStream &= "trailer";
+      ByteStream += "<<";
+      ByteStream += "/Size ";
+      ByteStream &= (integer)r.Size;
+      ByteStream += "/Root ";
+      ByteStream &= (integer)r.Root;
+      ByteStream &= " 0 R";
+      ByteStream += "/Info ";
+      ByteStream &= (integer)r.Info;
+      ByteStream &= " 0 R";
+      ByteStream += "/Prev ";
+      ByteStream &= (integer)r.XRefLocation;
+      ByteStream += "/ID[<8F64B905EA13AD4AAE6094175973E02D>";
+      ByteStream &= "<8B911DB58AB86C44BFD52F30772A298C>]";
+      ByteStream += ">>";
+      ByteStream += "startxref";
+      ByteStream += (integer)XRefLocation;
+      ByteStream += "%%EOF";
+
+      r.XRefLocation = XRefLocation;
+    }
+
+    ///An object number and its offset, ordered by number.
+    struct XRefEntry
+    {
+      prim::count Number, Offset;
+
+      XRefEntry() : Number(0), Offset(0) {}
+      XRefEntry(prim::count Number, prim::count Offset) : Number(Number),
+        Offset(Offset) {}
+
+      bool operator < (const XRefEntry& Other) const
+      {
+        return Number < Other.Number;
+      }
+    };
+
+    ///Deletes the objects once they have been written.
+    void DeleteObjects(void)
+    {
       //Delete each object manually now that they are no longer necessary.
       for(int i=0;i<Objects.n();i++)
         delete Objects[i];
@@ -474,6 +1104,224 @@ namespace abcd
       Objects.RemoveAll();
     }
 
+    ///Writes an object at the top level of the file.
+    static void WriteObject(prim::String& ByteStream, const Object& o)
+    {
+      using namespace prim;
+
+      //Begin the object.
+      ByteStream &= (integer)o.XRefIndex;
+      ByteStream &= " 0 obj";
+      ByteStream++;
+
+      //Decide whether or not to make brackets appear.
+      if(!o.NoAutoBrackets)
+      {
+        ByteStream &= "<<";
+        ByteStream++;
+      }
+
+      //Write the dictionary.
+      ByteStream &= o.Dictionary;
+      ByteStream++;
+
+      //Close brackets if they were done before.
+      if(!o.NoAutoBrackets)
+      {
+        ByteStream &= ">>";
+        ByteStream++;
+      }
+
+      //If the object is a stream then write its content.
+      if(o.IsStream)
+      {
+        ByteStream &= "stream";
+        ByteStream++;
+        ByteStream &= o.Content;
+        ByteStream++;
+        ByteStream &= "endstream";
+        ByteStream++;
+      }
+
+      //End the object.
+      ByteStream &= "endobj";
+      ByteStream++;
+      ByteStream++;
+    }
+
+    ///Compresses data with the Flate filter and encodes it as ASCII85.
+    static void CompressStream(const prim::byte* Source, prim::count Length,
+      prim::String& Destination)
+    {
+      prim::Array<prim::byte> Compressed;
+      prim::Text::CompressData(Source, Length, Compressed);
+      prim::Text::EncodeDataAsASCII85String(
+        Compressed.n() ? &Compressed[0] : 0, Compressed.n(), Destination);
+    }
+
+    /**\brief Writes the objects as a PDF 1.5 file using object streams and a
+    cross-reference stream. \details Stream objects are written at the top
+    level as usual, even if their content is empty, since object streams may
+    not contain streams. All other objects are packed in groups into object
+    streams, each compressed with Flate. The cross-reference stream uses one
+    byte for the entry type, four bytes for the offset or object stream
+    number, and two bytes for the generation or index within the object
+    stream. The compressed streams are ASCII85-encoded since the
+    output is kept as a 7-bit string.*/
+    void CommitObjectsAsStreams(prim::String& ByteStream,
+      Object* RootObject, Object* InfoObject)
+    {
+      using namespace prim;
+      using namespace prim::unicode::latin;
+
+      //Most readers handle large object streams but keep them modest.
+      const count ObjectsPerStream = 100;
+
+      //Split the objects into streams and the rest.
+      Array<Object*> Packed;
+      for(count i = 0; i < Objects.n(); i++)
+        if(!Objects[i]->IsStream)
+          Packed.Add(Objects[i]);
+
+      //Object streams and the cross-reference stream are numbered last.
+      count ObjectStreams = (Packed.n() + ObjectsPerStream - 1) /
+        ObjectsPerStream;
+      count FirstObjectStream = Objects.n() + 1;
+      count XRefStreamNumber = FirstObjectStream + ObjectStreams;
+      count Size = XRefStreamNumber + 1;
+
+      //Each entry is the type, the offset or stream, and the generation.
+      Array<byte> Entries;
+      Entries.n(Size * 7);
+      Entries[0] = 0;
+      Entries[5] = 0xFF;
+      Entries[6] = 0xFF;
+
+      //Write the header.
+      ByteStream = "%PDF-1.5";
+      ByteStream += "%";
+      ByteStream.Append(
+        diacritics::a_Circumflex,
+        diacritics::a_Tilde,
+        diacritics::I_Umlaut,
+        diacritics::O_Acute);
+      ByteStream++;
+
+      //Write the stream objects at the top level.
+      for(count i = 0; i < Objects.n(); i++)
+      {
+        Object* o = Objects[i];
+        if(!o->IsStream)
+          continue;
+        SetXRefStreamEntry(Entries, o->XRefIndex, 1, ByteStream.ByteLength(),
+          0);
+        WriteObject(ByteStream, *o);
+      }
+
+      //Pack the remaining objects into object streams.
+      for(count s = 0; s < ObjectStreams; s++)
+      {
+        count StreamNumber = FirstObjectStream + s;
+        count First = s * ObjectsPerStream;
+        count Last = math::Min(First + ObjectsPerStream, Packed.n());
+
+        String Header, Body;
+        for(count i = First; i < Last; i++)
+        {
+          Object* o = Packed[i];
+          SetXRefStreamEntry(Entries, o->XRefIndex, 2, StreamNumber,
+            i - First);
+          if(i != First)
+            Header &= " ";
+          Header &= (integer)o->XRefIndex;
+          Header &= " ";
+          Header &= (integer)Body.ByteLength();
+          if(!o->NoAutoBrackets)
+            Body &= "<<";
+          Body &= o->Dictionary;
+          if(!o->NoAutoBrackets)
+            Body &= ">>";
+          Body++;
+        }
+        Header++;
+        count FirstOffset = Header.ByteLength();
+        Header &= Body;
+
+        String Encoded;
+        CompressStream((const byte*)Header.Merge(), Header.ByteLength(),
+          Encoded);
+
+        SetXRefStreamEntry(Entries, StreamNumber, 1, ByteStream.ByteLength(),
+          0);
+        ByteStream &= (integer)StreamNumber;
+        ByteStream &= " 0 obj";
+        ByteStream += "<<";
+        ByteStream += "/Type /ObjStm";
+        ByteStream += "/N";
+        ByteStream -= (integer)(Last - First);
+        ByteStream += "/First";
+        ByteStream -= (integer)FirstOffset;
+        ByteStream += "/Filter [/ASCII85Decode /FlateDecode]";
+        ByteStream += "/Length";
+        ByteStream -= (integer)Encoded.ByteLength();
+        ByteStream += ">>";
+        ByteStream += "stream";
+        ByteStream += Encoded;
+        ByteStream += "endstream";
+        ByteStream += "endobj";
+        ByteStream++;
+        ByteStream++;
+      }
+
+      //Write the cross-reference stream, which includes its own entry.
+      count XRefLocation = ByteStream.ByteLength();
+      SetXRefStreamEntry(Entries, XRefStreamNumber, 1, XRefLocation, 0);
+      String Encoded;
+      CompressStream(&Entries[0], Entries.n(), Encoded);
+
+      ByteStream &= (integer)XRefStreamNumber;
+      ByteStream &= " 0 obj";
+      ByteStream += "<<";
+      ByteStream += "/Type /XRef";
+      ByteStream += "/Size";
+      ByteStream -= (integer)Size;
+      ByteStream += "/W [1 4 2]";
+      ByteStream += "/Root ";
+      ByteStream &= (integer)RootObject->XRefIndex;
+      ByteStream &= " 0 R";
+      ByteStream += "/Info ";
+      ByteStream &= (integer)InfoObject->XRefIndex;
+      ByteStream &= " 0 R";
+      ByteStream += "/ID[<8F64B905EA13AD4AAE6094175973E02D>";
+      ByteStream &= "<8B911DB58AB86C44BFD52F30772A298C>]";
+      ByteStream += "/Filter [/ASCII85Decode /FlateDecode]";
+      ByteStream += "/Length";
+      ByteStream -= (integer)Encoded.ByteLength();
+      ByteStream += ">>";
+      ByteStream += "stream";
+      ByteStream += Encoded;
+      ByteStream += "endstream";
+      ByteStream += "endobj";
+      ByteStream += "startxref";
+      ByteStream += (integer)XRefLocation;
+      ByteStream += "%%EOF";
+    }
+
+    ///Sets an entry of a cross-reference stream with the field widths 1 4 2.
+    static void SetXRefStreamEntry(prim::Array<prim::byte>& Entries,
+      prim::count ObjectNumber, prim::count Type, prim::count Field2,
+      prim::count Field3)
+    {
+      prim::byte* e = &Entries[ObjectNumber * 7];
+      e[0] = (prim::byte)Type;
+      e[1] = (prim::byte)(Field2 >> 24);
+      e[2] = (prim::byte)(Field2 >> 16);
+      e[3] = (prim::byte)(Field2 >> 8);
+      e[4] = (prim::byte)Field2;
+      e[5] = (prim::byte)(Field3 >> 8);
+      e[6] = (prim::byte)Field3;
+    }
+
     virtual void CommitASCIITrueTypeFont(bbs::Font* ASCIITrueTypeFont,
       Object* Parent, Object* Dictionary, Object* Program)
     {
@@ -491,8 +1339,42 @@ namespace abcd
       if(!TTFont)
         return;
 
-      String RandomFontName = "EmbeddedASCIITrueTypeFont-";
-      RandomFontName.AppendInteger(Rand(1,(integer)99999),5);
+      //Gather the character codes that were drawn with this font.
+      Array<uint16> UsedCharacters;
+      for(count i = 0; i < FontList.n(); i++)
+      {
+        if(FontList[i] != ASCIITrueTypeFont)
+          continue;
+        for(count j = 0; j < 256; j++)
+          if(FontCharacterUsage[i * 256 + j])
+            UsedCharacters.Add((uint16)j);
+        break;
+      }
+
+      //Build the subset of the font program if possible.
+      Array<byte> SubsetProgram;
+      const byte* ProgramData = ASCIITrueTypeFont->ProgramData;
+      count ProgramDataByteLength = ASCIITrueTypeFont->ProgramDataByteLength;
+      if(PDFProperties->SubsetFonts &&
+        TTFont->Subset(UsedCharacters, SubsetProgram))
+      {
+        ProgramData = &SubsetProgram[0];
+        ProgramDataByteLength = SubsetProgram.n();
+      }
+
+      /*Name the font after a hash of its program so that the name is the
+      same each time the document is saved. Subset fonts are named with a six
+      letter tag followed by a plus.*/
+      uint64 ProgramHash = HashData(ProgramData, ProgramDataByteLength);
+      String RandomFontName;
+      if(SubsetProgram.n())
+      {
+        for(count i = 0; i < 6; i++, ProgramHash /= 26)
+          RandomFontName.Append((unicode::UCS4)('A' + ProgramHash % 26));
+        RandomFontName &= "+";
+      }
+      RandomFontName &= "EmbeddedASCIITrueTypeFont-";
+      RandomFontName.AppendInteger((integer)(ProgramHash % 99999) + 1, 5);
 
       Parent->Dictionary += "/Type /Font";
       Parent->Dictionary += "/Subtype /TrueType";
@@ -583,17 +1465,16 @@ namespace abcd
       //EMBEDDING
       //==================================================================
       String HexEncodedFontProgram;
-      prim::Text::EncodeDataAsHexString(
-        ASCIITrueTypeFont->ProgramData,
-        ASCIITrueTypeFont->ProgramDataByteLength,
+      prim::Text::EncodeDataAsHexString(ProgramData, ProgramDataByteLength,
         HexEncodedFontProgram);
 
       Program->Content &= HexEncodedFontProgram;
+      Program->IsStream = true;
       Program->Dictionary &= "/Filter /ASCIIHexDecode";
       Program->Dictionary += "/Length ";
       Program->Dictionary &= (integer)HexEncodedFontProgram.n();
       Program->Dictionary += "/Length1 ";
-      Program->Dictionary &= (integer)ASCIITrueTypeFont->ProgramDataByteLength;
+      Program->Dictionary &= (integer)ProgramDataByteLength;
     }
 
     virtual void Paint(bbs::abstracts::Portfolio* PortfolioToPaint,
@@ -611,6 +1492,15 @@ namespace abcd
 
       //Save for later reference by other methods.
       PDFProperties = p;
+      p->WroteIncrementalUpdate = false;
+
+      //Append just the changed pages to the last save if possible.
+      if(CanAppendIncrementalUpdate(PortfolioToPaint->Canvases.n()))
+      {
+        PaintIncrementalUpdate(PortfolioToPaint);
+        SaveOutput();
+        return;
+      }
 
       //Create the main object entries in the PDF.
       Object* Catalog = CreatePDFObject(); //must be 1 0 R
@@ -634,37 +1524,49 @@ namespace abcd
       //Grab the canvas list from the portfolio.
       List<Portfolio::Canvas*>& cl  = PortfolioToPaint->Canvases;
 
-      //An internal list of page content objects.
+      //An internal list of page dictionaries and their content streams.
       List<Object*> PageObjects;
+      List<Object*> PageContents;
+
+      //Paint the canvases on worker threads first if asked to.
+      bool RecordInParallel = p->PaintCanvasesInParallel && cl.n() > 1;
+      Array<Recording> Recordings;
+      if(RecordInParallel)
+      {
+        Recordings.n(cl.n());
+        for(count i = 0; i < cl.n(); i++)
+        {
+          Recordings[i].Canvas = cl[i];
+          Recordings[i].Recorder = new PDF;
+          Recordings[i].Recorder->PDFProperties = p;
+        }
+        Parallel::For(cl.n(), RecordCanvas, &Recordings[0]);
+      }
 
       //Loop through each canvas and commit it to a PDF page.
       for(count i=0;i<cl.n();i++)
       {
         //Create objects for page header and content information.
         Object* PageHeader = CreatePDFObject();
-        Object* PageContent = RasterObject = CreatePDFObject();
+        Object* PageContent = 0;
+        if(RecordInParallel)
+        {
+          PageContent = Recordings[i].Recorder->Objects.first();
+          Recordings[i].PageHeader = PageHeader;
+          AdoptRecording(Recordings[i]);
+        }
+        else
+          PageContent = RasterObject = CreatePDFObject();
         PageObjects.Append(PageHeader);
+        PageContents.Append(PageContent);
 
         //Write the page's dictionary.
-        PageHeader->Dictionary &= "/Type /Page";
-        PageHeader->Dictionary += "/Parent ";
-        PageHeader->InsertDictionaryXRef(Pages);
-        PageHeader->Dictionary += "/Contents ";
-        PageHeader->InsertDictionaryXRef(PageContent);
-        PageHeader->Dictionary += "/MediaBox [ 0 0";
-        PageHeader->Dictionary -= cl[i]->Dimensions.x;
-        PageHeader->Dictionary -= cl[i]->Dimensions.y;
-        PageHeader->Dictionary -= "]";
-
-        PageHeader->Dictionary += "/CropBox [ 0 0";
-        PageHeader->Dictionary -= cl[i]->Dimensions.x;
-        PageHeader->Dictionary -= cl[i]->Dimensions.y;
-        PageHeader->Dictionary -= "]";
-
-        PageHeader->Dictionary += "/TrimBox [ 0 0";
-        PageHeader->Dictionary -= cl[i]->Dimensions.x;
-        PageHeader->Dictionary -= cl[i]->Dimensions.y;
-        PageHeader->Dictionary -= "]";
+        WritePageHeader(PageHeader, Pages, PageContent, cl[i]);
+
+        /*A recorded page names its own resources, which are written once the
+        fonts have been created.*/
+        if(RecordInParallel)
+          continue;
 
         //Write out a reference to the catalog of fonts.
         PageHeader->Dictionary += "/Resources";
@@ -677,65 +1579,8 @@ namespace abcd
           PageHeader->Dictionary += "  >>";
         }
 
-        //Get a reference to the list of layers.
-        List<Portfolio::Canvas::Layer*>& ll = cl[i]->Layers;
-
-        /*Convert device space into inches and divide by the
-        CTMMultiplier, which allows applications which have static
-        curve segmenting algorithms to produce smoother curves. For
-        example FoxIt apparently uses the unit value as its step for
-        segmentation meaning that if you are operating in inches then
-        you have no chance of getting a smooth curve. Working in a
-        "multiplied" CTM (in which the vectors themselves are multiplied
-        by a number, allows the smoothing methods to work well on the
-        unit assumption (which is not part of the PDF standard, and a
-        poor algorithm, but it is a popular alternative viewer...)*/
-        number CTMInches = (number)72 / p->CTMMultiplier;
-        PageContent->Content += CTMInches;
-        PageContent->Content -= "0 0";
-        PageContent->Content -= CTMInches;
-        PageContent->Content -= "0 0 cm";
-        
-
-        if(PDFProperties->UseCMYKInsteadOfRGB)
-        {
-          //Use CMYK color (to do rough conversions later from RGB).
-          PageContent->Content += "/DeviceCMYK cs";
-          PageContent->Content += "/DeviceCMYK CS";
-        }
-        else
-        {
-          //Use RGB color which does not require conversion.
-          PageContent->Content += "/DeviceRGB cs";
-          PageContent->Content += "/DeviceRGB CS";
-        }
-
-
-        //Save transformation matrix.
-        PageContent->Content += "q";
-
-        //Draw the main canvas layer.
-        cl[i]->Paint(this);
-
-        //Loop through each layer in the canvas and draw it.
-        for(count j=0;j<ll.n();j++)
-        {
-          //Save transformation matrix.
-          PageContent->Content += "q";
-
-          //Draw individual layer.
-          ll[j]->Paint(this);
-
-          //Revert the transformation matrix.
-          PageContent->Content += "Q";
-        }
-
-        //Revert the transformation matrix.
-        PageContent->Content += "Q";
-
-        //Write the page content object's dictionary.
-        PageContent->Dictionary &= "/Length";
-        PageContent->Dictionary -= (integer)PageContent->Content.ByteLength();
+        //Draw the canvas to the page content.
+        PaintCanvasContent(cl[i]);
 
         //Set the current drawing target to null to be safe.
         RasterObject = 0;
@@ -760,9 +1605,11 @@ namespace abcd
       /*Now actually create the embedded fonts. Notice that the pages
       actually referenced the fonts before they were instantiated due to
       the deferred object writing mechanism.*/
+      List<Object*> FontParents;
       for(prim::count i = 0; i < FontList.n(); i++)
       {
         Object* FontParent=CreatePDFObject();
+        FontParents.Append(FontParent);
         Object* FontDictionary=CreatePDFObject();
         Object* FontProgram=CreatePDFObject();
         //UNICODE ONLY: Object* fontUnicodeMap=CreatePDFObject();
@@ -775,6 +1622,10 @@ namespace abcd
         FontCatalog->Dictionary &= " ";
         FontCatalog->InsertDictionaryXRef(FontParent);
       }
+
+      //Now that the fonts exist, write the resources of the recorded pages.
+      for(count i = 0; i < Recordings.n(); i++)
+        WriteRecordingResources(Recordings[i], FontParents);
       
       //Create the catalog of images.
       for(prim::count i = 0; i < ImageList.n(); i++)
@@ -785,6 +1636,15 @@ namespace abcd
         ImageCatalog->InsertDictionaryXRef(ImageList[i]);
       }
 
+      //Add the path forms to the same XObject catalog.
+      for(prim::count i = 0; i < FormList.n(); i++)
+      {
+        ImageCatalog->Dictionary += "/Fm";
+        ImageCatalog->Dictionary &= (integer)i;
+        ImageCatalog->Dictionary &= " ";
+        ImageCatalog->InsertDictionaryXRef(FormList[i].XObject);
+      }
+
       //Create the info object.
       Info->Dictionary += "/Title ()";
       Info->Dictionary += "/Author ()";
@@ -793,8 +1653,92 @@ namespace abcd
       Info->Dictionary += "/CreationDate (D:20080719142857-05'00')";
       Info->Dictionary += "/ModDate (D:20080719142857-05'00')";
       Info->Dictionary += "/Trapped /False";
-      Info->Dictionary += "/GTS_PDFXVersion (PDF/X-1:2001)";
-      Info->Dictionary += "/GTS_PDFXConformance (PDF/X-1a:2001)";
+      if(!p->UseObjectStreams)
+      {
+        Info->Dictionary += "/GTS_PDFXVersion (PDF/X-1:2001)";
+        Info->Dictionary += "/GTS_PDFXConformance (PDF/X-1a:2001)";
+      }
+
+      WriteMetadata(Metadata);
+
+      //Create the output intent for PDF-X compliance.
+      OutputIntent->Dictionary += "/Type /OutputIntent";
+      OutputIntent->Dictionary += "/OutputConditionIdentifier (sRGB)";
+      OutputIntent->Dictionary += "/S /GTS_PDFX";
+      OutputIntent->Dictionary += "/RegistryName (http://www.color.org)";
+
+      //Remember the object numbers for an incremental update next time.
+      if(p->LastSave)
+        RememberRevision(PageObjects, PageContents, FontParents, Catalog, Info,
+          Pages, Metadata);
+
+      /*The forms are keyed by path address, which is only meaningful while
+      this portfolio is being painted.*/
+      FormList.Clear();
+      FormsByContent.Clear();
+      FormsByPath.Clear();
+
+      //Commit all of the objects to the output string.
+      CommitObjects(p->Output);
+      SaveOutput();
+    }
+
+    /**Writes the output to the file if there is one, and remembers which
+    file now holds the last save.*/
+    void SaveOutput(void)
+    {
+      using namespace prim;
+      Properties* p = PDFProperties;
+      if(p->Filename != "")
+      {
+        if(!p->WroteIncrementalUpdate)
+          File::Replace(p->Filename.Merge(), p->Output.Merge());
+        else if(p->Output.n())
+          File::Append(p->Filename.Merge(), p->Output.Merge());
+      }
+
+      if(p->LastSave)
+      {
+        if(p->Filename != "" && !p->UseObjectStreams)
+        {
+          p->LastSave->Filename = p->Filename;
+          p->LastSave->FileLength = File::Length(p->Filename.Merge());
+        }
+        else
+          p->LastSave->Clear();
+      }
+    }
+
+    ///Writes the dictionary of a page apart from its resources.
+    void WritePageHeader(Object* PageHeader, Object* PageTree,
+      Object* PageContent, const bbs::abstracts::Portfolio::Canvas* c)
+    {
+      PageHeader->Dictionary &= "/Type /Page";
+      PageHeader->Dictionary += "/Parent ";
+      PageHeader->InsertDictionaryXRef(PageTree);
+      PageHeader->Dictionary += "/Contents ";
+      PageHeader->InsertDictionaryXRef(PageContent);
+      PageHeader->Dictionary += "/MediaBox [ 0 0";
+      PageHeader->Dictionary -= c->Dimensions.x;
+      PageHeader->Dictionary -= c->Dimensions.y;
+      PageHeader->Dictionary -= "]";
+
+      PageHeader->Dictionary += "/CropBox [ 0 0";
+      PageHeader->Dictionary -= c->Dimensions.x;
+      PageHeader->Dictionary -= c->Dimensions.y;
+      PageHeader->Dictionary -= "]";
+
+      PageHeader->Dictionary += "/TrimBox [ 0 0";
+      PageHeader->Dictionary -= c->Dimensions.x;
+      PageHeader->Dictionary -= c->Dimensions.y;
+      PageHeader->Dictionary -= "]";
+    }
+
+    ///Writes the XMP packet that carries the extra data of the properties.
+    void WriteMetadata(Object* Metadata)
+    {
+      using namespace prim;
+      Properties* p = PDFProperties;
 
       Metadata->Content += "<?xpacket begin=\"";
       Metadata->Content.Append(
@@ -823,23 +1767,297 @@ namespace abcd
 
       Metadata->Content += "<?xpacket end=\"w\"?>";
 
+      Metadata->IsStream = true;
       Metadata->Dictionary += "/Type /Metadata";
       Metadata->Dictionary += "/Subtype /XML";
       Metadata->Dictionary += "/Length";
       Metadata->Dictionary -= (integer)Metadata->Content.ByteLength();
+    }
 
-      //Create the output intent for PDF-X compliance.
-      OutputIntent->Dictionary += "/Type /OutputIntent";
-      OutputIntent->Dictionary += "/OutputConditionIdentifier (sRGB)";
-      OutputIntent->Dictionary += "/S /GTS_PDFX";
-      OutputIntent->Dictionary += "/RegistryName (http://www.color.org)";
+    /**Records the object numbers that the objects will be written with, so
+    that the next save can replace pages and refer to fonts and forms
+    without painting the rest of the document again.*/
+    void RememberRevision(const prim::List<Object*>& PageHeaders,
+      const prim::List<Object*>& PageContents,
+      const prim::List<Object*>& FontParents, Object* Root, Object* Info,
+      Object* PageTree, Object* Metadata)
+    {
+      using namespace prim;
+      Revision& r = *PDFProperties->LastSave;
+
+      //Number the objects in the order they were created, as they are written.
+      for(count i = 0; i < Objects.n(); i++)
+        Objects[i]->XRefIndex = i + 1;
+      r.Size = Objects.n() + 1;
+      r.Root = Root->XRefIndex;
+      r.Info = Info->XRefIndex;
+      r.PageTree = PageTree->XRefIndex;
+      r.Metadata = Metadata->XRefIndex;
+      r.MetadataHash = HashObject(*Metadata);
+
+      //Pages painted in the whole file are hashed only once appended alone.
+      r.Pages.n(PageHeaders.n());
+      for(count i = 0; i < PageHeaders.n(); i++)
+      {
+        r.Pages[i].Header = PageHeaders[i]->XRefIndex;
+        r.Pages[i].Content = PageContents[i]->XRefIndex;
+        r.Pages[i].Hash = 0;
+        r.Pages[i].Changed = false;
+      }
 
-      //Commit all of the objects to the output string.
-      CommitObjects(p->Output);
+      r.Fonts.n(FontList.n());
+      r.FontNumbers.n(FontList.n());
+      for(count i = 0; i < FontList.n(); i++)
+      {
+        r.Fonts[i] = FontList[i];
+        r.FontNumbers[i] = FontParents[i]->XRefIndex;
+      }
+      r.FontCharacterUsage.CopyFrom(FontCharacterUsage);
 
-      //If applicable send the output to file.
-      if(p->Filename != "")
-        File::Replace(p->Filename.Merge(), p->Output.Merge());
+      r.Forms.Clear();
+      r.FormsByContent.Clear();
+      for(count i = 0; i < FormList.n(); i++)
+        RememberForm(r, FormList[i]);
+      r.AllChanged = false;
+    }
+
+    ///Adds a form of this painter, once numbered, to the last save.
+    static void RememberForm(Revision& r, const Form& f)
+    {
+      Revision::Form& g = r.Forms.AddOne();
+      g.Hash = f.Hash;
+      g.Content = f.XObject->Content;
+      g.StrokeWidth = f.StrokeWidth;
+      g.Number = f.XObject->XRefIndex;
+      r.FormsByContent.Insert(g.Hash, r.Forms.n() - 1);
+    }
+
+    /**Hashes what a recorded page draws: its content, the forms and images
+    it uses, the characters of each font it uses, and its size.*/
+    static prim::uint64 HashRecording(const Recording& r)
+    {
+      using namespace prim;
+      PDF* Recorder = r.Recorder;
+      uint64 Hash = HashObject(*Recorder->Objects.first());
+      for(count i = 0; i < Recorder->FormList.n(); i++)
+      {
+        uint64 FormHash = HashObject(*Recorder->FormList[i].XObject);
+        Hash = HashData((const byte*)&FormHash, sizeof(FormHash), Hash);
+      }
+      for(count i = 0; i < Recorder->ImageList.n(); i++)
+      {
+        uint64 ImageHash = HashObject(*Recorder->ImageList[i]);
+        Hash = HashData((const byte*)&ImageHash, sizeof(ImageHash), Hash);
+      }
+      for(count i = 0; i < Recorder->FontList.n(); i++)
+      {
+        const bbs::Font* f = Recorder->FontList[i];
+        Hash = HashData((const byte*)&f, sizeof(f), Hash);
+        Hash = HashData(&Recorder->FontCharacterUsage[i * 256], 256, Hash);
+      }
+      math::Vector Dimensions = r.Canvas->Dimensions;
+      return HashData((const byte*)&Dimensions, sizeof(Dimensions), Hash);
+    }
+
+    /**Creates an object that stands for an object already in the file, so
+    that new objects can refer to it. It is deleted along with the objects
+    but never written.*/
+    Object* CreateReference(prim::count Number,
+      prim::List<Object*>& References)
+    {
+      Object* o = new Object;
+      o->XRefIndex = Number;
+      References.Append(o);
+      return o;
+    }
+
+    /**Paints the pages marked as changed since the last save, each into a
+    painter of its own, and appends them to the file along with the
+    metadata. Each page replaces its old page and content objects under the
+    same numbers and names its own resources. Fonts and forms already in the
+    file are referred to by number, and a font is embedded again, with the
+    characters of its old subset as well, only if a page draws characters
+    missing from it.*/
+    void PaintIncrementalUpdate(bbs::abstracts::Portfolio* PortfolioToPaint)
+    {
+      using namespace prim;
+      using namespace bbs::abstracts;
+      Properties* p = PDFProperties;
+      Revision& r = *p->LastSave;
+      List<Portfolio::Canvas*>& cl = PortfolioToPaint->Canvases;
+
+      //Record the changed pages, at the same time if asked to.
+      Array<count> PageIndices;
+      for(count i = 0; i < cl.n(); i++)
+        if(r.Pages[i].Changed)
+          PageIndices.Add(i);
+      Array<Recording> Recordings;
+      Recordings.n(PageIndices.n());
+      for(count i = 0; i < PageIndices.n(); i++)
+      {
+        Recordings[i].Canvas = cl[PageIndices[i]];
+        Recordings[i].Recorder = new PDF;
+        Recordings[i].Recorder->PDFProperties = p;
+      }
+      if(p->PaintCanvasesInParallel && Recordings.n() > 1)
+        Parallel::For(Recordings.n(), RecordCanvas, &Recordings[0]);
+      else
+        for(count i = 0; i < Recordings.n(); i++)
+          RecordCanvas(i, &Recordings[0]);
+
+      /*Take over the pages that did not come out the same as they were last
+      appended, each replacing its old objects.*/
+      List<Object*> References;
+      Object* PageTree = CreateReference(r.PageTree, References);
+      Array<count> Adopted;
+      for(count i = 0; i < Recordings.n(); i++)
+      {
+        Recording& Page = Recordings[i];
+        Revision::Page& Old = r.Pages[PageIndices[i]];
+        Old.Changed = false;
+        uint64 Hash = HashRecording(Page);
+        if(Old.Hash && Hash == Old.Hash)
+        {
+          Page.Recorder->DeleteObjects();
+          delete Page.Recorder;
+          Page.Recorder = 0;
+          continue;
+        }
+        Old.Hash = Hash;
+
+        Object* PageContent = Page.Recorder->Objects.first();
+        PageContent->XRefIndex = Old.Content;
+        Page.PageHeader = CreatePDFObject();
+        Page.PageHeader->XRefIndex = Old.Header;
+        WritePageHeader(Page.PageHeader, PageTree, PageContent, Page.Canvas);
+        AdoptRecording(Page);
+        Adopted.Add(i);
+      }
+
+      /*Forms already in the file stand in for the new copies, which are not
+      written. The rest get new numbers below.*/
+      FormTable Duplicates;
+      for(count i = 0; i < FormList.n(); i++)
+      {
+        const Form& f = FormList.GetConstItem(i);
+        count Position = -1;
+        for(count j; (j = r.FormsByContent.Find(f.Hash, Position)) >= 0;)
+        {
+          const Revision::Form& g = r.Forms.GetConstItem(j);
+          if(g.StrokeWidth == f.StrokeWidth && g.Content == f.XObject->Content)
+          {
+            f.XObject->XRefIndex = g.Number;
+            Duplicates.Insert((uint64)(uintptr)f.XObject, i);
+            break;
+          }
+        }
+      }
+
+      /*Fonts whose subset in the file has every character the pages draw
+      are referred to; the others are embedded again with the characters of
+      both.*/
+      List<Object*> FontParents;
+      Array<bool> NewFonts;
+      for(count i = 0; i < FontList.n(); i++)
+      {
+        count Old = 0;
+        while(Old < r.Fonts.n() && r.Fonts[Old] != FontList[i])
+          Old++;
+        bool Covered = Old < r.Fonts.n();
+        for(count j = 0; j < 256 && Covered; j++)
+          if(FontCharacterUsage[i * 256 + j] &&
+            !r.FontCharacterUsage[Old * 256 + j])
+              Covered = false;
+        NewFonts.Add(!Covered);
+        if(Covered)
+        {
+          FontParents.Append(CreateReference(r.FontNumbers[Old], References));
+          continue;
+        }
+
+        if(Old == r.Fonts.n())
+        {
+          r.Fonts.Add(FontList[i]);
+          r.FontNumbers.Add(0);
+          r.FontCharacterUsage.n(r.Fonts.n() * 256);
+          for(count j = 0; j < 256; j++)
+            r.FontCharacterUsage[Old * 256 + j] = 0;
+        }
+        for(count j = 0; j < 256; j++)
+          FontCharacterUsage[i * 256 + j] |=
+            r.FontCharacterUsage[Old * 256 + j];
+        for(count j = 0; j < 256; j++)
+          r.FontCharacterUsage[Old * 256 + j] =
+            FontCharacterUsage[i * 256 + j];
+
+        Object* FontParent = CreatePDFObject();
+        FontParents.Append(FontParent);
+        Object* FontDictionary = CreatePDFObject();
+        Object* FontProgram = CreatePDFObject();
+        CommitASCIITrueTypeFont(FontList[i], FontParent, FontDictionary,
+          FontProgram);
+      }
+
+      for(count i = 0; i < Adopted.n(); i++)
+        WriteRecordingResources(Recordings[Adopted[i]], FontParents);
+
+      //Write the metadata again only if it changed.
+      Object* Metadata = new Object;
+      WriteMetadata(Metadata);
+      uint64 MetadataHash = HashObject(*Metadata);
+      if(MetadataHash == r.MetadataHash)
+        References.Append(Metadata);
+      else
+      {
+        Metadata->XRefIndex = r.Metadata;
+        Objects.Append(Metadata);
+        r.MetadataHash = MetadataHash;
+      }
+
+      /*Number the new objects after those in the file, and set the stand-ins
+      for the forms aside with the references.*/
+      List<Object*> Written;
+      for(count i = 0; i < Objects.n(); i++)
+      {
+        Object* o = Objects[i];
+        count Position = -1;
+        if(Duplicates.Find((uint64)(uintptr)o, Position) >= 0)
+        {
+          References.Append(o);
+          continue;
+        }
+        if(!o->XRefIndex)
+          o->XRefIndex = r.Size++;
+        Written.Append(o);
+      }
+      Objects.RemoveAll();
+      for(count i = 0; i < Written.n(); i++)
+        Objects.Append(Written[i]);
+
+      //Remember the new forms and fonts for the next update.
+      for(count i = 0; i < FormList.n(); i++)
+      {
+        count Position = -1;
+        if(Duplicates.Find((uint64)(uintptr)FormList[i].XObject, Position) < 0)
+          RememberForm(r, FormList[i]);
+      }
+      for(count i = 0; i < FontList.n(); i++)
+      {
+        if(!NewFonts[i])
+          continue;
+        count Old = 0;
+        while(r.Fonts[Old] != FontList[i])
+          Old++;
+        r.FontNumbers[Old] = FontParents[i]->XRefIndex;
+      }
+      FormList.Clear();
+      FormsByContent.Clear();
+      FormsByPath.Clear();
+
+      CommitIncrementalUpdate(p->Output);
+      DeleteObjects();
+      for(count i = 0; i < References.n(); i++)
+        delete References[i];
     }
 
     //---------------//
@@ -1058,6 +2276,7 @@ namespace abcd
       the JPEG can not be of the progressive format. For now we will just 
       assume that the JPEG is not in this format.*/
       ImageList.last()->Content = HexString;
+      ImageList.last()->IsStream = true;
       
       /*Add the image painting operator. Note that image space is defined by the
       PDF specification to be from [0, 0] to [1, 1]. Thus the proper common
@@ -1074,30 +2293,30 @@ namespace abcd
     //-----//
     //Paths//
     //-----//
-    virtual void Draw(prim::Path& p, prim::number StrokeWidth = 0.0f,
-      prim::count ContextIndex = -1)
+
+    /**Appends the moveto, lineto and curveto operators of each component of
+    the path to the operator string. The bounds of every point visited
+    (including control points) are accumulated so that Form XObjects can be
+    given a bounding box without relying on cached component bounds. The
+    bounds are reset by the first component.*/
+    void AppendPathOperators(prim::String& t, const prim::Path& p,
+      bool ClosePath, prim::math::Rectangle& Bounds)
     {
       using namespace prim;
       using namespace prim::math;
-      String t;
       number CTMMultiplier = PDFProperties->CTMMultiplier;
 
-      if(StrokeWidth != 0.f)
-      {
-        t += Abs(StrokeWidth) * CTMMultiplier;
-        t -= "w";
-      }
-
       for(count i = 0; i < p.Components.n(); i++)
       {
-        Path::Component& comp = p.Components[i];
-        Path::Curve& start = comp.Curves[0];
+        const Path::Component& comp = p.Components[i];
+        const Path::Curve& start = comp.Curves[0];
         t += start.End.x * CTMMultiplier;
         t -= start.End.y * CTMMultiplier;
         t -= "m";
+        Bounds = (i ? Bounds + start.End : Rectangle(start.End));
         for(count j = 1; j < comp.Curves.n(); j++)
         {
-          Path::Curve& curv = comp.Curves[j];
+          const Path::Curve& curv = comp.Curves[j];
           if(!curv.IsCurve)
           {
             t += curv.End.x * CTMMultiplier;
@@ -1113,10 +2332,108 @@ namespace abcd
             t -= curv.End.x * CTMMultiplier;
             t -= curv.End.y * CTMMultiplier;
             t -= "c";
+            Bounds = Bounds + curv.StartControl;
+            Bounds = Bounds + curv.EndControl;
           }
+          Bounds = Bounds + curv.End;
+        }
+        if(ClosePath)
+          t += "h"; //Close the path.
+      }
+    }
+
+    /**Returns the index of the Form XObject whose content stream is exactly
+    the given operators, creating it if no such form exists yet. The bounding
+    box is given in path units and is padded by the stroke width so that
+    strokes and miter joins are not clipped by the form. If a source path is
+    given, the form is also remembered by address and mode so that the next
+    request for the same path can skip writing its operators altogether.*/
+    prim::count FindOrCreateForm(const prim::String& Operators,
+      prim::math::Rectangle Bounds, prim::number StrokeWidth,
+      const prim::Path* Source = 0, prim::count Mode = 0)
+    {
+      using namespace prim;
+      using namespace prim::math;
+
+      //Hash the operators so that most comparisons are integral.
+      uint64 Hash = HashData((const byte*)Operators.Merge(),
+        Operators.ByteLength());
+
+      count Existing = FindFormByContent(Operators, StrokeWidth, Hash);
+      if(Existing >= 0)
+      {
+        Form& f = FormList[Existing];
+        if(Source && !f.Source)
+        {
+          f.Source = Source;
+          f.Mode = Mode;
+          FormsByPath.Insert(PathKey(Source, Mode, StrokeWidth), Existing);
         }
+        return Existing;
+      }
+
+      //Pad the box by the stroke, allowing for the default miter limit of 10.
+      number CTMMultiplier = PDFProperties->CTMMultiplier;
+      number Padding = Abs(StrokeWidth) * (number)5.0 * CTMMultiplier;
+
+      Form NewForm;
+      NewForm.Source = Source;
+      NewForm.Mode = Mode;
+      NewForm.StrokeWidth = StrokeWidth;
+      NewForm.Hash = Hash;
+      NewForm.XObject = CreatePDFObject();
+      NewForm.XObject->Content = Operators;
+      NewForm.XObject->IsStream = true;
+      AddForm(NewForm);
+
+      String& Dictionary = NewForm.XObject->Dictionary;
+      Dictionary += "/Type /XObject";
+      Dictionary += "/Subtype /Form";
+      Dictionary += "/BBox [";
+      Dictionary -= Bounds.Left() * CTMMultiplier - Padding;
+      Dictionary -= Bounds.Bottom() * CTMMultiplier - Padding;
+      Dictionary -= Bounds.Right() * CTMMultiplier + Padding;
+      Dictionary -= Bounds.Top() * CTMMultiplier + Padding;
+      Dictionary -= "]";
+      Dictionary += "/Resources << >>";
+      Dictionary += "/Length";
+      Dictionary -= (integer)Operators.ByteLength();
+
+      return FormList.n() - 1;
+    }
+
+    ///Returns the operator which paints a form by its catalog name.
+    static prim::String InvokeForm(prim::count FormIndex)
+    {
+      prim::String t = "/Fm";
+      t &= (prim::integer)FormIndex;
+      t -= "Do";
+      return t;
+    }
+
+    /**Draws the path contexts. When more than one context is drawn, the
+    path operators are written once as a Form XObject and each context
+    invokes it with Do under its own cm, instead of repeating the geometry.
+    The stroke width is set outside of the form so that it carries over to
+    later drawing as it would with inline operators.*/
+    virtual void Draw(prim::Path& p, prim::number StrokeWidth = 0.0f,
+      prim::count ContextIndex = -1)
+    {
+      using namespace prim;
+      using namespace prim::math;
+      String w, t;
+      number CTMMultiplier = PDFProperties->CTMMultiplier;
+
+      if(StrokeWidth != 0.f)
+      {
+        w += Abs(StrokeWidth) * CTMMultiplier;
+        w -= "w";
+        Rasterize(w);
       }
 
+      Rectangle Bounds;
+      AppendPathOperators(t, p, false, Bounds);
+
       if(StrokeWidth > 0)
         t += "S"; //Stroke only.
       else if(StrokeWidth == 0)
@@ -1132,6 +2449,10 @@ namespace abcd
       count numContexts = p.Contexts.n();
       if(numContexts)
       {
+        //Instance the path if more than one context is going to be drawn.
+        if(ContextIndex == -1 && numContexts > 1 && p.Components.n())
+          t = InvokeForm(FindOrCreateForm(t, Bounds, StrokeWidth));
+
         for(count i = 0; i < numContexts; i++)
         {
           if(ContextIndex == -1 || i == ContextIndex)
@@ -1147,6 +2468,22 @@ namespace abcd
         Rasterize(t);
     }
 
+    ///Appends the painting operators of DrawPath to the operator string.
+    void AppendDrawPathOperators(prim::String& t, const prim::Path& p,
+      bool Stroke, bool Fill, bool ClosePath, prim::math::Rectangle& Bounds)
+    {
+      AppendPathOperators(t, p, ClosePath, Bounds);
+
+      if(Stroke && !Fill)
+        t += "S"; //Stroke only.
+      else if(Fill && !Stroke)
+        t += "f"; //Fill only.
+      else if(Fill && Stroke)
+        t += "B"; //Fill and stroke.
+      else
+        t += "n"; //"No-op"
+    }
+
     virtual void DrawPath(prim::Path& p,
       bool Stroke = true, bool Fill = false, bool ClosePath = false,
       prim::number StrokeWidth = 0.0f)
@@ -1162,45 +2499,128 @@ namespace abcd
         t -= "w";
       }
 
-      for(count i = 0; i < p.Components.n(); i++)
+      Rectangle Bounds;
+      AppendDrawPathOperators(t, p, Stroke, Fill, ClosePath, Bounds);
+      Rasterize(t);
+    }
+
+    /**Draws the path as a Form XObject which is written once per document
+    and invoked with Do at the current transformation each time the same path
+    is drawn again with the same mode.*/
+    virtual void DrawReusablePath(prim::Path& p,
+      bool Stroke = true, bool Fill = false, bool ClosePath = false,
+      prim::number StrokeWidth = 0.0f)
+    {
+      using namespace prim;
+      using namespace prim::math;
+      if(!p.Components.n())
+        return;
+
+      number CTMMultiplier = PDFProperties->CTMMultiplier;
+      if(StrokeWidth > 0)
       {
-        Path::Component& comp = p.Components[i];
-        Path::Curve& start = comp.Curves[0];
-        t += start.End.x * CTMMultiplier;
-        t -= start.End.y * CTMMultiplier;
-        t -= "m";
-        for(count j = 1; j < comp.Curves.n(); j++)
+        String w;
+        w += StrokeWidth * CTMMultiplier;
+        w -= "w";
+        Rasterize(w);
+      }
+
+      //Look for the path by address first to avoid rewriting its operators.
+      count Mode = (Stroke ? 1 : 0) + (Fill ? 2 : 0) + (ClosePath ? 4 : 0);
+      count Position = -1;
+      for(count i; (i = FormsByPath.Find(PathKey(&p, Mode, StrokeWidth),
+        Position)) >= 0;)
+      {
+        const Form& f = FormList.GetConstItem(i);
+        if(f.Source == &p && f.Mode == Mode && f.StrokeWidth == StrokeWidth)
         {
-          Path::Curve& curv = comp.Curves[j];
-          if(!curv.IsCurve)
-          {
-            t += curv.End.x * CTMMultiplier;
-            t -= curv.End.y * CTMMultiplier;
-            t -= "l";
-          }
-          else
-          {
-            t += curv.StartControl.x * CTMMultiplier;
-            t -= curv.StartControl.y * CTMMultiplier;
-            t -= curv.EndControl.x * CTMMultiplier;
-            t -= curv.EndControl.y * CTMMultiplier;
-            t -= curv.End.x * CTMMultiplier;
-            t -= curv.End.y * CTMMultiplier;
-            t -= "c";
-          }
+          Rasterize(InvokeForm(i));
+          return;
         }
-        if(ClosePath)
-          t += "h"; //Close the path.
       }
 
-      if(Stroke && !Fill)
-        t += "S"; //Stroke only.
-      else if(Fill && !Stroke)
-        t += "f"; //Fill only.
-      else if(Fill && Stroke)
-        t += "B"; //Fill and stroke.
+      String t;
+      Rectangle Bounds;
+      AppendDrawPathOperators(t, p, Stroke, Fill, ClosePath, Bounds);
+      Rasterize(InvokeForm(FindOrCreateForm(t, Bounds, StrokeWidth, &p,
+        Mode)));
+    }
+
+    /**Writes the lines as plain moveto/lineto pairs stroked once. The line
+    width and cap style are set inside a saved graphics state so that they do
+    not leak into later strokes.*/
+    virtual void DrawLines(const prim::Array<prim::math::Line>& Lines,
+      prim::number StrokeWidth, LineCap Cap = LineCaps::Butt)
+    {
+      using namespace prim;
+      using namespace prim::math;
+      if(!Lines.n())
+        return;
+      
+      String t;
+      number CTMMultiplier = PDFProperties->CTMMultiplier;
+
+      //PDF line caps: 0 is butt, 1 is round and 2 is projecting square.
+      t += "q";
+      t -= StrokeWidth * CTMMultiplier;
+      t -= "w";
+      t -= (integer)(Cap == LineCaps::Round ? 1 :
+        (Cap == LineCaps::Square ? 2 : 0));
+      t -= "J";
+
+      for(count i = 0; i < Lines.n(); i++)
+      {
+        const Line& l = Lines.GetConstItem(i);
+        t += l.a.x * CTMMultiplier;
+        t -= l.a.y * CTMMultiplier;
+        t -= "m";
+        t -= l.b.x * CTMMultiplier;
+        t -= l.b.y * CTMMultiplier;
+        t -= "l";
+      }
+      t += "S";
+      t += "Q";
+
+      Rasterize(t);
+    }
+
+    ///Writes the rectangles with the re operator and fills or strokes them.
+    virtual void DrawRectangles(
+      const prim::Array<prim::math::Rectangle>& Rectangles,
+      prim::number StrokeWidth = 0)
+    {
+      using namespace prim;
+      using namespace prim::math;
+      if(!Rectangles.n())
+        return;
+      
+      String t;
+      number CTMMultiplier = PDFProperties->CTMMultiplier;
+
+      if(StrokeWidth > 0)
+      {
+        t += "q";
+        t -= StrokeWidth * CTMMultiplier;
+        t -= "w";
+      }
+
+      for(count i = 0; i < Rectangles.n(); i++)
+      {
+        const prim::math::Rectangle& r = Rectangles.GetConstItem(i);
+        t += r.Left() * CTMMultiplier;
+        t -= r.Bottom() * CTMMultiplier;
+        t -= r.Width() * CTMMultiplier;
+        t -= r.Height() * CTMMultiplier;
+        t -= "re";
+      }
+
+      if(StrokeWidth > 0)
+      {
+        t += "S";
+        t += "Q";
+      }
       else
-        t += "n"; //"No-op"
+        t += "f";
 
       Rasterize(t);
     }
@@ -1242,6 +2662,7 @@ namespace abcd
       {
         FontList.Append(ptrFont);
         FontIndex = FontList.n() - 1;
+        FontCharacterUsage.n(FontList.n() * 256);
       }
 
       //Get a pointer to the OpenType font (otherwise exit)
@@ -1308,6 +2729,10 @@ namespace abcd
         t += "[";
         const ascii* TextChars = Text.Merge();
 
+        //Record the characters drawn so the embedded font can be subset.
+        for(count i=0;i<Text.n();i++)
+          FontCharacterUsage[FontIndex * 256 + (byte)TextChars[i]] = 1;
+
         switch(JustificationType)
         {
           case Justifications::Full:
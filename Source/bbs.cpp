@@ -436,7 +436,7 @@ prim::number bbs::abstracts::Painter::DrawVectorText(
 
     //Go to the character's position and draw it.
     Translate(prim::math::Vector(Advance, 0));
-    DrawPath(*Character, false, true);
+    DrawReusablePath(*Character, false, true);
     UndoTransformation();
 
     //Advance position.
@@ -532,9 +532,8 @@ prim::math::Rectangle bbs::abstracts::Painter::DrawVectorText(
         CapturingWordNotSpace == (Code == 32))
       {
         CapturingWordNotSpace = !CapturingWordNotSpace;
-        prim::String CurrentWord(BeginningOfCurrentWord,
+        WordsAndSpaces.Emplace(BeginningOfCurrentWord,
           (prim::count)(CurrentLetter - BeginningOfCurrentWord));
-        WordsAndSpaces.Add(CurrentWord);
         BeginningOfCurrentWord = CurrentLetter;
       }
       else if(IteratingThroughInitialWhitespace && Code != 32)
@@ -548,9 +547,8 @@ prim::math::Rectangle bbs::abstracts::Painter::DrawVectorText(
           the ability to, if it is long enough, push the beginning of the text
           to the second line. Whitespace in between words is not capable of
           doing this.*/
-          prim::String InitialWhitespace(BeginningOfCurrentWord,
+          WordsAndSpaces.Emplace(BeginningOfCurrentWord,
             (prim::count)(CurrentLetter - BeginningOfCurrentWord));
-          WordsAndSpaces.Add(InitialWhitespace);
           BeginningOfCurrentWord = CurrentLetter;
         }
       }
@@ -558,9 +556,8 @@ prim::math::Rectangle bbs::abstracts::Painter::DrawVectorText(
       if(!*NextLetter)
       {
         //Add the last word to the list.
-        prim::String CurrentWord(BeginningOfCurrentWord,
+        WordsAndSpaces.Emplace(BeginningOfCurrentWord,
           (prim::count)(NextLetter - BeginningOfCurrentWord));
-        WordsAndSpaces.Add(CurrentWord);
       }
     }
 
@@ -727,7 +724,7 @@ prim::math::Rectangle bbs::abstracts::Painter::DrawVectorText(
 
         //Go to the character's position and draw it.
         Translate(prim::math::Vector(Advance, 0));
-        DrawPath(*CurrentCharacter, false, true);
+        DrawReusablePath(*CurrentCharacter, false, true);
         UndoTransformation();
 
         //Advance position.
@@ -790,7 +787,7 @@ prim::math::Rectangle bbs::abstracts::Painter::DrawVectorText(
 
       //Go to the character's position and draw it.
       Translate(prim::math::Vector(Advance, 0));
-      DrawPath(*Character, false, true);
+      DrawReusablePath(*Character, false, true);
       UndoTransformation();
 
       //Advance position.
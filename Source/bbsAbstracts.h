@@ -201,6 +201,18 @@ namespace bbs
         bool Stroke=true, bool Fill=false, bool ClosePath=false,
         prim::number StrokeWidth=0.0) = 0;
 
+      /**Draws a path which is expected to be drawn again unchanged, such as a
+      font glyph. Painters that can instance geometry (for example as PDF Form
+      XObjects) may remember the path by its address, so it must not be
+      modified while the portfolio is being painted. By default it is the same
+      as DrawPath.*/
+      virtual void DrawReusablePath(prim::Path& p,
+        bool Stroke=true, bool Fill=false, bool ClosePath=false,
+        prim::number StrokeWidth=0.0)
+      {
+        DrawPath(p, Stroke, Fill, ClosePath, StrokeWidth);
+      }
+
       virtual void DrawStrokedLine(prim::math::Vector p1, prim::math::Vector p2,
         prim::number StrokeWidth = 0)
       {
@@ -218,6 +230,72 @@ namespace bbs
         DrawPath(p, false, true, true);
       }
 
+      //---------------//
+      //Lines and Boxes//
+      //---------------//
+
+      ///Styles for the ends of lines drawn with DrawLines().
+      typedef prim::count LineCap;
+      struct LineCaps
+      {
+        ///The line ends flush with its end points.
+        static const LineCap Butt = 0;
+
+        ///The line extends past its end points by half of its width.
+        static const LineCap Square = 1;
+
+        ///The line ends in semicircles around its end points.
+        static const LineCap Round = 2;
+      };
+
+      /**Draws a batch of straight lines of the same width in the stroke color.
+      This is much cheaper than building each line as a filled outline, since
+      devices can draw the whole batch with their native line and rectangle
+      primitives. The default implementation builds one filled path.*/
+      virtual void DrawLines(const prim::Array<prim::math::Line>& Lines,
+        prim::number StrokeWidth, LineCap Cap = LineCaps::Butt)
+      {
+        using namespace prim;
+        using namespace prim::math;
+
+        Path p;
+        for(count i = 0; i < Lines.n(); i++)
+        {
+          Vector a = Lines.GetConstItem(i).a, b = Lines.GetConstItem(i).b;
+          if(Cap == LineCaps::Square && a != b)
+          {
+            Vector Extension = b - a;
+            Extension.Mag(StrokeWidth * (number)0.5);
+            a -= Extension;
+            b += Extension;
+          }
+          bool IsRound = (Cap == LineCaps::Round);
+          bbs::Shapes::AddLine(p, a, b, StrokeWidth, true, IsRound, IsRound);
+        }
+
+        //The outline is filled, so fill it with the stroke color.
+        prim::colors::RGB PreviousFillColor = State.TopState().FillColor;
+        FillColor(State.TopState().StrokeColor);
+        DrawPath(p, false, true, true);
+        FillColor(PreviousFillColor);
+      }
+
+      /**Draws a batch of rectangles. If the stroke width is zero, they are
+      filled with the fill color. Otherwise their outlines are stroked in the
+      stroke color with the edges centered on the rectangle bounds.*/
+      virtual void DrawRectangles(
+        const prim::Array<prim::math::Rectangle>& Rectangles,
+        prim::number StrokeWidth = 0)
+      {
+        prim::Path p;
+        for(prim::count i = 0; i < Rectangles.n(); i++)
+          bbs::Shapes::AddRectangle(p, Rectangles.GetConstItem(i));
+        if(StrokeWidth > 0)
+          DrawPath(p, true, false, true, StrokeWidth);
+        else
+          DrawPath(p, false, true, true);
+      }
+
       //Text
       virtual prim::math::Rectangle DrawVectorText(prim::String& Text, 
         bbs::Text::Unformatted& Style, bool OnlyReturnBoundingBox = false);
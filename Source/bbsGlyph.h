@@ -78,6 +78,7 @@ namespace bbs
         AdvanceWidth = Other.AdvanceWidth;
         Kern = Other.Kern;
         Components = Other.Components;
+        InvalidateCache();
         OriginalDeviceIndex = Other.OriginalDeviceIndex;
         CrossReferencedIndex = Other.CrossReferencedIndex;
       }
@@ -56,12 +56,101 @@ namespace bbs
       return (Dist(r.Width(), r.Height()) + Dist(s.Width(), s.Height())) * 0.5f;
     }
 
-    /**Recursively bisects for the closest non-colliding distance of two paths.
-    The first path is the stationary anchor, the other is the floater which
-    moves on a line from the origin to the polar coordinate consisting of an
-    angle and a minimum non-colliding distance. The latter should be calculated
-    with CalculateMinimumNonCollidingDistance. If left zero, it will be
-    automatically calculated.*/
+    ///Returns the dot product of two vectors.
+    static prim::number Dot(prim::math::Vector a, prim::math::Vector b)
+    {
+      return a.x * b.x + a.y * b.y;
+    }
+    
+    /**Finds where a convex floater overlaps a convex anchor as the floater
+    travels along a ray. The floater is displaced by Origin + t * Direction,
+    and the overlap, if any, is the interval of t from Enter to Exit. The two
+    overlap exactly when the displacement lies in the Minkowski difference of
+    the anchor and the floater. That difference is bounded in each direction n
+    by the sum of the anchor's support in n and the floater's support in -n,
+    and its edges are perpendicular to the edges of either polygon, so
+    clipping the ray against those half-planes gives the exact interval.*/
+    static bool CalculateConvexOverlapAlongRay(
+      const prim::math::Polygon& Anchor, const prim::math::Polygon& Floater, prim::math::Vector Origin,
+      prim::math::Vector Direction, prim::number& Enter, prim::number& Exit)
+    {
+      using namespace prim;
+      using namespace prim::math;
+      
+      if(!Anchor.n() || !Floater.n())
+        return false;
+      
+      //Candidate normals are the edge perpendiculars plus the four axes.
+      count Anchor_n = Anchor.n(), Floater_n = Floater.n();
+      count Normals_n = Anchor_n + Floater_n + 2;
+      
+      bool HasEnter = false, HasExit = false;
+      for(count i = 0; i < Normals_n; i++)
+      {
+        Vector e;
+        if(i < Anchor_n)
+          e = Anchor.GetItemValue((i + 1) % Anchor_n) -
+            Anchor.GetItemValue(i);
+        else if(i < Anchor_n + Floater_n)
+          e = Floater.GetItemValue((i - Anchor_n + 1) % Floater_n) -
+            Floater.GetItemValue(i - Anchor_n);
+        else if(i == Normals_n - 2)
+          e = Vector(1, 0);
+        else
+          e = Vector(0, 1);
+        
+        if(e.x == 0 && e.y == 0)
+          continue;
+        
+        //Each perpendicular is tried in both directions.
+        for(count Side = 0; Side < 2; Side++)
+        {
+          Vector n = Side ? Vector(e.y, -e.x) : Vector(-e.y, e.x);
+          
+          //Support of the anchor in n and of the floater in -n
+          number AnchorSupport = Dot(n, Anchor.GetItemValue(0));
+          for(count j = 1; j < Anchor_n; j++)
+            Increase(AnchorSupport, Dot(n, Anchor.GetItemValue(j)));
+          number FloaterMinimum = Dot(n, Floater.GetItemValue(0));
+          for(count j = 1; j < Floater_n; j++)
+            Decrease(FloaterMinimum, Dot(n, Floater.GetItemValue(j)));
+          
+          //Half-plane n * (Origin + t * Direction) <= Bound
+          number Bound = AnchorSupport - FloaterMinimum - Dot(n, Origin);
+          number Rate = Dot(n, Direction);
+          if(Rate > 0)
+          {
+            number t = Bound / Rate;
+            if(!HasExit || t < Exit)
+              Exit = t;
+            HasExit = true;
+          }
+          else if(Rate < 0)
+          {
+            number t = Bound / Rate;
+            if(!HasEnter || t > Enter)
+              Enter = t;
+            HasEnter = true;
+          }
+          else if(Bound < 0)
+            return false; //The ray runs parallel to and outside of the edge.
+        }
+      }
+      
+      return HasEnter && HasExit && Enter <= Exit;
+    }
+
+    /**Calculates the closest non-colliding distance of two paths. The first
+    path is the stationary anchor, the other is the floater which moves on a
+    line from the origin to the polar coordinate consisting of an angle and a
+    minimum non-colliding distance. The latter should be calculated with
+    CalculateMinimumNonCollidingDistance. If left zero, it will be
+    automatically calculated. If the floater still collides at that distance,
+    zero is returned.
+    
+    With convex hulls the distance is found directly from the cached hulls of
+    each path (see Path::GetConvexHulls()). Otherwise the exact outlines are
+    tested with a recursive bisection of the given number of iterations.*/
     static prim::number CalculateClosestNonCollidingDistanceAtAngle(
       const prim::Path& Anchor, const prim::Path& Floater,
       prim::number ThetaRadians, prim::math::Vector AnchorCenter,
@@ -77,6 +166,41 @@ namespace bbs
         MinimumNonCollidingDistance = 
           CalculateMinimumNonCollidingDistance(Anchor, Floater);
 
+      if(UseConvexHulls)
+      {
+        const PolygonPath& AnchorHull = Anchor.GetConvexHulls();
+        const PolygonPath& FloaterHull = Floater.GetConvexHulls();
+        Vector Direction(ThetaRadians, (number)1, false);
+        
+        /*The floater must clear every overlap that ends before the maximum
+        distance. An overlap at the maximum itself means it always collides.*/
+        number BestDistance = 0;
+        for(count i = AnchorHull.Components.n() - 1; i >= 0; i--)
+        {
+          const Polygon& a = AnchorHull.Components.GetConstItem(i);
+          for(count j = FloaterHull.Components.n() - 1; j >= 0; j--)
+          {
+            number Enter = 0, Exit = 0;
+            if(!CalculateConvexOverlapAlongRay(a,
+              FloaterHull.Components.GetConstItem(j), AnchorCenter, Direction,
+              Enter, Exit))
+                continue;
+            
+            if(Enter <= MinimumNonCollidingDistance &&
+              Exit >= MinimumNonCollidingDistance)
+            {
+              _endprofile(primProfiles);
+              return 0;
+            }
+            else if(Exit < MinimumNonCollidingDistance)
+              Increase(BestDistance, Exit);
+          }
+        }
+        
+        _endprofile(primProfiles);
+        return BestDistance;
+      }
+
       number NearDistance = 0, FarDistance = MinimumNonCollidingDistance;
       number BestDistance = FarDistance;
       
@@ -85,22 +209,10 @@ namespace bbs
       //Translate the line on which the floater travels.
       Near += AnchorCenter;
       Far += AnchorCenter;
-      
-      //Create convex hulls if necessary.
-      prim::math::PolygonPath AnchorPolygon, FloaterPolygon;
-      prim::math::PolygonPath AnchorHull, FloaterHull;
-      if(UseConvexHulls)
-      {
-        Anchor.GetPolygonPathOutline(AnchorPolygon);
-        Floater.GetPolygonPathOutline(FloaterPolygon);
-        AnchorPolygon.CreateConvexHull(AnchorHull);
-        FloaterPolygon.CreateConvexHull(FloaterHull);
-      }
 
       /*If the maxima intersects, then return 0 since the floater collides no
       matter what.*/
-      if((UseConvexHulls && AnchorHull.IntersectsOutline(FloaterHull, Far)) ||
-        (!UseConvexHulls && Anchor.IntersectsOutline(Floater, Far)))
+      if(Anchor.IntersectsOutline(Floater, Far))
       {
         _endprofile(primProfiles);
         return 0;
@@ -110,8 +222,7 @@ namespace bbs
       {
         Vector Mid = (Near + Far) * 0.5f;
         number MidDistance = (NearDistance + FarDistance) * 0.5f;
-        if((UseConvexHulls && !AnchorHull.IntersectsOutline(FloaterHull, Mid))
-          || (!UseConvexHulls && !Anchor.IntersectsOutline(Floater, Mid)))
+        if(!Anchor.IntersectsOutline(Floater, Mid))
         {
           //Move closer.
           Far = Mid;
@@ -110,26 +110,38 @@ namespace bbs
       b1_out = b1_in.MakeQuasiParallelCurve(Displacement);
       b2_out = b2_in.MakeQuasiParallelCurve(Displacement);
 
-      number Segmentation = 100.0;
-      for(number i = 0; i < Segmentation; i++)
+      /*Walk the first curve flattened finely relative to the displacement and
+      look for the segment which the second curve crosses. The points are at
+      equal steps of t so each segment's range of t is known.*/
+      Array<Vector> Points;
+      count Segments = b1_out.Flatten(Points, Abs(Displacement) * (number)0.01);
+      bool Joined = false;
+      for(count i = 0; i < Segments && !Joined; i++)
       {
-        number t1 = i / Segmentation;
-        number t2 = (i + (number)1.0) / Segmentation;
-        Line TestLine(b1_out.Value(t1), b1_out.Value(t2));
-        number t2_intersect = b2_out.FindLineIntersection(TestLine);
-        Vector p1 = b2_out.Value(t2_intersect);
+        number t1 = (number)i / (number)Segments;
+        number t2 = (number)(i + 1) / (number)Segments;
+        Line TestLine(Points[i], Points[i + 1]);
         Rectangle r(TestLine.a, TestLine.b);
-        if(r.IsPointInside(p1))
+
+        //Any of the crossings may be the one that lies on this segment.
+        number t2_intersections[3];
+        count Intersections_n =
+          b2_out.FindLineIntersections(TestLine, t2_intersections);
+        for(count j = 0; j < Intersections_n; j++)
         {
-          Vector p0 = TestLine.a;
-          Vector p2 = TestLine.b;
-          number TestLineAngle = -TestLine.Angle();
-          p0.Ang(p0.Ang() + TestLineAngle);
-          p1.Ang(p1.Ang() + TestLineAngle);
-          p2.Ang(p2.Ang() + TestLineAngle);
-          number t1_intersect = (p1.x - p0.x) / (p2.x - p0.x) * (t2 - t1) + t1;
+          number t2_intersect = t2_intersections[j];
+          Vector p1 = b2_out.Value(t2_intersect);
+          if(!r.IsPointInside(p1))
+            continue;
+
+          //Project the crossing onto the segment to find its parameter.
+          Vector Segment = TestLine.b - TestLine.a, Offset = p1 - TestLine.a;
+          number Along = (Offset.x * Segment.x + Offset.y * Segment.y) /
+            (Segment.x * Segment.x + Segment.y * Segment.y);
+          number t1_intersect = Along * (t2 - t1) + t1;
           b1_out.Trim(0, t1_intersect);
           b2_out.Trim(t2_intersect, (number)1.0);
+          Joined = true;
           break;
         }
       }
@@ -303,7 +315,8 @@ namespace bbs
       using namespace prim;
       using namespace prim::math;
 
-      Path::Component& d = DestinationPath.Components.AddOne();
+      DestinationPath.AddComponent();
+      Path::Component& d = DestinationPath.Components.last();
       Path::Component& s = SourceComponent;
       
       count s_Curves_n = s.Curves.n() - 2;
@@ -40,6 +40,14 @@
 #include <string.h>
 #include <stdlib.h>
 
+//Operating system includes for threads and thread-local storage
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 /*The source code all has to do with wrapping methods from the C++ library, so
 that the std namespace and the global ANSI C namespace do not leak into a file
 which includes prim or bbs.*/
@@ -68,6 +76,134 @@ namespace prim
   Profiler primProfiles;
   bool Profiler::Running = true;
   
+  //---------------------------//
+  //Source methods for primHeap//
+  //---------------------------//
+  /**What the operating system slot actually holds for each thread, so that
+  the thread-exit callback knows which ThreadLocalPointer to give it back to.
+  Spare entries are chained through Next.*/
+  struct ThreadLocalEntry
+  {
+    ThreadLocalPointer* Slot;
+    void* Pointer;
+    ThreadLocalEntry* Next;
+
+    ///Keeps the pointer of a finished thread for Adopt(), or frees the entry.
+    void Retire(void)
+    {
+      if(!Pointer)
+      {
+        delete this;
+        return;
+      }
+    #ifdef _WIN32
+      EnterCriticalSection((CRITICAL_SECTION*)Slot->Lock);
+      Next = (ThreadLocalEntry*)Slot->Spares;
+      Slot->Spares = (void*)this;
+      LeaveCriticalSection((CRITICAL_SECTION*)Slot->Lock);
+    #else
+      pthread_mutex_lock((pthread_mutex_t*)Slot->Lock);
+      Next = (ThreadLocalEntry*)Slot->Spares;
+      Slot->Spares = (void*)this;
+      pthread_mutex_unlock((pthread_mutex_t*)Slot->Lock);
+    #endif
+    }
+  };
+
+  ///Called by the operating system as each thread with an entry finishes.
+#ifdef _WIN32
+  static VOID WINAPI RetireThreadLocalEntry(PVOID Entry)
+#else
+  static void RetireThreadLocalEntry(void* Entry)
+#endif
+  {
+    if(Entry)
+      ((ThreadLocalEntry*)Entry)->Retire();
+  }
+
+  ThreadLocalPointer::ThreadLocalPointer() : Key(0), Lock(0), Spares(0)
+  {
+  #ifdef _WIN32
+    Key = (uintptr)FlsAlloc(RetireThreadLocalEntry);
+    CRITICAL_SECTION* NewLock = new CRITICAL_SECTION;
+    InitializeCriticalSection(NewLock);
+    Lock = (uintptr)NewLock;
+  #else
+    pthread_key_t NewKey;
+    pthread_key_create(&NewKey, RetireThreadLocalEntry);
+    Key = (uintptr)NewKey;
+    pthread_mutex_t* NewLock = new pthread_mutex_t;
+    pthread_mutex_init(NewLock, 0);
+    Lock = (uintptr)NewLock;
+  #endif
+  }
+
+  ///Gets the entry of the calling thread, if it has one.
+  static ThreadLocalEntry* GetThreadLocalEntry(uintptr Key)
+  {
+  #ifdef _WIN32
+    return (ThreadLocalEntry*)FlsGetValue((DWORD)Key);
+  #else
+    return (ThreadLocalEntry*)pthread_getspecific((pthread_key_t)Key);
+  #endif
+  }
+
+  ///Gives the calling thread an entry.
+  static void SetThreadLocalEntry(uintptr Key, ThreadLocalEntry* Entry)
+  {
+  #ifdef _WIN32
+    FlsSetValue((DWORD)Key, (PVOID)Entry);
+  #else
+    pthread_setspecific((pthread_key_t)Key, (void*)Entry);
+  #endif
+  }
+
+  void* ThreadLocalPointer::Get(void) const
+  {
+    ThreadLocalEntry* Entry = GetThreadLocalEntry(Key);
+    return Entry ? Entry->Pointer : 0;
+  }
+
+  void ThreadLocalPointer::Set(void* Pointer)
+  {
+    ThreadLocalEntry* Entry = GetThreadLocalEntry(Key);
+    if(!Entry)
+    {
+      Entry = new ThreadLocalEntry;
+      Entry->Slot = this;
+      Entry->Next = 0;
+      SetThreadLocalEntry(Key, Entry);
+    }
+    Entry->Pointer = Pointer;
+  }
+
+  void* ThreadLocalPointer::Adopt(void)
+  {
+  #ifdef _WIN32
+    EnterCriticalSection((CRITICAL_SECTION*)Lock);
+  #else
+    pthread_mutex_lock((pthread_mutex_t*)Lock);
+  #endif
+    ThreadLocalEntry* Spare = (ThreadLocalEntry*)Spares;
+    if(Spare)
+      Spares = (void*)Spare->Next;
+  #ifdef _WIN32
+    LeaveCriticalSection((CRITICAL_SECTION*)Lock);
+  #else
+    pthread_mutex_unlock((pthread_mutex_t*)Lock);
+  #endif
+    if(!Spare)
+      return 0;
+
+    //Hand the spare over to the calling thread in place of its own entry.
+    void* Pointer = Spare->Pointer;
+    Spare->Next = 0;
+    ThreadLocalEntry* Entry = GetThreadLocalEntry(Key);
+    SetThreadLocalEntry(Key, Spare);
+    delete Entry;
+    return Pointer;
+  }
+
   //-----------------------------//
   //Source methods for primRandom//
   //-----------------------------//
@@ -115,6 +251,260 @@ namespace prim
   #endif
   }
   
+  ///Shared state of the threads working on one Parallel::For call.
+  struct ParallelLoop
+  {
+    Parallel::Body Function;
+    void* Context;
+    count Iterations;
+    volatile count NextIndex;
+
+    ///Number of pool workers wanted, joined, and still working (pool lock).
+    count Wanted, Joined, Active;
+
+    ///Claims and runs iterations until none are left.
+    void Work(void)
+    {
+      for(;;)
+      {
+      #ifdef _WIN32
+        //Use the intrinsic that matches the width of count on this target.
+        count Index;
+        if(sizeof(count) == sizeof(LONGLONG))
+          Index = (count)InterlockedExchangeAdd64(
+            (volatile LONGLONG*)&NextIndex, 1);
+        else
+          Index = (count)InterlockedExchangeAdd((volatile LONG*)&NextIndex, 1);
+      #else
+        count Index = __sync_fetch_and_add(&NextIndex, (count)1);
+      #endif
+        if(Index >= Iterations)
+          return;
+        Function(Index, Context);
+      }
+    }
+  };
+
+#ifndef PRIM_USING_SINGLE_THREADED
+  /**Worker threads shared by every Parallel::For call. They are started once,
+  on the first call, and then sleep until a loop is posted, so that a call does
+  not pay for creating and joining threads. One loop runs on the pool at a
+  time; a call made while the pool is busy (a nested loop, or a loop on another
+  thread) runs on its calling thread instead.*/
+  struct ParallelPool
+  {
+  #ifdef _WIN32
+    CRITICAL_SECTION Lock;
+    CONDITION_VARIABLE Posted, Finished;
+  #else
+    pthread_mutex_t Lock;
+    pthread_cond_t Posted, Finished;
+  #endif
+
+    ///The loop being run, or null when no workers should join.
+    ParallelLoop* Loop;
+
+    ///Whether a call currently owns the pool.
+    bool Busy;
+
+    ///The number of worker threads started.
+    count Workers;
+
+    void Acquire(void)
+    {
+    #ifdef _WIN32
+      EnterCriticalSection(&Lock);
+    #else
+      pthread_mutex_lock(&Lock);
+    #endif
+    }
+
+    void Release(void)
+    {
+    #ifdef _WIN32
+      LeaveCriticalSection(&Lock);
+    #else
+      pthread_mutex_unlock(&Lock);
+    #endif
+    }
+
+  #ifdef _WIN32
+    void Wait(CONDITION_VARIABLE* Condition)
+    {
+      SleepConditionVariableCS(Condition, &Lock, INFINITE);
+    }
+
+    void WakeAll(CONDITION_VARIABLE* Condition)
+    {
+      WakeAllConditionVariable(Condition);
+    }
+  #else
+    void Wait(pthread_cond_t* Condition)
+    {
+      pthread_cond_wait(Condition, &Lock);
+    }
+
+    void WakeAll(pthread_cond_t* Condition)
+    {
+      pthread_cond_broadcast(Condition);
+    }
+  #endif
+
+    ///Joins posted loops for the life of the process.
+    void Serve(void)
+    {
+      Acquire();
+      for(;;)
+      {
+        while(!Loop || Loop->Joined >= Loop->Wanted)
+          Wait(&Posted);
+        ParallelLoop* Current = Loop;
+        Current->Joined++;
+        Current->Active++;
+        Release();
+        Current->Work();
+        Acquire();
+        if(--Current->Active == 0)
+          WakeAll(&Finished);
+      }
+    }
+
+  #ifdef _WIN32
+    static DWORD WINAPI Start(LPVOID Pool)
+    {
+      ((ParallelPool*)Pool)->Serve();
+      return 0;
+    }
+  #else
+    static void* Start(void* Pool)
+    {
+      ((ParallelPool*)Pool)->Serve();
+      return 0;
+    }
+  #endif
+
+    ///Starts the workers; the calling thread makes up the remaining processor.
+    ParallelPool() : Loop(0), Busy(false), Workers(0)
+    {
+    #ifdef _WIN32
+      InitializeCriticalSection(&Lock);
+      InitializeConditionVariable(&Posted);
+      InitializeConditionVariable(&Finished);
+    #else
+      pthread_mutex_init(&Lock, 0);
+      pthread_cond_init(&Posted, 0);
+      pthread_cond_init(&Finished, 0);
+    #endif
+      for(count i = 1; i < Parallel::Processors(); i++)
+      {
+      #ifdef _WIN32
+        HANDLE Handle = CreateThread(0, 0, Start, this, 0, 0);
+        if(Handle)
+        {
+          CloseHandle(Handle);
+          Workers++;
+        }
+      #else
+        pthread_t Handle;
+        if(!pthread_create(&Handle, 0, Start, this))
+        {
+          pthread_detach(Handle);
+          Workers++;
+        }
+      #endif
+      }
+    }
+
+    ///Runs the loop with the given number of threads including the caller.
+    void Run(ParallelLoop& Current, count Threads)
+    {
+      Acquire();
+      if(Busy)
+      {
+        Release();
+        Current.Work();
+        return;
+      }
+      Busy = true;
+      Current.Wanted = math::Min(Threads - 1, Workers);
+      Current.Joined = Current.Active = 0;
+      Loop = &Current;
+      if(Current.Wanted > 0)
+        WakeAll(&Posted);
+      Release();
+
+      Current.Work();
+
+      //Stop further workers from joining and wait for those that did.
+      Acquire();
+      Loop = 0;
+      while(Current.Active > 0)
+        Wait(&Finished);
+      Busy = false;
+      Release();
+    }
+  };
+
+  static ParallelPool* SharedParallelPool;
+
+#ifdef _WIN32
+  static INIT_ONCE SharedParallelPoolOnce = INIT_ONCE_STATIC_INIT;
+  static BOOL CALLBACK CreateSharedParallelPool(PINIT_ONCE, PVOID, PVOID*)
+  {
+    SharedParallelPool = new ParallelPool;
+    return TRUE;
+  }
+#else
+  static pthread_once_t SharedParallelPoolOnce = PTHREAD_ONCE_INIT;
+  static void CreateSharedParallelPool(void)
+  {
+    SharedParallelPool = new ParallelPool;
+  }
+#endif
+#endif
+
+  count Parallel::Processors(void)
+  {
+  #ifdef _WIN32
+    SYSTEM_INFO Info;
+    GetSystemInfo(&Info);
+    return (count)Info.dwNumberOfProcessors;
+  #else
+    long Online = sysconf(_SC_NPROCESSORS_ONLN);
+    return Online > 0 ? (count)Online : 1;
+  #endif
+  }
+
+  void Parallel::For(count Iterations, Body Function, void* Context,
+    count MaximumThreads)
+  {
+    if(Iterations <= 0)
+      return;
+
+  #ifdef PRIM_USING_SINGLE_THREADED
+    for(count i = 0; i < Iterations; i++)
+      Function(i, Context);
+  #else
+    if(MaximumThreads <= 0)
+      MaximumThreads = Processors();
+    count Threads = math::Min(MaximumThreads, Iterations);
+
+    ParallelLoop Loop;
+    Loop.Function = Function;
+    Loop.Context = Context;
+    Loop.Iterations = Iterations;
+    Loop.NextIndex = 0;
+
+  #ifdef _WIN32
+    InitOnceExecuteOnce(&SharedParallelPoolOnce, CreateSharedParallelPool, 0,
+      0);
+  #else
+    pthread_once(&SharedParallelPoolOnce, CreateSharedParallelPool);
+  #endif
+    SharedParallelPool->Run(Loop, Threads);
+  #endif
+  }
+
   //----------------------------//
   //Source methods for primTypes//
   //----------------------------//
@@ -322,6 +712,19 @@ namespace prim
     return Length;
   }
 
+  count File::Length(const ascii* Filename)
+  {
+    //Open the file for reading only.
+    std::ifstream FileStream;
+    FileStream.open(Filename, std::ios::in | std::ios::binary);
+    if(!FileStream.is_open())
+      return 0;
+
+    //Seek to the end of the file to get the length.
+    FileStream.seekg(0,std::ios_base::end);
+    return (count)FileStream.tellg();
+  }
+
   bool File::Write(const ascii* Filename, const byte* ByteArray, 
     count BytesToWrite)
   {
@@ -480,6 +883,180 @@ namespace prim
     } 
   }
 
+  //---------------------------//
+  //Source methods for primText//
+  //---------------------------//
+
+  ///Writes bits least-significant first as deflate requires.
+  struct DeflateBitWriter
+  {
+    Array<byte>& Output;
+    uint32 Buffer;
+    count BitsInBuffer;
+
+    DeflateBitWriter(Array<byte>& Output) : Output(Output), Buffer(0),
+      BitsInBuffer(0) {}
+
+    void Write(uint32 Bits, count Length)
+    {
+      Buffer |= Bits << BitsInBuffer;
+      BitsInBuffer += Length;
+      while(BitsInBuffer >= 8)
+      {
+        Output.Add((byte)Buffer);
+        Buffer >>= 8;
+        BitsInBuffer -= 8;
+      }
+    }
+
+    ///Writes a Huffman code, which is stored most-significant bit first.
+    void WriteCode(uint32 Code, count Length)
+    {
+      uint32 Reversed = 0;
+      for(count i = 0; i < Length; i++)
+        Reversed |= ((Code >> i) & 1) << (Length - 1 - i);
+      Write(Reversed, Length);
+    }
+
+    ///Writes a literal or length symbol with the fixed Huffman code.
+    void WriteSymbol(count Symbol)
+    {
+      if(Symbol < 144)
+        WriteCode((uint32)(0x30 + Symbol), 8);
+      else if(Symbol < 256)
+        WriteCode((uint32)(0x190 + Symbol - 144), 9);
+      else if(Symbol < 280)
+        WriteCode((uint32)(Symbol - 256), 7);
+      else
+        WriteCode((uint32)(0xC0 + Symbol - 280), 8);
+    }
+
+    void Flush(void)
+    {
+      if(BitsInBuffer)
+        Output.Add((byte)Buffer);
+      Buffer = 0;
+      BitsInBuffer = 0;
+    }
+  };
+
+  void Text::CompressData(
+    const byte* Data, count DataByteLength, Array<byte>& Compressed)
+  {
+    static const uint16 LengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13,
+      15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195,
+      227, 258};
+    static const uint8 LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1,
+      2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16 DistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25,
+      33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+      4097, 6145, 8193, 12289, 16385, 24577};
+    static const uint8 DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4,
+      4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    const count WindowSize = 32768;
+    const count HashSize = 32768;
+    const count MaximumChain = 64;
+    const count MinimumMatch = 3;
+    const count MaximumMatch = 258;
+
+    Compressed.Clear();
+    Compressed.Reserve(DataByteLength / 2 + 64);
+
+    //Write the zlib header: deflate with a 32K window and default level.
+    Compressed.Add(0x78);
+    Compressed.Add(0x01);
+
+    DeflateBitWriter w(Compressed);
+    w.Write(1, 1); //Final block
+    w.Write(1, 2); //Fixed Huffman codes
+
+    //Chains of earlier positions with the same three-byte hash
+    Array<integer> Head, Previous;
+    Head.n(HashSize);
+    Previous.n(WindowSize);
+    for(count i = 0; i < HashSize; i++)
+      Head[i] = -1;
+
+    count i = 0;
+    while(i < DataByteLength)
+    {
+      count BestLength = 0, BestDistance = 0;
+      if(i + MinimumMatch <= DataByteLength)
+      {
+        count Hash = (((count)Data[i] << 10) ^ ((count)Data[i + 1] << 5) ^
+          (count)Data[i + 2]) & (HashSize - 1);
+        count MaximumLength = DataByteLength - i < MaximumMatch ?
+          DataByteLength - i : MaximumMatch;
+        integer Candidate = Head[Hash];
+        for(count Chain = 0; Candidate >= 0 && i - Candidate <= WindowSize &&
+          Chain < MaximumChain; Chain++)
+        {
+          count Length = 0;
+          while(Length < MaximumLength &&
+            Data[Candidate + Length] == Data[i + Length])
+              Length++;
+          if(Length > BestLength)
+          {
+            BestLength = Length;
+            BestDistance = i - (count)Candidate;
+            if(Length == MaximumLength)
+              break;
+          }
+          integer Next = Previous[Candidate & (WindowSize - 1)];
+          if(Next >= Candidate)
+            break;
+          Candidate = Next;
+        }
+      }
+
+      //Emit a literal or a length and distance pair.
+      count Advance = 1;
+      if(BestLength >= MinimumMatch)
+      {
+        count l = 28;
+        while(LengthBase[l] > BestLength)
+          l--;
+        w.WriteSymbol(257 + l);
+        w.Write((uint32)(BestLength - LengthBase[l]), LengthExtra[l]);
+
+        count d = 29;
+        while(DistanceBase[d] > BestDistance)
+          d--;
+        w.WriteCode((uint32)d, 5);
+        w.Write((uint32)(BestDistance - DistanceBase[d]), DistanceExtra[d]);
+        Advance = BestLength;
+      }
+      else
+        w.WriteSymbol(Data[i]);
+
+      //Insert every position covered into the hash chains.
+      for(count j = 0; j < Advance; j++, i++)
+      {
+        if(i + MinimumMatch > DataByteLength)
+          continue;
+        count Hash = (((count)Data[i] << 10) ^ ((count)Data[i + 1] << 5) ^
+          (count)Data[i + 2]) & (HashSize - 1);
+        Previous[i & (WindowSize - 1)] = Head[Hash];
+        Head[Hash] = i;
+      }
+    }
+    w.WriteSymbol(256); //End of block
+    w.Flush();
+
+    //Write the Adler-32 checksum of the uncompressed data.
+    uint32 a = 1, b = 0;
+    for(count j = 0; j < DataByteLength; j++)
+    {
+      a = (a + Data[j]) % 65521;
+      b = (b + a) % 65521;
+    }
+    uint32 Adler = (b << 16) | a;
+    Compressed.Add((byte)(Adler >> 24));
+    Compressed.Add((byte)(Adler >> 16));
+    Compressed.Add((byte)(Adler >> 8));
+    Compressed.Add((byte)Adler);
+  }
+
   //---------------------------//
   //Source methods for primMath//
   //---------------------------//
@@ -606,6 +1183,93 @@ namespace prim
       return sqrt(DeltaX * DeltaX + DeltaY * DeltaY);
     }
 
+    count Roots(number a, number b, number c, number d,
+      number& Root1, number& Root2, number& Root3)
+    {
+      _profile(primProfiles);
+      double r[3] = {0, 0, 0};
+      count n = 0;
+      
+      double A = a, B = b, C = c, D = d;
+      double Scale = fabs(B) > fabs(C) ? fabs(B) : fabs(C);
+      if(fabs(D) > Scale)
+        Scale = fabs(D);
+
+      if(fabs(A) <= Scale * 1.0e-9)
+      {
+        //Degenerates to a quadratic or a line.
+        if(fabs(B) <= Scale * 1.0e-9)
+        {
+          if(C != 0)
+            r[n++] = -D / C;
+        }
+        else
+        {
+          double Discriminant = C * C - 4.0 * B * D;
+          if(Discriminant >= 0)
+          {
+            double q = -0.5 * (C + (C < 0 ? -1.0 : 1.0) * sqrt(Discriminant));
+            r[n++] = q / B;
+            if(q != 0 && Discriminant > 0)
+              r[n++] = D / q;
+          }
+        }
+      }
+      else
+      {
+        //Reduce to a monic cubic x^3 + p*x^2 + q*x + s.
+        double p = B / A, q = C / A, s = D / A;
+        double Q = (p * p - 3.0 * q) / 9.0;
+        double R = (2.0 * p * p * p - 9.0 * p * q + 27.0 * s) / 54.0;
+        double Q3 = Q * Q * Q;
+        if(R * R < Q3)
+        {
+          //Three real roots
+          double Theta = acos(R / sqrt(Q3));
+          double m = -2.0 * sqrt(Q);
+          r[n++] = m * cos(Theta / 3.0) - p / 3.0;
+          r[n++] = m * cos((Theta + 2.0 * Pi) / 3.0) - p / 3.0;
+          r[n++] = m * cos((Theta - 2.0 * Pi) / 3.0) - p / 3.0;
+        }
+        else
+        {
+          //One real root
+          double u = pow(fabs(R) + sqrt(R * R - Q3), 1.0 / 3.0);
+          if(R > 0)
+            u = -u;
+          r[n++] = (u != 0 ? u + Q / u : 0) - p / 3.0;
+        }
+      }
+
+      //Polish each root since the closed forms can lose precision.
+      for(count i = 0; i < n; i++)
+      {
+        for(count j = 0; j < 2; j++)
+        {
+          double x = r[i];
+          double f = ((A * x + B) * x + C) * x + D;
+          double df = (3.0 * A * x + 2.0 * B) * x + C;
+          if(df == 0)
+            break;
+          r[i] = x - f / df;
+        }
+      }
+
+      //Sort ascending.
+      if(n > 2)
+        Ascending(r[1], r[2]);
+      if(n > 1)
+        Ascending(r[0], r[1]);
+      if(n > 2)
+        Ascending(r[1], r[2]);
+      
+      Root1 = (number)r[0];
+      Root2 = (number)r[1];
+      Root3 = (number)r[2];
+      _endprofile(primProfiles);
+      return n;
+    }
+
     integer Mod(integer x, integer y)
     {
       if(x>=0 || Abs((integer)(-1L % 3L)) == 2)
@@ -39,12 +39,15 @@ namespace prim
   
   Since reallocations only occur at the base-two increments (1 unit, 2 units,
   4 units, 8 units, etc.) very little time is spent overall doing memory
-  copies.*/
+  copies. Elements are relocated by move construction, except for trivially
+  copyable types which are relocated with a single memory copy. If the final
+  size is known in advance, call Reserve() to allocate it all at once.*/
   template <class T>
   class Array
   {
     void* Data;
     count LogicalSize;
+    count PhysicalSize;
 
     static count CalculatePhysicalSizeFromLogical(count Logical)
     {
@@ -72,6 +75,84 @@ namespace prim
       return 0;
     }
 
+    /**Moves the elements into a new block of memory of the given physical size.
+    Returns false if the memory could not be allocated.*/
+    bool Reallocate(count NewPhysicalSize)
+    {
+      void* NewData = (void*)new byte[NewPhysicalSize * sizeof(T)];
+
+      //If memory could not be allocated, leave the array as it is.
+      if(!NewData)
+        return false;
+
+      Memory::RelocateArray((T*)NewData, (T*)Data, LogicalSize);
+      delete [] (byte*)Data;
+      Data = NewData;
+      PhysicalSize = NewPhysicalSize;
+      return true;
+    }
+
+    ///Determines whether an object is stored in this array.
+    bool Contains(const T& Object) const
+    {
+      return &Object >= (const T*)Data &&
+        &Object < (const T*)Data + LogicalSize;
+    }
+
+    ///Makes room for at least one more element.
+    void GrowByOne(void)
+    {
+      if(LogicalSize < PhysicalSize)
+        return;
+      Reallocate(CalculatePhysicalSizeFromLogical(LogicalSize + 1));
+    }
+
+    ///Sorts the inclusive range of elements from Left to Right.
+    void SortRange(count Left, count Right)
+    {
+      T* Items = (T*)Data;
+      while(Right - Left > 16)
+      {
+        //Order the left, middle and right elements and pivot on the middle.
+        count Middle = Left + (Right - Left) / 2;
+        if(Items[Middle] < Items[Left])
+          math::Swap(Items[Middle], Items[Left]);
+        if(Items[Right] < Items[Left])
+          math::Swap(Items[Right], Items[Left]);
+        if(Items[Right] < Items[Middle])
+          math::Swap(Items[Right], Items[Middle]);
+        math::Swap(Items[Middle], Items[Right - 1]);
+        const T& Pivot = Items[Right - 1];
+
+        count i = Left, j = Right - 1;
+        for(;;)
+        {
+          while(Items[++i] < Pivot) {}
+          while(Pivot < Items[--j]) {}
+          if(i >= j)
+            break;
+          math::Swap(Items[i], Items[j]);
+        }
+        math::Swap(Items[i], Items[Right - 1]);
+
+        //Recurse into the smaller side to bound the stack depth.
+        if(i - Left < Right - i)
+        {
+          SortRange(Left, i - 1);
+          Left = i + 1;
+        }
+        else
+        {
+          SortRange(i + 1, Right);
+          Right = i - 1;
+        }
+      }
+
+      for(count i = Left + 1; i <= Right; i++)
+        for(count j = i; j > Left && Items[j] < Items[j - 1]; j--)
+          math::Swap(Items[j], Items[j - 1]);
+    }
+
   public:
     ///Returns the size of the array.
     inline count n(void) const
@@ -79,6 +160,20 @@ namespace prim
       return LogicalSize;
     }
 
+    ///Returns the number of elements the array can hold without reallocating.
+    inline count Capacity(void) const
+    {
+      return PhysicalSize;
+    }
+
+    /**Ensures that the array can hold at least the given number of elements
+    without reallocating. The size of the array does not change.*/
+    void Reserve(count NewCapacity)
+    {
+      if(NewCapacity > PhysicalSize)
+        Reallocate(NewCapacity);
+    }
+
     ///Sets the size of the array.
     T* n(count NewLogicalSize)
     {
@@ -86,83 +181,38 @@ namespace prim
       if(NewLogicalSize <= 0)
       {
         //Call all the destructors.
-        for(count i = 0; i < LogicalSize; i++)
-          ((T*)Data)[i].~T();
+        Memory::DestructArray((T*)Data, LogicalSize);
         delete [] (byte*)Data;
         Data = 0;
         LogicalSize = 0;
+        PhysicalSize = 0;
         return 0;
       }
 
-      /*Since this class uses an exponential expansion model, the size will only
-      increase at powers of two. This means in exchange for using up a little
-      more memory, there are much fewer actual allocations.*/
-      count OldPhysicalSize = CalculatePhysicalSizeFromLogical(LogicalSize);
-      count NewPhysicalSize = CalculatePhysicalSizeFromLogical(NewLogicalSize);
-
-      /*If no extra data needs to be allocated, then just change the size of the
-      array.*/
-      if(OldPhysicalSize == NewPhysicalSize)
-      {
-        //Zero out any previously uninitialized elements.
-        if(NewLogicalSize > LogicalSize)
-        {
-          Memory::Set((void*)&((T*)Data)[LogicalSize], 0, 
-          sizeof(T) * (NewLogicalSize - LogicalSize));
-
-          //Call the constructors of the new objects.
-          for(count i = LogicalSize; i < NewLogicalSize; i++)
-            Memory::PlacementNew(&((T*)Data)[i]);
-        }
-        else if(NewLogicalSize < LogicalSize)
-        {
-          //Call the destructors for the objects that are being removed.
-          for(count i = NewLogicalSize; i < LogicalSize; i++)
-            ((T*)Data)[i].~T();
-        }
-        
-        //Set the new size of the array.
-        LogicalSize = NewLogicalSize;
-        return (T*)Data;
-      }
-
-      //Allocate a new contiguous block of memory.
-      void* NewData = (void*)new byte[NewPhysicalSize * sizeof(T)];
-
-      //If memory could not be allocated, return zero.
-      if(!NewData)
-        return 0;
-
-      //Test to see if the array is getting bigger or smaller.
-      if(NewLogicalSize > LogicalSize)
+      if(NewLogicalSize < LogicalSize)
       {
-        //Copy original data and zero out the new portion.
-        Memory::CopyArray((byte*)NewData, (byte*)Data, 
-          LogicalSize * sizeof(T));
-        Memory::Set((void*)&((T*)NewData)[LogicalSize], 0, 
-          sizeof(T) * (NewLogicalSize - LogicalSize));
-        for(count i = LogicalSize; i < NewLogicalSize; i++)
-          Memory::PlacementNew(&((T*)NewData)[i]);
+        /*Call the destructors for the objects that are being removed. The
+        memory is kept for later growth.*/
+        Memory::DestructArray(&((T*)Data)[NewLogicalSize],
+          LogicalSize - NewLogicalSize);
       }
-      else //Assume that NewLogicalSize is less than LogicalSize.
+      else if(NewLogicalSize > LogicalSize)
       {
-        //Call the destructors of the objects being removed.
-        for(count i = NewLogicalSize; i < LogicalSize; i++)
-          ((T*)Data)[i].~T();
-
-        //Copy data into a smaller array.
-        Memory::CopyArray((byte*)NewData, (byte*)Data, 
-          NewLogicalSize * sizeof(T));
+        /*Since this class uses an exponential expansion model, the size will
+        only increase at powers of two. This means in exchange for using up a
+        little more memory, there are much fewer actual allocations.*/
+        if(NewLogicalSize > PhysicalSize && !Reallocate(
+          CalculatePhysicalSizeFromLogical(NewLogicalSize)))
+            return 0;
+
+        //Construct the new objects directly without clearing them first.
+        Memory::ConstructArray(&((T*)Data)[LogicalSize],
+          NewLogicalSize - LogicalSize);
       }
 
-      //Delete old array.
-      delete [] (byte*)Data;
-
       //Set the new size of the array.
       LogicalSize = NewLogicalSize;
-
-      //Return pointer to the new data array.
-      return (T*)(Data = NewData);
+      return (T*)Data;
     }
 
     ///Clears the array.
@@ -171,15 +221,57 @@ namespace prim
       n(0);
     }
 
-    ///Adds an element to the array.
+    ///Adds an element to the array by copying it.
     void Add(const T& NewElement)
     {
-      n(LogicalSize + 1);
-      ((T*)Data)[LogicalSize - 1] = NewElement;
+      if(LogicalSize == PhysicalSize && Contains(NewElement))
+      {
+        /*The element belongs to this array and is about to be moved by the
+        reallocation, so copy it out first.*/
+        T Copy(NewElement);
+        GrowByOne();
+        new (&((T*)Data)[LogicalSize]) T(static_cast<T&&>(Copy));
+      }
+      else
+      {
+        GrowByOne();
+        new (&((T*)Data)[LogicalSize]) T(NewElement);
+      }
+      LogicalSize++;
+    }
+
+    ///Adds an element to the array by moving it.
+    void Add(T&& NewElement)
+    {
+      if(LogicalSize == PhysicalSize && Contains(NewElement))
+      {
+        T Moved(static_cast<T&&>(NewElement));
+        GrowByOne();
+        new (&((T*)Data)[LogicalSize]) T(static_cast<T&&>(Moved));
+      }
+      else
+      {
+        GrowByOne();
+        new (&((T*)Data)[LogicalSize]) T(static_cast<T&&>(NewElement));
+      }
+      LogicalSize++;
+    }
+
+    /**Constructs an element in place at the end of the array from the given
+    constructor arguments and returns a reference to it. The arguments must not
+    refer to elements of this array.*/
+    template <class... Arguments>
+    T& Emplace(Arguments&&... ConstructorArguments)
+    {
+      GrowByOne();
+      T* NewElement = new (&((T*)Data)[LogicalSize])
+        T(static_cast<Arguments&&>(ConstructorArguments)...);
+      LogicalSize++;
+      return *NewElement;
     }
 
     ///Returns the last element of the array.
-    inline T& last(void)
+    inline T& last(void) const
     {
       return ((T*)Data)[LogicalSize - 1];
     }
@@ -187,8 +279,7 @@ namespace prim
     ///Adds one element to the array and a reference to that element.
     T& AddOne(void)
     {
-      n(LogicalSize + 1);
-      return last();
+      return Emplace();
     }
 
     /**Returns an element by index. The method does not check bounds before
@@ -219,11 +310,19 @@ namespace prim
       return ((T*)Data)[Index];
     }
 
+    /**Sorts the array in ascending order using the element's less-than
+    operator. Ranges are partitioned about a median of three and short ranges
+    finish with an insertion sort. The sort is not stable.*/
+    void Sort(void)
+    {
+      SortRange(0, LogicalSize - 1);
+    }
+
     ///Constructs the array with no elements.
-    Array() : Data(0), LogicalSize(0) {}
+    Array() : Data(0), LogicalSize(0), PhysicalSize(0) {}
 
     ///Constructs the array with some number of elements.
-    Array(count Size) : Data(0), LogicalSize(0) {n(Size);}
+    Array(count Size) : Data(0), LogicalSize(0), PhysicalSize(0) {n(Size);}
 
     /**Copys another array into this one. A copy operation is performed on each
     element to preserve construction and destruction of complex objects.*/
@@ -232,25 +331,51 @@ namespace prim
       if(&Other == this)
         return;
       n(0);
+      if(!Other.LogicalSize)
+        return;
+      Reserve(CalculatePhysicalSizeFromLogical(Other.LogicalSize));
+      Memory::CopyConstructArray((T*)Data, (const T*)Other.Data,
+        Other.LogicalSize);
       LogicalSize = Other.LogicalSize;
-      Data = (void*)new byte[CalculatePhysicalSizeFromLogical(LogicalSize) * 
-        sizeof(T)];
-      for(count i = 0; i < LogicalSize; i++)
-      {
-        Memory::PlacementNew(&(((T*)Data)[i]));
-        ((T*)Data)[i] = ((T*)Other.Data)[i];
-      }
+    }
+
+    /**Takes the elements of another array without copying them. The other
+    array is left empty.*/
+    void MoveFrom(Array<T>& Other)
+    {
+      if(&Other == this)
+        return;
+      n(0);
+      Data = Other.Data;
+      LogicalSize = Other.LogicalSize;
+      PhysicalSize = Other.PhysicalSize;
+      Other.Data = 0;
+      Other.LogicalSize = 0;
+      Other.PhysicalSize = 0;
     }
 
     /**Copy constructor (use sparingly). Normally you would want to use 
     references to a Array rather than copy the whole thing.*/
-    Array(const Array<T> &Other) : Data(0), LogicalSize(0) {CopyFrom(Other);}
+    Array(const Array<T> &Other) : Data(0), LogicalSize(0), PhysicalSize(0)
+    {
+      CopyFrom(Other);
+    }
+
+    ///Move constructor takes the elements of a temporary array.
+    Array(Array<T>&& Other) : Data(0), LogicalSize(0), PhysicalSize(0)
+    {
+      MoveFrom(Other);
+    }
     
-    /**Copy constructor from array data. Does not call items' constructors.*/
-    Array(const T* OtherData, count Length) : Data(0), LogicalSize(0)
+    ///Copy constructor from array data.
+    Array(const T* OtherData, count Length) : Data(0), LogicalSize(0),
+      PhysicalSize(0)
     {
-      n(Length);
-      Memory::CopyArray((T*)Data, OtherData, Length);
+      if(Length <= 0)
+        return;
+      Reserve(CalculatePhysicalSizeFromLogical(Length));
+      Memory::CopyConstructArray((T*)Data, OtherData, Length);
+      LogicalSize = Length;
     }
 
     ///Copys an array to another of the same type.
@@ -260,6 +385,13 @@ namespace prim
       return *this;
     }
 
+    ///Moves a temporary array into this one.
+    Array<T>& operator=(Array<T>&& Other)
+    {
+      MoveFrom(Other);
+      return *this;
+    }
+
     ///Destroys the array.
     ~Array() {n(0);}
   };
@@ -43,6 +43,9 @@ namespace prim
     method returns the number of bytes in the array.*/
     static count Read(const ascii* Filename, byte*& ByteArray);
 
+    ///Returns the length of a file in bytes or zero if it can not be opened.
+    static count Length(const ascii* Filename);
+
     /**Writes a new file from an array of prim::byte. Returns whether or not the
     write was successful.*/
     static bool Write(const ascii* Filename, const byte* ByteArray, 
@@ -29,6 +29,7 @@
 #ifndef primGeometry
 #define primGeometry
 
+#include "primArray.h"
 #include "primMath.h"
 #include "primProfiler.h"
 #include "primRectangle.h"
@@ -534,52 +535,134 @@ namespace prim
           SetControlPoints(p3, p2, p1, p0);
       }
 
-      number FindSimpleYRoot(number tBisectStart = 0,
-        number tBisectEnd = (number)1.0)
+      /**Finds the roots of the y-polynomial which lie within a range of t.
+      The roots are solved in closed form and written in ascending order to
+      tRoots, which must have room for three. Returns the number of roots.*/
+      count FindYRoots(number* tRoots, number tStart = 0,
+        number tEnd = (number)1.0) const
       {
-        count i = 0;
-        while(tBisectEnd - tBisectStart > (number)0.00001 && i < 100)
+        return FindRootsInRange(e, f, g, h, tRoots, tStart, tEnd);
+      }
+
+      /**Returns the first root of the y-polynomial within a range of t, or
+      zero if there is none.*/
+      number FindSimpleYRoot(number tStart = 0, number tEnd = (number)1.0) const
+      {
+        number tRoots[3];
+        return FindYRoots(tRoots, tStart, tEnd) ? tRoots[0] : 0;
+      }
+
+      /**Finds all the intersections of the curve with the infinite line
+      through the given line segment, for 0 <= t <= 1. The curve is
+      substituted into the implicit equation of the line, which leaves a single
+      cubic in t to solve. The values of t are written in ascending order to
+      tValues, which must have room for three. Returns the number found.*/
+      count FindLineIntersections(const Line& l, number* tValues) const
+      {
+        number k3, k2, k1, k0;
+        GetLineCoefficients(l, k3, k2, k1, k0);
+        return FindRootsInRange(k3, k2, k1, k0, tValues, 0, (number)1.0);
+      }
+
+      /**Returns the first intersection of the curve with the line through the
+      given line segment, or zero if there is none.*/
+      number FindLineIntersection(const Line& l) const
+      {
+        number tValues[3];
+        return FindLineIntersections(l, tValues) ? tValues[0] : 0;
+      }
+
+      /**Intersects one line with many curves. The implicit line equation is
+      applied to all the curves in a single pass over contiguous arrays, which
+      the compiler can vectorize, and then each cubic is solved. For each curve
+      the first intersection within 0 <= t <= 1 is written to tFirst, or -1 if
+      the curve does not meet the line. Returns the number of curves that meet
+      the line.*/
+      static count FindLineIntersections(const Line& l,
+        const Array<Bezier>& Curves, Array<number>& tFirst)
+      {
+        count Curves_n = Curves.n();
+        tFirst.n(Curves_n);
+        if(!Curves_n)
+          return 0;
+
+        //Coefficients of the cubics, stored as four parallel runs.
+        Array<number> k;
+        k.n(Curves_n * 4);
+        number* k3 = &k[0];
+        number* k2 = k3 + Curves_n;
+        number* k1 = k2 + Curves_n;
+        number* k0 = k1 + Curves_n;
+        const Bezier* b = &Curves.GetConstItem(0);
+        number nx = l.a.y - l.b.y, ny = l.b.x - l.a.x;
+        number Offset = nx * l.a.x + ny * l.a.y;
+        for(count i = 0; i < Curves_n; i++)
         {
-          i++;
-          number v0 = Value(tBisectStart).y;
-          number tBisect = (tBisectStart + tBisectEnd) * (number)0.5;
-          number v1 = Value(tBisect).y;
-          number v2 = Value(tBisectEnd).y;
-          if((v0 < v1 && v0 <= 0 && v1 >= 0) || 
-            (v0 >= v1 && v1 <= 0 && v0 >= 0))
-              tBisectEnd = tBisect;
-          else if((v1 < v2 && v1 <= 0 && v2 >= 0) || 
-            (v1 >= v2 && v2 <= 0 && v1 >= 0))
-              tBisectStart = tBisect;
+          k3[i] = nx * b[i].a + ny * b[i].e;
+          k2[i] = nx * b[i].b + ny * b[i].f;
+          k1[i] = nx * b[i].c + ny * b[i].g;
+          k0[i] = nx * b[i].d + ny * b[i].h - Offset;
+        }
+
+        count Intersecting = 0;
+        for(count i = 0; i < Curves_n; i++)
+        {
+          number tValues[3];
+          if(FindRootsInRange(k3[i], k2[i], k1[i], k0[i], tValues, 0,
+            (number)1.0))
+          {
+            tFirst[i] = tValues[0];
+            Intersecting++;
+          }
           else
-            return 0;
+            tFirst[i] = (number)-1.0;
         }
-        return (tBisectStart + tBisectEnd) * (number)0.5;
+        return Intersecting;
       }
 
-      number FindLineIntersection(Line l)
-      {
-        number Rotation = -l.Angle();
+      ///Largest number of segments the curve will be flattened into
+      static const count MaximumFlatteningSegments = 1024;
 
-        /*Rotate and vertically translate the line and curve such that the line
-        is horizontal and use Newton's method to solve for the y-root.*/
-        Vector p0, p1, p2, p3;
-        GetControlPoints(p0, p1, p2, p3);
-        l.a.Ang(l.a.Ang() + Rotation);
-        l.b.Ang(l.b.Ang() + Rotation);
-        p0.Ang(p0.Ang() + Rotation);
-        p1.Ang(p1.Ang() + Rotation);
-        p2.Ang(p2.Ang() + Rotation);
-        p3.Ang(p3.Ang() + Rotation);
-
-        number Translation = -l.a.y;
-        p0.y += Translation;
-        p1.y += Translation;
-        p2.y += Translation;
-        p3.y += Translation;
+      /**Returns the number of equal steps in t needed to flatten the curve so
+      that it is never further than the tolerance from the segments. Over each
+      step the curve deviates from its chord like a parabola whose bend is
+      bounded by the second differences of the control points. The count comes
+      from that bound (Wang's formula), n = Sqrt(3 / 4 * M / Tolerance), so it
+      is known before any point is computed.*/
+      count CalculateFlatteningSegments(number Tolerance) const
+      {
+        //The second differences are b / 3 and a + b / 3 in coefficient form.
+        number M = Max(Dist(b / (number)3.0, f / (number)3.0),
+          Dist(a + b / (number)3.0, e + f / (number)3.0));
+        if(Tolerance <= 0)
+          return M > 0 ? MaximumFlatteningSegments : 1;
+        number Segments = Sqrt((number)0.75 * M / Tolerance);
+        if(Segments >= (number)MaximumFlatteningSegments)
+          return MaximumFlatteningSegments;
+        count Rounded = (count)Segments;
+        if((number)Rounded < Segments)
+          Rounded++;
+        return Max(Rounded, (count)1);
+      }
 
-        Bezier b_root; b_root.SetControlPoints(p0, p1, p2, p3);
-        return b_root.FindSimpleYRoot();
+      /**Appends the flattened curve to an array of points and returns the
+      number of segments. The points are at equal steps of t from the start
+      (if included) to the end, computed by forward differencing so that each
+      point costs only a few additions. Pass a reused array to avoid
+      allocating on every call.*/
+      count Flatten(Array<Vector>& Points, number Tolerance,
+        bool IncludeStart = true) const
+      {
+        FlatteningSteps Steps(*this, CalculateFlatteningSegments(Tolerance));
+        Points.Reserve(Points.n() + Steps.Segments + 1);
+        if(IncludeStart)
+          Points.Add(Steps.Point);
+        for(count i = 0; i < Steps.Segments; i++)
+        {
+          Steps.Next();
+          Points.Add(Steps.Point);
+        }
+        return Steps.Segments;
       }
 
       void SplitBezier(Bezier& Left, Bezier& Right)
@@ -590,22 +673,21 @@ namespace prim
         Right.Trim(0.5f, 1.0f);
       }
 
-      number CalculateArcLength(number Tolerance = 0.001f)
+      /**Returns the arc length of the curve, summed over the segments of the
+      curve flattened to the given tolerance.*/
+      number CalculateArcLength(number Tolerance = 0.001f) const
       {
-        Vector v0, v1, v2, v3;
-        GetControlPoints(v0, v1, v2, v3);
-        number PolygonLength = Dist(v0, v1) + Dist(v1, v2) + Dist(v2, v3);
-        number ChordLength = Dist(v0, v3);
-        number CurrentError = PolygonLength - ChordLength;
-        if(CurrentError > Tolerance)
+        FlatteningSteps Steps(*this, CalculateFlatteningSegments(Tolerance));
+        number ArcLength = 0;
+        Vector Previous = Steps.Point;
+        for(count i = 0; i < Steps.Segments; i++)
         {
-          Bezier Left, Right;
-          SplitBezier(Left, Right);
-          return Left.CalculateArcLength(Tolerance) + 
-            Right.CalculateArcLength(Tolerance);
+          Steps.Next();
+          ArcLength += Dist(Previous.x, Previous.y, Steps.Point.x,
+            Steps.Point.y);
+          Previous = Steps.Point;
         }
-        else
-          return PolygonLength * (number)0.5 + ChordLength * (number)0.5;
+        return ArcLength;
       }
 
       number Length(number Point1 = 1.0f, number Point2 = 0.0f,
@@ -615,6 +697,73 @@ namespace prim
         Bezier SubArc = *this; SubArc.Trim(Point1, Point2);
         return SubArc.CalculateArcLength(Tolerance);
       }
+
+    private:
+      /**Walks the curve in equal steps of t by forward differencing. The last
+      step lands exactly on the end point so that error does not accumulate
+      into the joins between curves.*/
+      struct FlatteningSteps
+      {
+        Vector Point, First, Second, Third, End;
+        count Segments, Step;
+
+        FlatteningSteps(const Bezier& c, count Segments_) :
+          Segments(Segments_), Step(0)
+        {
+          number dt = (number)1.0 / (number)Segments;
+          number dt2 = dt * dt, dt3 = dt2 * dt;
+          Point = Vector(c.d, c.h);
+          First = Vector(c.a * dt3 + c.b * dt2 + c.c * dt,
+            c.e * dt3 + c.f * dt2 + c.g * dt);
+          Second = Vector((number)6.0 * c.a * dt3 + (number)2.0 * c.b * dt2,
+            (number)6.0 * c.e * dt3 + (number)2.0 * c.f * dt2);
+          Third = Vector((number)6.0 * c.a * dt3, (number)6.0 * c.e * dt3);
+          End = Vector(c.a + c.b + c.c + c.d, c.e + c.f + c.g + c.h);
+        }
+
+        void Next(void)
+        {
+          if(++Step == Segments)
+          {
+            Point = End;
+            return;
+          }
+          Point += First;
+          First += Second;
+          Second += Third;
+        }
+      };
+
+      /**Gets the coefficients of the cubic whose roots are the intersections
+      with the line. The curve is substituted into n * (p - l.a) = 0 where n is
+      the normal of the line, so that no rotation is needed.*/
+      void GetLineCoefficients(const Line& l, number& k3, number& k2,
+        number& k1, number& k0) const
+      {
+        number nx = l.a.y - l.b.y, ny = l.b.x - l.a.x;
+        k3 = nx * a + ny * e;
+        k2 = nx * b + ny * f;
+        k1 = nx * c + ny * g;
+        k0 = nx * (d - l.a.x) + ny * (h - l.a.y);
+      }
+
+      /**Solves a cubic and keeps the roots within a range of t. Roots just
+      outside of the range due to rounding are clamped into it.*/
+      static count FindRootsInRange(number k3, number k2, number k1,
+        number k0, number* tRoots, number tStart, number tEnd)
+      {
+        const number Tolerance = (number)0.00001;
+        number r[3];
+        count Roots_n = Roots(k3, k2, k1, k0, r[0], r[1], r[2]);
+        count Kept = 0;
+        for(count i = 0; i < Roots_n; i++)
+        {
+          if(r[i] < tStart - Tolerance || r[i] > tEnd + Tolerance)
+            continue;
+          tRoots[Kept++] = Min(Max(r[i], tStart), tEnd);
+        }
+        return Kept;
+      }
     };
 
     /**\brief A structure with static-only methods for computing some useful
@@ -35,6 +35,46 @@
 
 namespace prim
 {
+  /**\brief Stores one pointer per thread. \details Heap uses this to give
+  each thread its own set of free units so that threads never contend for
+  them. When a thread finishes, the pointer it stored is kept by the slot and
+  handed to the next thread that calls Adopt(), so per-thread objects are
+  reused rather than lost. The slot is created on first use and lives until
+  the process exits, since objects with static storage may still need it
+  while they are being destroyed. The implementation is in prim.cpp so that
+  the operating system headers do not leak into files which include prim.*/
+  class ThreadLocalPointer
+  {
+    ///Opaque handle of the operating system slot
+    uintptr Key;
+
+    ///Opaque handle of the lock guarding the spares
+    uintptr Lock;
+
+    ///Entries left behind by finished threads, waiting to be adopted
+    void* Spares;
+
+    ///Not copyable since the slot belongs to a single owner.
+    ThreadLocalPointer(const ThreadLocalPointer& Other);
+    ThreadLocalPointer& operator=(const ThreadLocalPointer& Other);
+
+    friend struct ThreadLocalEntry;
+
+  public:
+    ///Creates the slot. Every thread initially sees a null pointer.
+    ThreadLocalPointer();
+
+    ///Gets the pointer stored by the calling thread.
+    void* Get(void) const;
+
+    ///Sets the pointer for the calling thread.
+    void Set(void* Pointer);
+
+    /**Takes over the pointer of a thread that has finished and stores it for
+    the calling thread. Returns null if no thread has left one behind.*/
+    void* Adopt(void);
+  };
+
   /**\brief Heap is a templated heap allocation and garbage collector with
   special emphasis on fast creation of individual elements. \details It solves
   two common annoyances of C++ programs: fragmentation of the heap over time
@@ -44,20 +84,18 @@ namespace prim
   are very expensive computationally if you, for example, allocate a number of
   things all at once that are not contiguous.
 
-  Heap allocates memory only in type unit powers of two. This means that as
-  more and more units are allocated, Heap calls the 'new' operator less 
-  frequently since the allocation curve anticipates growth.
-
-  Working the opposite way, when units are deallocated, Heap saves a linked 
-  deletion tree that traverses through the old locations of each deallocated 
-  unit. When the largest power-of-two heap has a full deletion tree, it is 
-  automatically collapsed. Since Heap stores the linking pointers in the 
-  abandoned memory, the unit width must be greater than or equal to the size of 
-  the pointer. Otherwise, Heap forces the allocated units to be at least as 
-  large as the size of a pointer. Allocating a heap of chars would thus be
-  inefficient. Heap works best with larger types, like links in a linked list. 
-  Also, when the deletion tree is active, subsequent calls to New() simply pop 
-  an item off that stack instead of increasing the heap's size.
+  Heap allocates memory in blocks that double in size each time the previous
+  block runs out. This means that as more and more units are allocated, Heap
+  calls the 'new' operator less frequently since the allocation curve
+  anticipates growth.
+
+  When units are deallocated, Heap pushes them onto a single free list that is
+  threaded through the abandoned memory, and subsequent calls to New() simply
+  pop an item off that list. Both New() and Delete() are therefore constant
+  time: neither has to find out which block a unit came from. Since Heap stores
+  the linking pointer in the abandoned memory, each unit is at least as large
+  as a pointer. Allocating a heap of chars would thus be inefficient. Heap
+  works best with larger types, like links in a linked list.
 
   Allocating and deallocating memory works exactly like it does in plain C++
   memory operations. Call New() to get a pointer to the next new item. Note
@@ -66,36 +104,29 @@ namespace prim
 
   You call Delete(T*& ObjectPointer) with a reference to the object
   pointer. Before it deallocates the memory, it will call the destructor of
-  the object if there is one, and then it will zero out your pointer.
+  the object if there is one, and then it will zero out your pointer. A unit
+  may be given back to a different heap of the same type than the one that
+  created it, as long as that heap lives at least as long as the unit's memory
+  is needed (see ForCurrentThread()).
 
-  You can also instruct Heap to delete all of the subheaps at once. Doing this
+  You can also instruct Heap to delete all of the blocks at once. Doing this
   however does not call the destructors of each object, so make sure you are
   calling it for the right reason (i.e. the object's destructor is irrelevant
   because all the memory is being deleted). To delete in this way call
   DeleteAllWithoutDestructor(). This is also the default behavior of the Heap
   destructor, so the memory just needs to be freed then you can let Heap take 
-  care of the garbage collection as it goes out of scope.
+  care of the garbage collection as it goes out of scope. Heap otherwise keeps
+  its blocks for reuse until then.
 
   To determine the number of elements in the heap call Size(). Note that by
   design you can not iterate through the elements like an array, which is also
-  why you can not delete all of the subheaps and simultaneously call each 
-  object's destructor. Heap has no direct knowledge of a unit's existence except
-  indirectly through the deletion tree. Iterating would essentially be a
-  O(n-squared) operation if it existed under this algorithm.
-
-  Heap comes at a cost of 376 bytes on a 32-bit platform plus the amount of
-  data allocated rounded up to the nearest power of two. According to 
-  statistical tests, the data structure takes up on average 1.4 times the
-  amount it would take up as a single array. However, when used without
-  destructors, tests indicate that it is up to 50 times faster than using
-  regular new/delete operations and with destructors called, it is
-  approximately 2 times faster.
-
-  Heap has a few disadvantages over other memory pool management algorithms.
-  Firstly, Heap easily inflates, but deflates only when all units in the largest
-  subheap have been deleted. Thus, if you were to randomly delete elements, then
-  the size of the heap would not deflate until practically units had been 
-  deleted.
+  why you can not delete all of the blocks and simultaneously call each
+  object's destructor.
+
+  In release builds Heap does not touch the memory of the units it hands out.
+  If prim is compiled with PRIM_DEBUG_HEAP defined, then every unit is filled
+  with 0xFF bytes when it is allocated and again when it is deleted, so that
+  reads of uninitialized or deleted memory are easier to spot.
 
   Note: if you need statistical information about the memory, you can derive a
   class from Heap and call the protected statistics methods.*/
@@ -108,58 +139,58 @@ namespace prim
 
     //CONSTANTS//
 
-    /**\brief UnitAlignment stores the number of bytes in a pointer, so as
-    to be independent of 32-bit/64-bit platforms. \details It is computed at
-    compile- time. We must determine the size of pointers in bytes, so that
-    we can know what the alignment is and so that each unit will be
-    guaranteed to take up at least enough space to contain a pointer, so
-    that the deletion tree will work.*/
-    static const count UnitAlignment = sizeof(void*);
-
-    /**\brief BinaryHeapMaximum contains the physical limit of heaps per the
-    build environment (i.e\details . 32-bit or 64-bit). On a 32-bit system
-    this will compute to 30, meaning approximately a billion units at 4
-    bytes each, which maxes out at 4 GB, as you expect. On a 64-bit system,
-    this will compute to 61. Of course the operating system will probably
-    deny these requests before this limit is reached. This number is used
-    for the static array of heap pointers.*/
-    static const count BinaryHeapMaximum = UnitAlignment * (count)8 -
-      (count)math::meta::LogBaseTwo<UnitAlignment>::Value;
-
-    /*Whenever memory is allocated or deallocated, each char takes on
-    this value.*/
-    static const uint8 MemSetDefaultValue = 0xFF;
+    /**\brief UnitAlignment stores the alignment of each unit. \details It is
+    at least the number of bytes in a pointer, so that each unit is guaranteed
+    to take up enough space to contain the link of the free list, and at least
+    the alignment that T requires.*/
+    static const count UnitAlignment = (count)alignof(T) <
+      (count)sizeof(void*) ? (count)sizeof(void*) : (count)alignof(T);
 
     /**\brief Stores the size of T taking into account alignment (for
     example if smaller than the width of a pointer, then the size will be
     the width of a pointer.*/
-    static const count SizeOfUnit = (count)sizeof(T) < UnitAlignment ?
-      UnitAlignment : (count)sizeof(T);
+    static const count SizeOfUnit = ((count)sizeof(T) + UnitAlignment -
+      (count)1) / UnitAlignment * UnitAlignment;
+
+    ///Number of bytes in front of the first unit of each block
+    static const count SizeOfBlockHeader = ((count)sizeof(void*) +
+      UnitAlignment - (count)1) / UnitAlignment * UnitAlignment;
+
+    ///Number of units in the first block that is allocated
+    static const count InitialBlockUnits = 16;
+
+#ifdef PRIM_DEBUG_HEAP
+    /*Whenever memory is allocated or deallocated, each char takes on
+    this value.*/
+    static const uint8 MemSetDefaultValue = 0xFF;
+#endif
 
 
     //INTERNAL DATA//
 
-    /**\brief Number of virtual address spaces made available either as data
-    nodes or deletion nodes*/
-    count UnitsAllocated;
+    ///Most recently deleted unit, which links to the one deleted before it
+    void* FreeList;
+
+    ///Most recently allocated block, which links to the one before it
+    void* Blocks;
 
-    ///Number of heaps
-    count HeapsAllocated;
+    ///Next unit of the newest block that has never been handed out
+    byte* NextUnit;
 
-    ///Number of units at which a new heap must be created
-    count HeapThreshold;
+    ///End of the newest block
+    byte* EndOfBlock;
 
-    ///Index of current unit within largest heap
-    count HeapUnit;
+    ///Number of units currently handed out by New()
+    count UnitsInUse;
 
-    ///Physical spaces which contain pre-allocated memory
-    void* Heaps[BinaryHeapMaximum];
+    ///Number of units in all of the blocks
+    count UnitsInBlocks;
 
-    ///Deletion trees for each heap
-    void* DeletionTreeRoot[BinaryHeapMaximum];
+    ///Number of blocks
+    count BlocksAllocated;
 
-    ///Deletion counts per heap for enabling automatic collapses
-    count DeletionCountPerHeap[BinaryHeapMaximum];
+    ///Number of units on the free list
+    count UnitsOnFreeList;
 
 
     //HELPERS//
@@ -167,61 +198,40 @@ namespace prim
     ///Resets all data structures, but does not know to free memory.
     void Initialize(void)
     {
-      _profile(primProfiles);
-      UnitsAllocated=0;
-      HeapUnit=0;
-      HeapsAllocated=0;
-      HeapThreshold=1;
-      for(count i=0;i<BinaryHeapMaximum;i++)
-      {
-        _profile(primProfiles);
-        Heaps[i]=0;
-        DeletionTreeRoot[i]=0;
-        DeletionCountPerHeap[i]=0;
-      }
-      _endprofile(primProfiles);
+      FreeList = 0;
+      Blocks = 0;
+      NextUnit = 0;
+      EndOfBlock = 0;
+      UnitsInUse = 0;
+      UnitsInBlocks = 0;
+      BlocksAllocated = 0;
+      UnitsOnFreeList = 0;
     }
 
-    /**Gets the address range of a particular heap. Note, in practice this is
-    the most-called function in the prim library!*/
-    inline void GetHeapRange(count HeapIndex,
-      void*& LowAddress, void*& HighAddress) const
+    /**Allocates a new block twice the size of all the previous blocks put
+    together. Returns false if the memory could not be obtained.*/
+    bool AllocateBlock(void)
     {
-      _profile(primProfiles);
-      //We assume... HeapIndex >= 0 and HeapIndex < HeapsAllocated
-      LowAddress = Heaps[HeapIndex];
-      HighAddress = (void*)((byte*)LowAddress +
-        ((uintptr)SizeOfUnit << (uintptr)HeapIndex));
-      _endprofile(primProfiles);
+      count Units = UnitsInBlocks > 0 ? UnitsInBlocks : InitialBlockUnits;
+      byte* Block = (byte*)new int8[(uintptr)(SizeOfBlockHeader +
+        SizeOfUnit * Units)];
+      if(!Block)
+        return false;
+
+      //Chain the block onto the others so that it can be freed later.
+      *(void**)Block = Blocks;
+      Blocks = (void*)Block;
+
+      NextUnit = Block + SizeOfBlockHeader;
+      EndOfBlock = NextUnit + SizeOfUnit * Units;
+      UnitsInBlocks += Units;
+      BlocksAllocated++;
+      return true;
     }
 
-    ///Finds the heap that contains a particular unit.
-    void FindIndexLocationFromPointer(void* HeapPointer,
-      count& HeapIndex, count& UnitIndex) const
-    {
-      _profile(primProfiles);
-      //Iterate through the heaps and find which one's range includes
-      //the pointer in question.
-      for(count i=0;i<HeapsAllocated;i++)
-      {
-        void* HeapRangeLow=0, *HeapRangeHigh=0;
-        GetHeapRange(i, HeapRangeLow, HeapRangeHigh);
-        if(HeapPointer >= HeapRangeLow && HeapPointer < HeapRangeHigh)
-        {
-          HeapIndex=i;
-          UnitIndex=(*(uintptr*)&HeapPointer-*(uintptr*)&HeapRangeLow)
-            / SizeOfUnit;
-          _endprofile(primProfiles);
-          return;
-        }
-      }
-      /*Can not find the heap. This occurs when the user asks something
-      not in any heap to be deleted, which in general should not happen.
-      This is cautionary code.*/
-      HeapIndex=-1;
-      UnitIndex=0;
-      _endprofile(primProfiles);
-    }
+    ///Not copyable since the units can not be duplicated.
+    Heap(const Heap<T>& Other);
+    Heap<T>& operator=(const Heap<T>& Other);
 
   protected:
 
@@ -231,48 +241,39 @@ namespace prim
     ///Gets the total number of units that allocated with New().
     count TotalUnitsAssigned(void) const
     {
-      return UnitsAllocated;
+      return UnitsInUse;
     }
 
     ///Gets the total number of unassigned but allocated spaces available.
     count TotalUnitsUnassigned(void) const
     {
-      return HeapThreshold-UnitsAllocated-1;
+      return UnitsOnFreeList + (count)(EndOfBlock - NextUnit) / SizeOfUnit;
     }
 
-    ///Gets the number of heaps.
-    count TotalHeaps(void) const
+    ///Gets the number of blocks.
+    count TotalBlocks(void) const
     {
-      return HeapsAllocated;
+      return BlocksAllocated;
     }
 
-    ///Returns the number of units at which a new heap will be allocated.
-    count CurrentUnitThreshold(void) const
+    ///Returns the number of units in all of the blocks.
+    count TotalUnitsInBlocks(void) const
     {
-      return HeapThreshold;
+      return UnitsInBlocks;
     }
 
-    ///Returns the largest heap, from which new allocations are being made.
-    count CurrentHeapUnit(void) const
+    ///Returns the number of items on the free list.
+    count FreeListSize(void) const
     {
-      return HeapUnit;
-    }
-
-    ///Returns the number of items in the deletion trees.
-    count DeletionTreeSize(void) const
-    {
-      count DeletionSum=0;
-      for(count i=0;i<HeapsAllocated;i++)
-        DeletionSum+=DeletionCountPerHeap[i];
-      return DeletionSum;
+      return UnitsOnFreeList;
     }
 
     /**\brief Calculates the amount of excess space as a ratio of the total
     allocated space to the minimum that would be required to fit the data.*/
     number MemorySpaceInefficiency(void) const
     {
-      if(CurrentUnitThreshold()>1)
-        return (number)(CurrentUnitThreshold()-1) / (number)Size();
+      if(Size() > 0)
+        return (number)UnitsInBlocks / (number)Size();
       else
         return (number)1.0;
     }
@@ -285,6 +286,22 @@ namespace prim
       Initialize();
     }
 
+    /**Takes over the units of another heap. The units keep their addresses,
+    so pointers into the other heap remain valid, and the other heap is left
+    empty.*/
+    Heap(Heap<T>&& Other)
+    {
+      FreeList = Other.FreeList;
+      Blocks = Other.Blocks;
+      NextUnit = Other.NextUnit;
+      EndOfBlock = Other.EndOfBlock;
+      UnitsInUse = Other.UnitsInUse;
+      UnitsInBlocks = Other.UnitsInBlocks;
+      BlocksAllocated = Other.BlocksAllocated;
+      UnitsOnFreeList = Other.UnitsOnFreeList;
+      Other.Initialize();
+    }
+
     /**\brief Destroys Heap and automatically frees its memory, but does not
     call the destructors of the still-allocated units.*/
     ~Heap()
@@ -292,180 +309,108 @@ namespace prim
       DeleteAllWithoutDestructor();
     }
 
+    /**\brief Returns the heap belonging to the calling thread. \details Each
+    thread gets its own heap for each type the first time it asks, so threads
+    can allocate and delete at the same time without locking. Units may be
+    created by one thread and deleted by another; they then join the free list
+    of the deleting thread. For that reason these heaps are never destroyed.
+    Instead the heap of a finished thread is handed on whole to the next new
+    thread, so the number of heaps never exceeds the largest number of threads
+    that were running at once. Size() is only meaningful for heaps that are not
+    shared in this way.*/
+    static Heap<T>& ForCurrentThread(void)
+    {
+      static ThreadLocalPointer Slot;
+      Heap<T>* ThreadHeap = (Heap<T>*)Slot.Get();
+      if(!ThreadHeap)
+        ThreadHeap = (Heap<T>*)Slot.Adopt();
+      if(!ThreadHeap)
+      {
+        ThreadHeap = new Heap<T>;
+        Slot.Set((void*)ThreadHeap);
+      }
+      return *ThreadHeap;
+    }
+
     /**Requests a pointer to a new unit. There is no method available for
     requesting multiple units at once as Heap is designed for allocating
     non-contiguous units of memory.*/
     T* New(void)
     {
-      _profile(primProfiles);
-      //Test to see if there are any open spots in the deletion trees.
-      for(count i=HeapsAllocated-1;i>=0;i--)
+      void* Unit;
+      if(FreeList)
       {
-        if(DeletionCountPerHeap[i]>0)
-        {
-          //Found a previously deleted element, so just use that one.
-          DeletionCountPerHeap[i]--;
-          T* RecycledUnit=(T*)DeletionTreeRoot[i];
-
-          //Grab the reference to the next deletion tree node.
-          DeletionTreeRoot[i]=*(void**)RecycledUnit;
-
-          //Initialize the unit.
-          Memory::Set(RecycledUnit, MemSetDefaultValue, SizeOfUnit);
-
-          //Call a placement new.
-          _endprofile(primProfiles);
-          return Memory::PlacementNew(RecycledUnit);
-        }
-      }
-
-
-      if(UnitsAllocated+1==HeapThreshold)
-      {
-        //Have to make a new heap...
-        uintptr HeapBytes=SizeOfUnit*HeapThreshold;
-
-        Heaps[HeapsAllocated]=(void*)new int8[HeapBytes];
-
-        //We need to make sure we actually received the memory from the
-        //operating system...
-        if(Heaps[HeapsAllocated]==0)
-        {
-          //Out of memory... return null pointers, and keep everything
-          //as is.
-          _endprofile(primProfiles);
-          return (T*)0;
-        }
-
-        UnitsAllocated++;
-        HeapUnit=0;
-        HeapsAllocated++;
-        HeapThreshold*=2;
-
-        //Initialize all the memory.
-        Memory::Set(
-          Heaps[HeapsAllocated-1],MemSetDefaultValue,HeapBytes);
+        //Found a previously deleted element, so just use that one.
+        Unit = FreeList;
+        FreeList = *(void**)Unit;
+        UnitsOnFreeList--;
       }
       else
       {
-        UnitsAllocated++;
-        HeapUnit++;
+        //Out of memory... return a null pointer, and keep everything as is.
+        if(NextUnit == EndOfBlock && !AllocateBlock())
+          return (T*)0;
+        Unit = (void*)NextUnit;
+        NextUnit += SizeOfUnit;
       }
+      UnitsInUse++;
 
-      //Calculate the address of the new unit.
-      uintptr address=((*(uintptr*)&Heaps[HeapsAllocated-1])
-        +SizeOfUnit*HeapUnit);
+#ifdef PRIM_DEBUG_HEAP
+      Memory::Set(Unit, MemSetDefaultValue, SizeOfUnit);
+#endif
 
       //Placement new will call object T's constructor.
-      _endprofile(primProfiles);
-      return new (*(void**)&address) T;
+      return new (Unit) T;
     }
 
-    /**Requests to delete an object allocated with New(). If the pointer is
-    valid then the address will be added to the deletion tree for later
-    reallocation later, or if all the units in the largest heap have been
-    deleted then that heap will collapse automatically. This method calls
-    the object's destructor before destroying the data, just like the
-    'delete' method in C++.*/
+    /**Requests to delete an object allocated with New(). The unit is pushed
+    onto the free list for later reallocation. This method calls the object's
+    destructor before giving up the memory, just like the 'delete' method in
+    C++.*/
     void Delete(T*& ObjectPointer)
     {
-      _profile(primProfiles);
-
-      count HeapIndex=0, UnitIndex=0;
-
       if(ObjectPointer==0)
-      {
-        _endprofile(primProfiles);
         return; //Pointer is null... There's nothing to delete.
-      }
-
-      FindIndexLocationFromPointer((void*) ObjectPointer,
-        HeapIndex, UnitIndex);
-      if(HeapIndex<0)
-      {
-        //The heap could not be found, so null the pointer anyway and
-        //get out of here.
-        ObjectPointer=0;
-        _endprofile(primProfiles);
-        return;
-      }
 
       /*This will call the object's destructor. Weird, but it works since the
       destructor is public.*/
       ObjectPointer->~T();
 
+#ifdef PRIM_DEBUG_HEAP
       //Erase the memory to the default value.
       Memory::Set((void*)ObjectPointer, MemSetDefaultValue, SizeOfUnit);
+#endif
 
-      //Embed a deletion tree node in the memory of the old data unit.
-      *(void**)ObjectPointer=DeletionTreeRoot[HeapIndex];
-      DeletionTreeRoot[HeapIndex]=(void*)ObjectPointer;
-      DeletionCountPerHeap[HeapIndex]++;
+      //Embed a free list node in the memory of the old data unit.
+      *(void**)ObjectPointer = FreeList;
+      FreeList = (void*)ObjectPointer;
+      UnitsOnFreeList++;
+      UnitsInUse--;
       ObjectPointer=(T*)0;
-      for(count i=HeapsAllocated-1;i>=0;i--)
-      {
-        //Go through each heap starting from the largest and determine
-        //if they can be collapsed.
-        if(DeletionCountPerHeap[i]==((count)1 << i) ||
-          (i==HeapsAllocated-1 &&
-          DeletionCountPerHeap[i]==HeapUnit+1))
-        {
-          DeletionCountPerHeap[i]=0;
-          DeletionTreeRoot[i]=0;
-          delete [] (int8*)(Heaps[i]);
-          Heaps[i]=0;
-
-          /*Don't ask... (basically, UnitsAllocated isn't the total
-          number. It's only the rightmost unit in the heap set, so
-          once the heap deflates, it needs to basically become the
-          last element of the heap before...)*/
-
-          //= 2 ^ i
-          HeapThreshold = ((count)1 << i);
-
-          //(2 ^ i) - 1
-          UnitsAllocated = ((count)1 << i) - (count)1;
-
-          //= (2 ^ (i-1)) - 1
-          HeapUnit = ((count)1 << (i-1)) - (count)1;
-
-          HeapsAllocated--;
-        }
-        else
-        {
-          _endprofile(primProfiles);
-          return;
-        }
-      }
-      _endprofile(primProfiles);
     }
 
-    /**Deletes all units, effectively clearing out all heaps and all memory.
+    /**Deletes all units, effectively clearing out all blocks and all memory.
     No destructors are called, so make sure that you use this method in the
     appropriate context, for example, deleting a list of things. This method
     is very fast, as it only needs to call the C++ 'delete' operator the
     base-two log of the number of units. This method is called
-    automatically, if Heap goes out of scope or is destroyed.*/
+    automatically, if Heap goes out of scope or is destroyed. It must not be
+    called on a heap returned by ForCurrentThread().*/
     void DeleteAllWithoutDestructor(void)
     {
-      _profile(primProfiles);
-      //Hopefully HeapsAllocated isn't corrupted, but just in case...
-      if(HeapsAllocated>0 && HeapsAllocated<BinaryHeapMaximum)
+      while(Blocks)
       {
-        for(count i=0;i<HeapsAllocated;i++)
-        {
-          delete [] (int8*) Heaps[i];
-        }
+        void* Previous = *(void**)Blocks;
+        delete [] (int8*)Blocks;
+        Blocks = Previous;
       }
-
       Initialize();
-      _endprofile(primProfiles);
     }
 
     ///Gets the number of units allocated by New().
     count Size(void) const
     {
-      return UnitsAllocated-DeletionTreeSize();
+      return UnitsInUse;
     }
   };
 }
@@ -82,13 +82,23 @@ namespace prim
     /**A static memory heap used for all the elements of same-typed lists. This
     will not work in a multi-threaded environment, since there are no safeguards
     prevent multiple threads from accessing the static heap at the same time.*/
-    static Heap< DoubleLink<T> > LinkHeap;
+    static Heap< DoubleLink<T> > StaticLinkHeap;
+
+    ///Returns the static heap of links.
+    static Heap< DoubleLink<T> >& LinkHeap(void)
+    {
+      return StaticLinkHeap;
+    }
 #else
-    /**A memory heap used for all the elements of same-typed lists. Since this
-    is declared as a single object within each list, it will be thread-safe
-    (assuming that any List objects that are shared across multiple threads use
-    the appropriate safeguards).*/
-    Heap< DoubleLink<T> > LinkHeap;
+    /**Returns the heap of links belonging to the calling thread. All lists of
+    the same type on a thread share it, so links are recycled between lists
+    without any locking. A list may still be handed from one thread to another
+    (using the appropriate safeguards) since links can be deleted by a
+    different thread than the one which created them.*/
+    static Heap< DoubleLink<T> >& LinkHeap(void)
+    {
+      return Heap< DoubleLink<T> >::ForCurrentThread();
+    }
 #endif
 
   protected:
@@ -329,10 +339,11 @@ namespace prim
       _profile(primProfiles);
       //Traverse the list and delete all of the elements
       DoubleLink<T>* Current = First;
+      Heap< DoubleLink<T> >& Links = LinkHeap();
       for(count i=0;i<Items;i++)
       {
         DoubleLink<T>* Next = Current->Next;
-        LinkHeap.Delete(Current);
+        Links.Delete(Current);
         Current = Next;
       }
       _endprofile(primProfiles);
@@ -404,7 +415,7 @@ namespace prim
     void Append(const T& newElement)
     {
       _profile(primProfiles);
-      DoubleLink<T>* NewLink = LinkHeap.New();
+      DoubleLink<T>* NewLink = LinkHeap().New();
       if(!Items)
         Last=First=NewLink;
       else
@@ -429,7 +440,7 @@ namespace prim
       //Append(newElement);
 
       //New code:
-      DoubleLink<T>* NewLink = LinkHeap.New();
+      DoubleLink<T>* NewLink = LinkHeap().New();
       if(!Items)
         Last=First=NewLink;
       else
@@ -447,7 +458,7 @@ namespace prim
     void Prepend(const T& newElement)
     {
       _profile(primProfiles);
-      DoubleLink<T>* NewLink = LinkHeap.New();
+      DoubleLink<T>* NewLink = LinkHeap().New();
       if(!Items)
         Last=First=NewLink;
       else
@@ -489,7 +500,7 @@ namespace prim
       //Determine the correct links to squeeze the new element between.
       DoubleLink<T>* LeftLink = LastReferenced->Prev;
       DoubleLink<T>* RightLink = LastReferenced;
-      DoubleLink<T>* NewLink = LinkHeap.New();
+      DoubleLink<T>* NewLink = LinkHeap().New();
 
       //Update the link pointers.
       RightLink->Prev = LeftLink->Next = NewLink;
@@ -532,7 +543,7 @@ namespace prim
       //Determine the correct links to squeeze the new element between.
       DoubleLink<T>* LeftLink = LastReferenced;
       DoubleLink<T>* RightLink = LastReferenced->Next;
-      DoubleLink<T>* NewLink = LinkHeap.New();
+      DoubleLink<T>* NewLink = LinkHeap().New();
 
       //Update the link pointers
       RightLink->Prev = LeftLink->Next = NewLink;
@@ -582,7 +593,7 @@ namespace prim
           RightLink->Prev=LeftLink;
       }
 
-      LinkHeap.Delete(LastReferenced);
+      LinkHeap().Delete(LastReferenced);
 
       Items--;
 
@@ -648,6 +659,17 @@ namespace prim
         Add() = other[i];
     }
 
+    /**Move constructor takes the links of a temporary list without copying
+    any of its elements.*/
+    List<T>(List<T>&& other) : First(other.First), Last(other.Last),
+      LastReferenced(other.LastReferenced),
+      LastReferencedIndex(other.LastReferencedIndex), Items(other.Items)
+    {
+      other.First = other.Last = other.LastReferenced = 0;
+      other.LastReferencedIndex = 0;
+      other.Items = 0;
+    }
+
     List<T>& operator=(const List<T>& other)
     {
       if(&other == this)
@@ -880,7 +902,7 @@ namespace prim
   /*Instantiate the static heap of links. This allows multiple list objects of
   the same storage type to access a single garbage-collected pool of memory. You
   can only use this though if only a single thread uses the List object.*/
-  template <class T> Heap< DoubleLink<T> > List<T>::LinkHeap;
+  template <class T> Heap< DoubleLink<T> > List<T>::StaticLinkHeap;
 #endif
 }
 #endif
@@ -155,6 +155,16 @@ namespace math
   count Roots(number a, number b, number c,
     number& Root1, number& Root2);
 
+  /**\brief Returns the real zeroes to a cubic equation given the
+  coefficients. \details The roots are found in closed form (Cardano's method
+  with the trigonometric form for three real roots), computed in double
+  precision and polished with Newton's method. They are given in ascending
+  order with unused roots set to zero. If the leading coefficients are zero,
+  the equation is solved as a quadratic or a line. The return value contains
+  the number of roots.*/
+  count Roots(number a, number b, number c, number d,
+    number& Root1, number& Root2, number& Root3);
+
 
   //--------//
   //Swapping//
@@ -327,5 +337,16 @@ namespace meta
     static const uint64 Value = PowerOfTwo<(uint64)sizeof(T) * (uint64)8 -
       (uint64)1>::Value;
   };
+
+  /**Determines whether a type can be copied and destroyed as raw bytes. For
+  example, IsTriviallyCopyable<Vector>::Value is true whereas
+  IsTriviallyCopyable<String>::Value is false. The compiler intrinsic is used
+  since it is available on every supported compiler without including the
+  C++ standard library.*/
+  template <class T>
+  struct IsTriviallyCopyable
+  {
+    static const bool Value = __is_trivially_copyable(T);
+  };
 }}}
 #endif
@@ -29,6 +29,7 @@
 #ifndef primMemory
 #define primMemory
 
+#include "primMath.h"
 #include "primTypes.h"
 
 /*Normally, we would include memory.h, however doing so introduces the entire
@@ -90,6 +91,61 @@ namespace prim
     {
       return new (Object) Type;
     }
+
+    /**Value-initializes an array of objects in uninitialized memory. Plain
+    types are zeroed and classes have their default constructors called, so
+    the memory does not need to be cleared beforehand.*/
+    template <class Type>
+    static void ConstructArray(Type* Objects, count Items)
+    {
+      for(count i = 0; i < Items; i++)
+        new (&Objects[i]) Type();
+    }
+
+    ///Calls the destructors of an array of objects without freeing them.
+    template <class Type>
+    static void DestructArray(Type* Objects, count Items)
+    {
+      if(math::meta::IsTriviallyCopyable<Type>::Value)
+        return;
+      for(count i = 0; i < Items; i++)
+        Objects[i].~Type();
+    }
+
+    /**Copy-constructs an array of objects into uninitialized memory. Trivially
+    copyable types are copied with a single memory copy.*/
+    template <class Type>
+    static void CopyConstructArray(Type* Destination, const Type* Source,
+      count Items)
+    {
+      if(math::meta::IsTriviallyCopyable<Type>::Value)
+        CopyArray(Destination, Source, Items);
+      else
+      {
+        for(count i = 0; i < Items; i++)
+          new (&Destination[i]) Type(Source[i]);
+      }
+    }
+
+    /**Moves an array of objects into uninitialized memory and destroys the
+    originals. Trivially copyable types are moved with a single memory copy,
+    and all other types are move-constructed (or copy-constructed if they have
+    no move constructor) so that objects which are not safe to relocate byte
+    by byte remain valid.*/
+    template <class Type>
+    static void RelocateArray(Type* Destination, Type* Source, count Items)
+    {
+      if(math::meta::IsTriviallyCopyable<Type>::Value)
+        CopyArray(Destination, Source, Items);
+      else
+      {
+        for(count i = 0; i < Items; i++)
+        {
+          new (&Destination[i]) Type(static_cast<Type&&>(Source[i]));
+          Source[i].~Type();
+        }
+      }
+    }
   };
 }
 
@@ -29,6 +29,8 @@
 #ifndef primOS
 #define primOS
 
+#include "primTypes.h"
+
 namespace prim
 {
   /**Determines basic information about the current operating system. The prim
@@ -51,6 +53,30 @@ namespace prim
     ///Returns true if operating is some variant of BSD.
     static bool BSD(void);
   };
+
+  /**Runs the iterations of a loop on several threads at once. The iterations
+  are handed out one at a time from a shared counter, so uneven iterations
+  still balance across the threads. The calling thread takes part in the work,
+  and the call returns once every iteration has finished. The other threads
+  come from a pool started on the first call and kept for the life of the
+  process; a loop started while another is running (for example, from inside
+  a loop body) runs on its calling thread alone. The loop body must not depend
+  on the order of the iterations. With PRIM_USING_SINGLE_THREADED
+  defined, the iterations simply run in order on the calling thread.*/
+  struct Parallel
+  {
+    ///The body of a loop given the iteration index and a caller context.
+    typedef void (*Body)(count Index, void* Context);
+
+    ///Returns the number of processors available to run threads.
+    static count Processors(void);
+
+    /**Calls the function for each index from zero up to the number of
+    iterations. If the maximum number of threads is zero, one thread is used
+    for each processor.*/
+    static void For(count Iterations, Body Function, void* Context,
+      count MaximumThreads = 0);
+  };
 }
 
 #endif
@@ -30,6 +30,7 @@
 #define primPath
 
 #include "primList.h"
+#include "primOS.h"
 #include "primVector.h"
 #include "primRectangle.h"
 #include "primTransform.h"
@@ -42,22 +43,12 @@ namespace prim { namespace math
   struct Polygon : public Array<Vector>
   {
   private:
-    struct RadialSortingVector : public Vector
+    ///Vector which sorts by x and then by y.
+    struct LexicographicVector : public Vector
     {
-      number theta;
-      bool operator < (const RadialSortingVector& Other) const
+      bool operator < (const LexicographicVector& Other) const
       {
-        return theta < Other.theta;
-      }
-
-      bool operator > (const RadialSortingVector& Other) const
-      {
-        return theta > Other.theta;
-      }
-
-      bool operator == (const RadialSortingVector& Other) const
-      {
-        return theta == Other.theta;
+        return x < Other.x || (x == Other.x && y < Other.y);
       }
     };
 
@@ -118,28 +109,99 @@ namespace prim { namespace math
       return false;
     }
 
+    ///Sums two doubles into a rounded sum and its exact rounding error.
+    static inline void TwoSum(double a, double b, double& Sum, double& Error)
+    {
+      Sum = a + b;
+      double bVirtual = Sum - a, aVirtual = Sum - bVirtual;
+      Error = (a - aVirtual) + (b - bVirtual);
+    }
+
+    ///Multiplies two doubles into a rounded product and its exact error.
+    static inline void TwoProduct(double a, double b, double& Product,
+      double& Error)
+    {
+      //Split each factor into two halves of 26 bits (Veltkamp's splitting).
+      const double Splitter = 134217729.0; //2^27 + 1
+      double c = Splitter * a, aHigh = c - (c - a), aLow = a - aHigh;
+      c = Splitter * b;
+      double bHigh = c - (c - b), bLow = b - bHigh;
+      Product = a * b;
+      Error = aLow * bLow - (((Product - aHigh * bHigh) - aLow * bHigh) -
+        aHigh * bLow);
+    }
+
     /**Determines the order of three points. The result can be as clockwise (1),
-    counterclockwise (-1), or collinear (0).*/
+    counterclockwise (-1), or collinear (0). The cross product is first
+    evaluated in double precision, and the sign is taken from that whenever it
+    is larger than the bound on its rounding error (Shewchuk's adaptive
+    orientation test). Otherwise the differences and products are expanded
+    into exact sums of doubles, so the sign is exact for both float and double
+    coordinates, barring overflow and underflow.*/
     static inline count DeterminePointOrder(Vector p0, Vector p1, Vector p2)
     {
-      number p1x_p0x = p1.x - p0.x;
-      number p2x_p0x = p2.x - p0.x;
-      number p1y_p0y = p1.y - p0.y;
-      number p2y_p0y = p2.y - p0.y;
-
-      number Left  = p2y_p0y * p1x_p0x;
-      number Right = p1y_p0y * p2x_p0x;
-      
-      if(Left < Right)
+      double Left  = ((double)p2.y - (double)p0.y) *
+        ((double)p1.x - (double)p0.x);
+      double Right = ((double)p1.y - (double)p0.y) *
+        ((double)p2.x - (double)p0.x);
+
+      //Error bound (3 + 16e)e on the computed determinant, with e = 2^-53.
+      const double ErrorBound = 3.3306690738754716e-16;
+      double Determinant = Left - Right;
+      double Magnitude = (Left < 0 ? -Left : Left) +
+        (Right < 0 ? -Right : Right);
+      if(Determinant > ErrorBound * Magnitude)
+        return -1;
+      else if(-Determinant > ErrorBound * Magnitude)
         return 1;
-      else if(Left == Right)
+      else if(Magnitude == 0)
         return 0;
-      else
-        return -1;
+
+      //Each difference is exactly the sum of two doubles.
+      double a[2], b[2], c[2], d[2];
+      TwoSum((double)p2.y, -(double)p0.y, a[1], a[0]);
+      TwoSum((double)p1.x, -(double)p0.x, b[1], b[0]);
+      TwoSum((double)p1.y, -(double)p0.y, c[1], c[0]);
+      TwoSum((double)p2.x, -(double)p0.x, d[1], d[0]);
+
+      /*Accumulate a * b - c * d term by term into a nonoverlapping expansion
+      whose components increase in magnitude (Shewchuk's Grow-Expansion).*/
+      double Expansion[17];
+      count Components = 0;
+      for(count i = 0; i < 2; i++)
+      {
+        for(count j = 0; j < 2; j++)
+        {
+          double Terms[4];
+          TwoProduct(a[i], b[j], Terms[0], Terms[1]);
+          TwoProduct(-c[i], d[j], Terms[2], Terms[3]);
+          for(count k = 0; k < 4; k++)
+          {
+            double q = Terms[k];
+            for(count m = 0; m < Components; m++)
+              TwoSum(q, Expansion[m], q, Expansion[m]);
+            Expansion[Components++] = q;
+          }
+        }
+      }
+
+      //The sign of the expansion is the sign of its largest component.
+      for(count i = Components - 1; i >= 0; i--)
+      {
+        if(Expansion[i] > 0)
+          return -1;
+        else if(Expansion[i] < 0)
+          return 1;
+      }
+      return 0;
     }
 
     /**Creates a new polygon consisting of the convex hull of this polygon. The
-    algorithm employed is the "three-penny" convex hull finder.*/
+    algorithm employed is Andrew's monotone chain: the points are sorted by x
+    and then y, and the lower and upper chains are each built in one pass by
+    discarding points that do not make a counterclockwise turn. The hull is
+    given counterclockwise from the lowest of the left-most points, without
+    repeating the first point and without collinear points.*/
     void CreateConvexHull(Polygon& NewPolygon) const
     {
       //Make sure there are at least three points to work with.
@@ -152,85 +214,42 @@ namespace prim { namespace math
         return;
       }
 
-      //Copy polygon array into temporary list.
-      List<RadialSortingVector> L;
-      {
-        //First find left-most point.
-        count this_n = n();
-        count LeftMostIndex = 0;
-        number LeftMostX = GetItemValue(0).x;
-        for(count i = 1; i < this_n; i++)
-        {
-          number CurrentX = GetItemValue(i).x;
-          if(CurrentX < LeftMostX)
-          {
-            LeftMostIndex = i;
-            LeftMostX = CurrentX;
-          }
-        }
-        
-        /*Now add the points with the left-most point first. This guarantees
-        that the first three points in the list will be convex.*/
-        for(count i = LeftMostIndex; i < this_n; i++)
-          static_cast<Vector&>(L.Add()) = GetItemValue(i);
-        for(count i = 1; i <= LeftMostIndex; i++)
-          static_cast<Vector&>(L.Add()) = GetItemValue(i);
-
-        ///Determine the beginning point order.
-        Vector L_0 = L[0];
-        while(DeterminePointOrder(L_0, L[1], L[2]) == 0)
-          L.Remove(1);
-
-        //Determine the angles of the points so that they can be sorted.
-        RadialSortingVector v = L[0];
-        count L_n_1 = L.n() - 1;
-        for(count i = 1; i < L_n_1; i++)
-        {
-          number theta = v.Ang(L[i]);
-          if(theta > Pi)
-            theta -= TwoPi;
-          L[i].theta = theta;
-        }
+      //Copy the points into a sortable array.
+      count this_n = n();
+      Array<LexicographicVector> Sorted(this_n);
+      for(count i = 0; i < this_n; i++)
+        static_cast<Vector&>(Sorted[i]) = GetConstItem(i);
+      Sorted.Sort();
 
-        //Force the first point to be first in the list after the sort.
-        L[0].theta = -Pi;
+      //The hull has at most one more point than the input during construction.
+      NewPolygon.Clear();
+      NewPolygon.n(this_n + 1);
+      count k = 0;
 
-        //Force the last point to be last in the list after the sort.
-        L[L_n_1].theta = Pi;
-
-        //Sort the vector list radially.
-        L.QuickSort();
-      }
-
-      //Using the "three-penny" convex hull algorithm.
-      for(count i = 0; i < L.n() - 2; i++)
+      //Lower chain from left to right
+      for(count i = 0; i < this_n; i++)
       {
-        Vector p0 = L[i], p1 = L[i + 1], p2 = L[i + 2];
-        if(DeterminePointOrder(p0, p1, p2) != -1)
-        {
-          L.Remove(i + 1);
-          i -= 2;
-        }
+        const Vector& p = Sorted[i];
+        while(k >= 2 && DeterminePointOrder(NewPolygon[k - 2],
+          NewPolygon[k - 1], p) != -1)
+            k--;
+        NewPolygon[k++] = p;
       }
 
-      //Copy results into new polygon.
+      //Upper chain from right to left
+      count LowerChain_n = k + 1;
+      for(count i = this_n - 2; i >= 0; i--)
       {
-        Rectangle& B = NewPolygon.BoundingBox;
-        NewPolygon.Clear();
-
-        Vector L_first = L.first();
-        NewPolygon.n(L.n());
-        NewPolygon[0] = L_first;
-        B = Rectangle(L_first);
-
-        count L_n = L.n();
-        for(count i = 1; i < L_n; i++)
-        {
-          Vector v = L[i];
-          NewPolygon[i] = v;
-          B = B + v;
-        }
+        const Vector& p = Sorted[i];
+        while(k >= LowerChain_n && DeterminePointOrder(NewPolygon[k - 2],
+          NewPolygon[k - 1], p) != -1)
+            k--;
+        NewPolygon[k++] = p;
       }
+
+      //The last point is the first point again.
+      NewPolygon.n(Max(k - 1, (count)1));
+      NewPolygon.UpdateBoundingBox();
     }
   };
 
@@ -268,14 +287,38 @@ namespace prim { namespace math
       return false;
     }
 
-    ///Create a set of convex hulls for each of the component polygons.
+    ///Moves every polygon and its bounding box.
+    void Translate(Vector Displacement)
+    {
+      for(count i = Components.n() - 1; i >= 0; i--)
+      {
+        Polygon& p = Components[i];
+        for(count j = p.n() - 1; j >= 0; j--)
+          p[j] += Displacement;
+        p.BoundingBox.a += Displacement;
+        p.BoundingBox.b += Displacement;
+      }
+    }
+
+    /**Create a set of convex hulls for each of the component polygons. Paths
+    with many points spread across several components have their hulls built
+    on several threads (see Parallel::For()).*/
     void CreateConvexHull(PolygonPath& NewPolygonPath) const
     {
-      NewPolygonPath.Components.n(0);
       count Components_n = Components.n();
-      for(count i = 0; i < Components_n; i++)
-        Components.GetConstItem(i).CreateConvexHull(
-          NewPolygonPath.Components.AddOne());
+      NewPolygonPath.Components.n(0);
+      NewPolygonPath.Components.n(Components_n);
+
+      count Points_n = 0;
+      for(count i = Components_n - 1; i >= 0; i--)
+        Points_n += Components.GetConstItem(i).n();
+
+      HullJob Job = {this, &NewPolygonPath};
+      if(Components_n > 1 && Points_n >= MinimumPointsForParallelHulls)
+        Parallel::For(Components_n, CreateConvexHullOfComponent, &Job);
+      else
+        for(count i = 0; i < Components_n; i++)
+          CreateConvexHullOfComponent(i, &Job);
     }
 
     ///Count the total number of line segments in the polygon path.
@@ -288,6 +331,305 @@ namespace prim { namespace math
       Result -= Components_n;
       return Result;
     }
+
+  private:
+    /**Number of points below which the hulls are built on the calling thread,
+    since starting threads costs more than building small hulls.*/
+    static const count MinimumPointsForParallelHulls = 8192;
+
+    ///Source and destination of a hull computation shared with the threads
+    struct HullJob
+    {
+      const PolygonPath* Source;
+      PolygonPath* Destination;
+    };
+
+    ///Builds the hull of one component for CreateConvexHull().
+    static void CreateConvexHullOfComponent(count Index, void* Context)
+    {
+      HullJob* Job = (HullJob*)Context;
+      Job->Source->Components.GetConstItem(Index).CreateConvexHull(
+        Job->Destination->Components[Index]);
+    }
+  };
+
+  /**A bounding-volume hierarchy over the line segments of a polygon path. The
+  tree is an array of nodes with axis-aligned boxes, in which each leaf owns a
+  short run of the segment array. Intersection queries between two trees only
+  descend into pairs of nodes whose boxes overlap, and point containment only
+  visits the nodes which a horizontal ray from the point could cross, so both
+  run in roughly logarithmic time plus the number of nearby segments.*/
+  struct SegmentTree
+  {
+    ///A node of the tree. Leaves have no children and own segments.
+    struct Node
+    {
+      ///Ordered bounding box of all the segments beneath the node
+      Rectangle Box;
+
+      ///Range of segments owned by a leaf, with the end being exclusive
+      count Start, End;
+
+      ///Indices of the child nodes, or -1 for a leaf
+      count Left, Right;
+    };
+
+    ///Largest number of segments stored in a single leaf
+    static const count LeafSize = 4;
+
+    ///Segments of all the polygons, reordered so each leaf's run is contiguous
+    Array<Line> Segments;
+
+    ///The nodes of the tree with the root at index zero
+    Array<Node> Nodes;
+
+    ///One vertex of each polygon for testing whether outlines are nested
+    Array<Vector> Seeds;
+
+    ///Empties the tree.
+    void Clear(void)
+    {
+      Segments.Clear();
+      Nodes.Clear();
+      Seeds.Clear();
+    }
+
+    ///Builds the tree from the edges of each polygon in the polygon path.
+    void Create(const PolygonPath& Outline)
+    {
+      Clear();
+      count Edges_n = 0;
+      for(count i = Outline.Components.n() - 1; i >= 0; i--)
+        Edges_n += Max(Outline.Components.GetConstItem(i).n() - 1, (count)0);
+      Segments.Reserve(Edges_n);
+      Seeds.Reserve(Outline.Components.n());
+
+      for(count i = 0; i < Outline.Components.n(); i++)
+      {
+        const Polygon& p = Outline.Components.GetConstItem(i);
+        if(!p.n())
+          continue;
+        Seeds.Add(p.GetConstItem(0));
+        for(count j = 1; j < p.n(); j++)
+          Segments.Add(Line(p.GetConstItem(j - 1), p.GetConstItem(j)));
+      }
+
+      if(!Segments.n())
+        return;
+
+      Nodes.Reserve(Segments.n() / LeafSize * 2 + 1);
+      CreateNode(0, Segments.n());
+    }
+
+    ///Returns the bounding box of the whole tree.
+    Rectangle GetBoundingBox(void) const
+    {
+      return Nodes.n() ? Nodes.GetConstItem(0).Box : Rectangle();
+    }
+
+    ///Moves the tree without rebuilding it.
+    void Translate(Vector Displacement)
+    {
+      for(count i = Segments.n() - 1; i >= 0; i--)
+      {
+        Segments[i].a += Displacement;
+        Segments[i].b += Displacement;
+      }
+      for(count i = Nodes.n() - 1; i >= 0; i--)
+      {
+        Nodes[i].Box.a += Displacement;
+        Nodes[i].Box.b += Displacement;
+      }
+      for(count i = Seeds.n() - 1; i >= 0; i--)
+        Seeds[i] += Displacement;
+    }
+
+    /**Determines whether any segment of this tree crosses a segment of the
+    other tree after the other is displaced.*/
+    bool IntersectsSegments(const SegmentTree& Other,
+      Vector OtherDisplacement = Vector(0, 0)) const
+    {
+      if(!Nodes.n() || !Other.Nodes.n())
+        return false;
+      return IntersectsNodes(0, Other, 0, OtherDisplacement);
+    }
+
+    /**Counts the segments crossed by a ray travelling from the point in the
+    positive x direction. The point is inside by the even-odd rule when the
+    count is odd.*/
+    count CountCrossings(Vector p) const
+    {
+      if(!Nodes.n())
+        return 0;
+      return CountCrossingsOfNode(0, p);
+    }
+
+    ///Determines whether the point is inside the outline (even-odd rule).
+    bool IsPointInside(Vector p) const
+    {
+      return (CountCrossings(p) % 2) == 1;
+    }
+
+    /**Determines whether this outline intersects the outline of another,
+    counting one outline lying entirely inside of the other as intersecting.*/
+    bool IntersectsOutline(const SegmentTree& Other,
+      Vector OtherDisplacement = Vector(0, 0)) const
+    {
+      if(!Nodes.n() || !Other.Nodes.n())
+        return false;
+
+      if(!BoxesOverlap(Nodes.GetConstItem(0).Box,
+        Other.Nodes.GetConstItem(0).Box, OtherDisplacement))
+          return false;
+
+      if(IntersectsNodes(0, Other, 0, OtherDisplacement))
+        return true;
+
+      //With no crossings, the outlines can only touch if one is nested.
+      for(count i = Other.Seeds.n() - 1; i >= 0; i--)
+        if(IsPointInside(Other.Seeds.GetConstItem(i) + OtherDisplacement))
+          return true;
+      for(count i = Seeds.n() - 1; i >= 0; i--)
+        if(Other.IsPointInside(Seeds.GetConstItem(i) - OtherDisplacement))
+          return true;
+
+      return false;
+    }
+
+  private:
+    ///Determines whether two ordered boxes overlap after displacing the other.
+    static bool BoxesOverlap(const Rectangle& r, const Rectangle& s,
+      Vector sDisplacement)
+    {
+      return r.a.x <= s.b.x + sDisplacement.x &&
+        s.a.x + sDisplacement.x <= r.b.x &&
+        r.a.y <= s.b.y + sDisplacement.y &&
+        s.a.y + sDisplacement.y <= r.b.y;
+    }
+
+    ///Builds the subtree over a range of segments and returns its index.
+    count CreateNode(count Start, count End)
+    {
+      //Find the bounds of the segments and of their midpoints.
+      const Line& First = Segments.GetConstItem(Start);
+      Vector Low(Min(First.a.x, First.b.x), Min(First.a.y, First.b.y));
+      Vector High(Max(First.a.x, First.b.x), Max(First.a.y, First.b.y));
+      Vector MidLow = (First.a + First.b) * (number)0.5, MidHigh = MidLow;
+      for(count i = Start + 1; i < End; i++)
+      {
+        const Line& l = Segments.GetConstItem(i);
+        Decrease(Low.x, Min(l.a.x, l.b.x));
+        Decrease(Low.y, Min(l.a.y, l.b.y));
+        Increase(High.x, Max(l.a.x, l.b.x));
+        Increase(High.y, Max(l.a.y, l.b.y));
+        Vector Mid = (l.a + l.b) * (number)0.5;
+        Decrease(MidLow.x, Mid.x);
+        Decrease(MidLow.y, Mid.y);
+        Increase(MidHigh.x, Mid.x);
+        Increase(MidHigh.y, Mid.y);
+      }
+
+      count Index = Nodes.n();
+      {
+        Node& n = Nodes.AddOne();
+        n.Box = Rectangle(Low, High);
+        n.Start = Start;
+        n.End = End;
+        n.Left = n.Right = -1;
+      }
+
+      if(End - Start <= LeafSize)
+        return Index;
+
+      /*Split across the wider spread of midpoints at its center. If all the
+      midpoints fall on one side, split the range in half instead.*/
+      bool SplitX = MidHigh.x - MidLow.x >= MidHigh.y - MidLow.y;
+      number Pivot = SplitX ? (MidLow.x + MidHigh.x) * (number)0.5 :
+        (MidLow.y + MidHigh.y) * (number)0.5;
+      count Divide = Start;
+      for(count i = Start; i < End; i++)
+      {
+        const Line& l = Segments.GetConstItem(i);
+        number Mid = SplitX ? (l.a.x + l.b.x) * (number)0.5 :
+          (l.a.y + l.b.y) * (number)0.5;
+        if(Mid < Pivot)
+        {
+          Swap(Segments[i], Segments[Divide]);
+          Divide++;
+        }
+      }
+      if(Divide == Start || Divide == End)
+        Divide = (Start + End) / 2;
+
+      //Nodes may move while children are added, so store by index.
+      count Left = CreateNode(Start, Divide);
+      count Right = CreateNode(Divide, End);
+      Nodes[Index].Left = Left;
+      Nodes[Index].Right = Right;
+      return Index;
+    }
+
+    ///Tests a pair of subtrees for crossing segments.
+    bool IntersectsNodes(count i, const SegmentTree& Other, count j,
+      Vector OtherDisplacement) const
+    {
+      const Node& p = Nodes.GetConstItem(i);
+      const Node& q = Other.Nodes.GetConstItem(j);
+      if(!BoxesOverlap(p.Box, q.Box, OtherDisplacement))
+        return false;
+
+      bool pIsLeaf = p.Left < 0, qIsLeaf = q.Left < 0;
+      if(pIsLeaf && qIsLeaf)
+      {
+        for(count a = p.Start; a < p.End; a++)
+        {
+          const Line& P = Segments.GetConstItem(a);
+          for(count b = q.Start; b < q.End; b++)
+          {
+            const Line& q_b = Other.Segments.GetConstItem(b);
+            Line Q(q_b.a + OtherDisplacement, q_b.b + OtherDisplacement);
+            if(P.Intersects(Q))
+              return true;
+          }
+        }
+        return false;
+      }
+
+      //Descend into the larger of the two nodes first.
+      if(qIsLeaf || (!pIsLeaf && p.Box.Area() >= q.Box.Area()))
+          return IntersectsNodes(p.Left, Other, j, OtherDisplacement) ||
+            IntersectsNodes(p.Right, Other, j, OtherDisplacement);
+      else
+        return IntersectsNodes(i, Other, q.Left, OtherDisplacement) ||
+          IntersectsNodes(i, Other, q.Right, OtherDisplacement);
+    }
+
+    ///Counts the crossings of a ray in the positive x direction in a subtree.
+    count CountCrossingsOfNode(count i, Vector p) const
+    {
+      const Node& n = Nodes.GetConstItem(i);
+      if(p.y < n.Box.a.y || p.y > n.Box.b.y || p.x > n.Box.b.x)
+        return 0;
+
+      if(n.Left >= 0)
+        return CountCrossingsOfNode(n.Left, p) +
+          CountCrossingsOfNode(n.Right, p);
+
+      count Crossings = 0;
+      for(count j = n.Start; j < n.End; j++)
+      {
+        const Line& l = Segments.GetConstItem(j);
+
+        //Half-open in y so that a shared vertex is only counted once.
+        if((l.a.y > p.y) != (l.b.y > p.y))
+        {
+          number x = l.a.x + (p.y - l.a.y) * (l.b.x - l.a.x) / (l.b.y - l.a.y);
+          if(x > p.x)
+            Crossings++;
+        }
+      }
+      return Crossings;
+    }
   };
 }}
 
@@ -533,11 +875,80 @@ namespace prim
     speed up the drawing of canvases that have many of the same shape.*/
     Array<math::AffineMatrix> Contexts;
     
+  private:
+    ///Convex hulls of the components, built on demand by GetConvexHulls()
+    mutable math::PolygonPath CachedConvexHulls;
+    
+    ///Whether the cached convex hulls reflect the current path data
+    mutable bool ConvexHullsAreValid;
+    
+    ///Flattened outline, built on demand by GetFlattenedOutline()
+    mutable math::PolygonPath CachedOutline;
+    
+    ///Tolerance to which the cached outline was flattened
+    mutable number CachedOutlineTolerance;
+    
+    ///Whether the cached outline reflects the current path data
+    mutable bool OutlineIsValid;
+    
+    ///Segment hierarchy of the outline, built on demand by GetSegmentTree()
+    mutable math::SegmentTree CachedSegmentTree;
+    
+    ///Whether the cached segment tree reflects the current path data
+    mutable bool SegmentTreeIsValid;
+    
   public:
+    ///Creates an empty path.
+    Path() : ConvexHullsAreValid(false), CachedOutlineTolerance(0),
+      OutlineIsValid(false), SegmentTreeIsValid(false) {}
+    
+    /**The distance by which flattened curves may stray from the true curves
+    in the cached outline, convex hulls and segment tree.*/
+    static number DefaultFlatteningTolerance(void)
+    {
+      return (number)0.001;
+    }
+    
+    /**Discards the cached geometry derived from the path data. The path methods
+    do this automatically, so this is only needed if Components or their curves
+    are edited directly after the cache has been used.*/
+    void InvalidateCache(void)
+    {
+      ConvexHullsAreValid = false;
+      OutlineIsValid = false;
+      SegmentTreeIsValid = false;
+    }
+    
+    /**Returns the convex hulls of each component's flattened outline. The
+    hulls are computed once and cached until the path changes.*/
+    const math::PolygonPath& GetConvexHulls(void) const
+    {
+      if(!ConvexHullsAreValid)
+      {
+        GetFlattenedOutline().CreateConvexHull(CachedConvexHulls);
+        ConvexHullsAreValid = true;
+      }
+      return CachedConvexHulls;
+    }
+    
+    /**Returns a bounding-volume hierarchy over the line segments of the
+    flattened outline. The tree is computed once and cached until the path
+    changes.*/
+    const math::SegmentTree& GetSegmentTree(void) const
+    {
+      if(!SegmentTreeIsValid)
+      {
+        CachedSegmentTree.Create(GetFlattenedOutline());
+        SegmentTreeIsValid = true;
+      }
+      return CachedSegmentTree;
+    }
+    
     ///Empties the path of all its components.
     void Clear(void)
     {
       Components.Clear();
+      InvalidateCache();
     }
 
     ///Adds a component to the path and sets its starting point.
@@ -545,6 +956,7 @@ namespace prim
     {
       Components.AddOne().AddCurve(Start);
       Components.last().BoundingBox = math::Rectangle(Start);
+      InvalidateCache();
     }
 
     /**Adds a component to the path without setting its starting point. Use the
@@ -552,6 +964,7 @@ namespace prim
     void AddComponent(void)
     {
       Components.AddOne();
+      InvalidateCache();
     }
 
     /**Adds a line to the last component of the path. This method also returns
@@ -563,6 +976,7 @@ namespace prim
       Path::Component& Component = Components.last();
 
       Component.AddCurve(NextPoint);
+      InvalidateCache();
 
       count Lines = Component.Curves.n();
       if(Lines <= 1)
@@ -579,6 +993,7 @@ namespace prim
     void AddCurve(math::Vector NextPoint)
     {
       Components.last().AddCurve(NextPoint);
+      InvalidateCache();
     }
     
     /**Adds a curve to the last component of the path. Make sure to add a
@@ -586,6 +1001,7 @@ namespace prim
     void AddCurve(math::Vector Control, math::Vector End)
     {
       Components.last().AddCurve(Control, End);
+      InvalidateCache();
     }
 
     /**Adds a cubic curve to the last component of the path. Make sure to add a
@@ -594,6 +1010,7 @@ namespace prim
       math::Vector End)
     {
       Components.last().AddCurve(StartControl, EndControl, End);
+      InvalidateCache();
     }
 
     /**Adds a cubic Bezier curve directly to this path. It discards the starting
@@ -615,6 +1032,7 @@ namespace prim
       using namespace prim::math;
 
       Path::Component& Component = Components.last();
+      InvalidateCache();
 
       Vector Scale(Radius * 2.0f, Radius * 2.0f);
 
@@ -768,9 +1186,12 @@ namespace prim
         return math::Rectangle();
     }
 
-    ///Returns the polygon path in line segments from the control points.
+    /**Returns the polygon path in line segments by flattening each curve to
+    the given tolerance (see math::Bezier::Flatten()). For repeated queries
+    use GetFlattenedOutline() which caches the result.*/
     void GetPolygonPathOutline(math::PolygonPath& pp,
-      math::Vector Translation = math::Vector(0, 0)) const
+      math::Vector Translation = math::Vector(0, 0),
+      number Tolerance = DefaultFlatteningTolerance()) const
     {
       _profile(primProfiles);
 
@@ -778,26 +1199,35 @@ namespace prim
 
       pp.Components.n(0);
       count Components_n = Components.n();
+      pp.Components.Reserve(Components_n);
       for(count i = 0; i < Components_n; i++)
       {
         Polygon& p = pp.Components.AddOne();
         Component& c = Components[i];
         Array<Curve>& c_Curves = c.Curves;
         count c_Curves_n = c_Curves.n();
-        for(count j = 0; j < c_Curves_n; j++)
+        if(!c_Curves_n)
+          continue;
+
+        p.Add(c_Curves[0].End + Translation);
+        for(count j = 1; j < c_Curves_n; j++)
         {
           Curve& c_Curves_j = c_Curves[j];
 
           if(c_Curves_j.IsCurve)
           {
-            p.AddOne() = c_Curves_j.StartControl + Translation;
-            p.AddOne() = c_Curves_j.EndControl + Translation;
+            Bezier b;
+            b.SetControlPoints(p.last(), c_Curves_j.StartControl + Translation,
+              c_Curves_j.EndControl + Translation,
+              c_Curves_j.End + Translation);
+            b.Flatten(p, Tolerance, false);
           }
-          p.AddOne() = c_Curves_j.End + Translation;
+          else
+            p.Add(c_Curves_j.End + Translation);
         }
         
         if(p[0] != p.last())
-          p.AddOne() = p[0];
+          p.Add(p[0]);
 
         c.UpdateBoundingBox();
         p.BoundingBox.a = c.BoundingBox.a + Translation;
@@ -806,29 +1236,62 @@ namespace prim
       _endprofile(primProfiles);
     }
 
-    ///Determines if this path intersects the outline of another.
+    /**Returns the outline flattened to the given tolerance. The outline is
+    computed once and cached until the path changes or a different tolerance
+    is requested. The convex hulls and the segment tree are derived from the
+    outline at the default tolerance, so the curves are flattened only once
+    for all of the collision queries.*/
+    const math::PolygonPath& GetFlattenedOutline(
+      number Tolerance = DefaultFlatteningTolerance()) const
+    {
+      if(!OutlineIsValid || CachedOutlineTolerance != Tolerance)
+      {
+        GetPolygonPathOutline(CachedOutline, math::Vector(0, 0), Tolerance);
+        CachedOutlineTolerance = Tolerance;
+        OutlineIsValid = true;
+      }
+      return CachedOutline;
+    }
+
+    /**Determines if this path intersects the outline of another. A path lying
+    entirely inside the other also counts as intersecting. The query uses the
+    cached segment trees of both paths.*/
     bool IntersectsOutline(const Path& Other,
       math::Vector OtherDisplacement = math::Vector(0, 0)) const
     {
       _profile(primProfiles);
-      count Components_n = Components.n();
-      count Other_Components_n = Other.Components.n();
-      for(count i = 0; i < Components_n; i++)
-      {
-        const Component& c1 = Components.GetConstItem(i);
-        for(count j = 0; j < Other_Components_n; j++)
-        {
-          const Component& c2 = Other.Components.GetConstItem(j);
+      bool Result = GetSegmentTree().IntersectsOutline(Other.GetSegmentTree(),
+        OtherDisplacement);
+      _endprofile(primProfiles);
+      return Result;
+    }
 
-          if(c1.IntersectsOutline(c2, OtherDisplacement))
-          {
-            _endprofile(primProfiles);
-            return true;
-          }
-        }
+    /**Tests the outline of this path against the outlines of many others at
+    once. Each other path is displaced by the displacement of the same index,
+    or not at all if there are fewer displacements than paths. The results are
+    written in the same order, and the number of intersecting paths is
+    returned. Null paths never intersect.*/
+    count IntersectsOutlines(const Array<const Path*>& Others,
+      const Array<math::Vector>& OtherDisplacements, Array<bool>& Results) const
+    {
+      using namespace prim::math;
+
+      _profile(primProfiles);
+      const SegmentTree& Tree = GetSegmentTree();
+      count Others_n = Others.n(), Intersecting = 0;
+      Results.n(Others_n);
+      for(count i = 0; i < Others_n; i++)
+      {
+        const Path* p = Others.GetConstItem(i);
+        Vector d;
+        if(i < OtherDisplacements.n())
+          d = OtherDisplacements.GetConstItem(i);
+        Results[i] = p && Tree.IntersectsOutline(p->GetSegmentTree(), d);
+        if(Results[i])
+          Intersecting++;
       }
       _endprofile(primProfiles);
-      return false;
+      return Intersecting;
     }
 
     //Operators
@@ -851,6 +1314,14 @@ namespace prim
         Components_i.BoundingBox.a += v;
         Components_i.BoundingBox.b += v;
       }
+      
+      //Translating the cached geometry is cheaper than building it again.
+      if(ConvexHullsAreValid)
+        CachedConvexHulls.Translate(v);
+      if(OutlineIsValid)
+        CachedOutline.Translate(v);
+      if(SegmentTreeIsValid)
+        CachedSegmentTree.Translate(v);
       return *this;
     }
 
@@ -880,6 +1351,7 @@ namespace prim
         Components_i.BoundingBox.a *= k;
         Components_i.BoundingBox.b *= k;
       }
+      InvalidateCache();
       return *this;
     }
   };
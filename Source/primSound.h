@@ -29,11 +29,23 @@
 #ifndef primSound
 #define primSound
 
+#include "primArray.h"
 #include "primEndian.h"
 #include "primFile.h"
+#include "primMath.h"
 #include "primMemory.h"
 #include "primTypes.h"
 
+/*Sample mixing and byte swapping use SSE2 where the compiler targets it. Define
+PRIM_DO_NOT_USE_SSE2 to force the portable code paths.*/
+#ifndef PRIM_DO_NOT_USE_SSE2
+  #if defined (__SSE2__) || defined (_M_X64) || \
+    (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define primSoundUsesSSE2
+    #include <emmintrin.h>
+  #endif
+#endif
+
 namespace prim
 {
   ///A partial representation of the 80-bit floating point format.
@@ -82,6 +94,53 @@ namespace prim
 
 namespace prim { namespace sound
 {
+  ///Clips a 32-bit sum to the range of a 16-bit sample.
+  inline int16 Saturate16Bit(int32 Value)
+  {
+    if(Value > 32767)
+      return 32767;
+    if(Value < -32768)
+      return -32768;
+    return (int16)Value;
+  }
+
+  /**Adds source samples to destination samples. Sums that overflow are clipped
+  to the 16-bit range instead of wrapping around.*/
+  inline void MixSaturating(int16* Destination, const int16* Source,
+    count Samples)
+  {
+    count i = 0;
+#ifdef primSoundUsesSSE2
+    for(; i + 8 <= Samples; i += 8)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)&Destination[i]);
+      __m128i b = _mm_loadu_si128((const __m128i*)&Source[i]);
+      _mm_storeu_si128((__m128i*)&Destination[i], _mm_adds_epi16(a, b));
+    }
+#endif
+    for(; i < Samples; i++)
+      Destination[i] = Saturate16Bit((int32)Destination[i] + (int32)Source[i]);
+  }
+
+  ///Reverses the byte order of each 16-bit sample in place.
+  inline void SwapBytes16Bit(int16* Samples, count SampleCount)
+  {
+    count i = 0;
+#ifdef primSoundUsesSSE2
+    for(; i + 8 <= SampleCount; i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)&Samples[i]);
+      v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+      _mm_storeu_si128((__m128i*)&Samples[i], v);
+    }
+#endif
+    for(; i < SampleCount; i++)
+    {
+      uint16 v = (uint16)Samples[i];
+      Samples[i] = (int16)(uint16)((v << 8) | (v >> 8));
+    }
+  }
+
   ///Represents a 16-bit PCM audio channel.
   class Channel16Bit
   {
@@ -132,11 +191,12 @@ namespace prim { namespace sound
         Samples[i] = Value;
     }
     
-    ///Adds a value to a particular sample's existing value.
+    /**Adds a value to a particular sample's existing value. The sum is clipped
+    to the 16-bit range.*/
     inline void SumToSample(count i, int16 Value)
     {
       if(i >= 0 && i < SampleCount)
-        Samples[i] += Value;
+        Samples[i] = Saturate16Bit((int32)Samples[i] + (int32)Value);
     }
     
     ///Returns the number of samples in this channel.
@@ -146,6 +206,207 @@ namespace prim { namespace sound
     }
   };
   
+  /**Streams 16-bit PCM audio to an AIFF or WAV file block by block. The number
+  of sample frames is given up front so that the header can be written first.
+  Blocks are interleaved into a fixed-size buffer, which is converted to the
+  byte order of the file and appended whenever it fills. Memory use therefore
+  does not depend on the duration.*/
+  class Stream16Bit
+  {
+  public:
+    ///Container format of the stream
+    typedef count Format;
+
+    ///The available container formats
+    struct Formats
+    {
+      ///Audio Interchange File Format (big-endian samples)
+      static const Format AIFF = 0;
+
+      ///RIFF wave file (little-endian samples)
+      static const Format WAV = 1;
+    };
+
+  private:
+    String Filename;
+    Format Type;
+    count ChannelCount;
+    count SampleRate;
+    count SampleCount;
+    count SamplesWritten;
+    count BufferedFrames;
+    Array<int16> Buffer;
+    bool IsOpen;
+
+    ///Number of frames held before the buffer is appended to the file
+    static const count BufferFrames = 1024 * 64;
+
+    ///Stores an integer in a number of bytes in the given byte order.
+    static void PutInteger(uint8* Destination, uint32 Value, count Bytes,
+      bool BigEndian)
+    {
+      for(count i = 0; i < Bytes; i++)
+        Destination[BigEndian ? Bytes - 1 - i : i] =
+          (uint8)(Value >> (uint32)(8 * i));
+    }
+
+    ///Writes the header of the file, replacing any existing file.
+    bool WriteHeader(void)
+    {
+      uint32 DataLength = (uint32)(2 * SampleCount * ChannelCount);
+      if(Type == Formats::WAV)
+      {
+        uint8 Header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+          'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+          0, 0, 16, 0, 'd', 'a', 't', 'a', 0, 0, 0, 0};
+        PutInteger(&Header[4], 36 + DataLength, 4, false);
+        PutInteger(&Header[22], (uint32)ChannelCount, 2, false);
+        PutInteger(&Header[24], (uint32)SampleRate, 4, false);
+        PutInteger(&Header[28], (uint32)(SampleRate * ChannelCount * 2), 4,
+          false);
+        PutInteger(&Header[32], (uint32)(ChannelCount * 2), 2, false);
+        PutInteger(&Header[40], DataLength, 4, false);
+        return File::Write(Filename, &Header[0], 44);
+      }
+
+      uint8 Header[54] = {'F', 'O', 'R', 'M', 0, 0, 0, 0, 'A', 'I', 'F', 'F',
+        'C', 'O', 'M', 'M', 0, 0, 0, 18};
+      PutInteger(&Header[4], 46 + DataLength, 4, true);
+      PutInteger(&Header[20], (uint32)ChannelCount, 2, true);
+      PutInteger(&Header[22], (uint32)SampleCount, 4, true);
+      PutInteger(&Header[26], 16, 2, true);
+      float80 Rate; Rate.ConvertFromLong((uint32)SampleRate);
+      for(count i = 0; i < 10; i++)
+        Header[28 + i] = Rate.Bytes[i];
+      Header[38] = 'S'; Header[39] = 'S'; Header[40] = 'N'; Header[41] = 'D';
+      PutInteger(&Header[42], 8 + DataLength, 4, true);
+      PutInteger(&Header[46], 0, 4, true);
+      PutInteger(&Header[50], 0, 4, true);
+      return File::Write(Filename, &Header[0], 54);
+    }
+
+    ///Interleaves frames from separate channels into a single buffer.
+    static void Interleave(int16* Destination, const int16* const* Channels,
+      count ChannelCount, count Frames)
+    {
+      if(ChannelCount == 1)
+      {
+        Memory::CopyArray(Destination, Channels[0], Frames);
+        return;
+      }
+
+      count i = 0;
+#ifdef primSoundUsesSSE2
+      if(ChannelCount == 2)
+      {
+        const int16* Left = Channels[0], * Right = Channels[1];
+        for(; i + 8 <= Frames; i += 8)
+        {
+          __m128i l = _mm_loadu_si128((const __m128i*)&Left[i]);
+          __m128i r = _mm_loadu_si128((const __m128i*)&Right[i]);
+          _mm_storeu_si128((__m128i*)&Destination[i * 2],
+            _mm_unpacklo_epi16(l, r));
+          _mm_storeu_si128((__m128i*)&Destination[i * 2 + 8],
+            _mm_unpackhi_epi16(l, r));
+        }
+      }
+#endif
+      for(count c = 0; c < ChannelCount; c++)
+      {
+        const int16* Source = Channels[c];
+        int16* Sample = &Destination[i * ChannelCount + c];
+        for(count j = i; j < Frames; j++, Sample += ChannelCount)
+          *Sample = Source[j];
+      }
+    }
+
+    ///Converts the buffered frames to the file byte order and appends them.
+    bool Flush(void)
+    {
+      if(!BufferedFrames)
+        return true;
+      int16* Samples = &Buffer[0];
+      count n = BufferedFrames * ChannelCount;
+      if((Type == Formats::AIFF) == Endian::IsLittleEndian())
+        SwapBytes16Bit(Samples, n);
+      BufferedFrames = 0;
+      return File::Append(Filename, (const byte*)Samples, n * 2);
+    }
+
+  public:
+    /**Creates the file and writes its header. The stream expects exactly
+    SampleCount frames; any that are not written are filled with silence when
+    the stream is closed.*/
+    Stream16Bit(const ascii* Filename, count ChannelCount, count SampleRate,
+      count SampleCount, Format Type = Formats::AIFF) : Filename(Filename),
+      Type(Type), ChannelCount(ChannelCount < 1 ? 1 : ChannelCount),
+      SampleRate(SampleRate), SampleCount(SampleCount < 0 ? 0 : SampleCount),
+      SamplesWritten(0), BufferedFrames(0)
+    {
+      Buffer.n(BufferFrames * Stream16Bit::ChannelCount);
+      IsOpen = WriteHeader();
+    }
+
+    ///Closes the stream if it is still open.
+    ~Stream16Bit()
+    {
+      Close();
+    }
+
+    ///Returns whether the file could be created and written to.
+    bool IsGood(void) const
+    {
+      return IsOpen;
+    }
+
+    /**Writes a block of frames given as one array of samples per channel.
+    Frames beyond the sample count given at construction are ignored.*/
+    bool WriteBlock(const int16* const* Channels, count Frames)
+    {
+      Frames = math::Min(Frames, SampleCount - SamplesWritten);
+      if(!IsOpen || Frames <= 0)
+        return IsOpen;
+
+      Array<const int16*> Sources;
+      Sources.n(ChannelCount);
+      for(count Written = 0; Written < Frames;)
+      {
+        count n = math::Min(Frames - Written, BufferFrames - BufferedFrames);
+        for(count c = 0; c < ChannelCount; c++)
+          Sources[c] = Channels[c] + Written;
+        Interleave(&Buffer[BufferedFrames * ChannelCount], &Sources[0],
+          ChannelCount, n);
+        BufferedFrames += n;
+        Written += n;
+        if(BufferedFrames == BufferFrames && !Flush())
+          IsOpen = false;
+      }
+      SamplesWritten += Frames;
+      return IsOpen;
+    }
+
+    ///Pads the file with silence to its full length and finishes writing.
+    bool Close(void)
+    {
+      if(!IsOpen)
+        return false;
+      while(SamplesWritten < SampleCount)
+      {
+        count n = math::Min(SampleCount - SamplesWritten,
+          BufferFrames - BufferedFrames);
+        Memory::ClearArray(&Buffer[BufferedFrames * ChannelCount],
+          n * ChannelCount);
+        BufferedFrames += n;
+        SamplesWritten += n;
+        if(BufferedFrames == BufferFrames)
+          Flush();
+      }
+      bool Success = Flush();
+      IsOpen = false;
+      return Success;
+    }
+  };
+
   ///A wrapper class for quickly writing multi-channel 16-bit AIFF files.
   class MultiChannel16BitAIFF
   {
@@ -195,93 +456,12 @@ namespace prim { namespace sound
     ///Writes this AIFF to file.
     void WriteToFile(const ascii* Filename)
     {
-      uint8 FORMAIFF[12] = {'F', 'O', 'R', 'M', 0, 0, 0, 0, 'A', 'I', 'F', 'F'};
-      
-      uint8 COMMONCHUNK[26];
-      COMMONCHUNK[0] = 'C';
-      COMMONCHUNK[1] = 'O';
-      COMMONCHUNK[2] = 'M';
-      COMMONCHUNK[3] = 'M';
-      
-      int32 chunkSize = 18;
-      int16 numChannels = (int16)ChannelCount;
-      uint32 numSampleFrames = (uint32)SampleCount;
-      int16 sampleSize = 16;
-      float80 sampleRate; sampleRate.ConvertFromLong((uint32)SampleRate);
-      
-      Endian::ConvertObjectToBigEndian(chunkSize);
-      Endian::ConvertObjectToBigEndian(numChannels);
-      Endian::ConvertObjectToBigEndian(numSampleFrames);
-      Endian::ConvertObjectToBigEndian(sampleSize);
-      
-      *(int32*)&COMMONCHUNK[4] = chunkSize;
-      *(int16*)&COMMONCHUNK[8] = numChannels;
-      *(uint32*)&COMMONCHUNK[10] = numSampleFrames;
-      *(int16*)&COMMONCHUNK[14] = sampleSize;
-      
-      for(int i = 0; i < 10; i++)
-        COMMONCHUNK[i + 16] = sampleRate.Bytes[i];
-        
-      uint8 SSNDCHUNK[16] = {'S', 'S', 'N', 'D', 0,0,0,0, 0,0,0,0, 0,0,0,0};
-      
-      int32 ssndChunkSize = (int32)(8 + 2 * SampleCount * ChannelCount);
-      Endian::ConvertObjectToBigEndian(ssndChunkSize);
-      *(int32*)&SSNDCHUNK[4] = ssndChunkSize;
-      
-      uint64 FileLength = 8 + chunkSize + 8 + ssndChunkSize;
-      *(uint32*)&FORMAIFF[4] = (uint32)FileLength;
-      
-      uint8 HEADER[12 + 26 + 16];
-      for(count i = 0; i < 12; i++) HEADER[i] = FORMAIFF[i];
-      for(count i = 0; i < 26; i++) HEADER[i + 12] = COMMONCHUNK[i];
-      for(count i = 0; i < 16; i++) HEADER[i + 12 + 26] = SSNDCHUNK[i];
-      count HeaderLength = 12 + 26 + 16;
-      
-      File::Write(Filename, &HEADER[0], HeaderLength);
-
-      count BufferSamples = 1024 * 256;
-      int16* Buffer = new int16[BufferSamples * ChannelCount];
-      for(count i = 0; i < SampleCount; i += BufferSamples)
-      {
-        count CurrentSamples = BufferSamples;
-        if(SampleCount - i < BufferSamples)
-          CurrentSamples = SampleCount - i;
-        
-        for(count c = 0; c < ChannelCount; c++)
-        {
-          Channel16Bit* channel = Channels[c];
-          int16* source = channel->GetSamples(i);
-          int16* sourceend = source + CurrentSamples;
-          int16* dest = &Buffer[c];
-          if(Endian::IsLittleEndian())
-          {
-            while(source != sourceend)
-            {
-              uint16 v = (uint16)*source;
-              uint8 a = (uint8)v;
-              uint8 b = (uint8)(v >> 8);
-              uint16 v_big_endian = (uint16)b +
-                ((uint16)a << (uint16)8);
-              *dest = (int16)v_big_endian;
-              dest += ChannelCount;
-              source++;
-            }
-          }
-          else
-          {
-            while(source != sourceend)
-            {
-              *dest = *source;
-              dest += ChannelCount;
-              source++;
-            }           
-          }
-        }
-        
-        File::Append(Filename, (byte*)&Buffer[0],
-          CurrentSamples * ChannelCount * 2);
-      }
-      delete [] Buffer;
+      Array<const int16*> Sources;
+      Sources.n(ChannelCount);
+      for(count c = 0; c < ChannelCount; c++)
+        Sources[c] = Channels[c]->GetSamples();
+      Stream16Bit Stream(Filename, ChannelCount, SampleRate, SampleCount);
+      Stream.WriteBlock(&Sources[0], SampleCount);
     }
   };
   
@@ -493,5 +673,161 @@ namespace prim { namespace sound
       delete [] Buffer;
     }
   };
+
+  /**The set of clicks that marks the onsets of a tree of rhythmic divisions,
+  one for each level. Deeper levels click higher and softer, and levels below
+  the deepest click share its sound. Each click is a decaying sine wave, so it
+  can be synthesized at any sample rate.*/
+  struct LevelClicks
+  {
+    ///Number of clicks, one for each level starting from the top
+    static const count Count = 4;
+
+    ///Duration of each click in seconds
+    static number Seconds(void)
+    {
+      return (number)0.04;
+    }
+
+    ///Frequency of a click in hertz
+    static number Frequency(count Click)
+    {
+      return (number)880.0 * (number)(Click + 1);
+    }
+
+    ///Amplitude of a click relative to full scale
+    static number Amplitude(count Click)
+    {
+      return (number)0.8 / (number)(Click + 1);
+    }
+
+    ///Returns the click for a level of the tree, starting at one.
+    static count ForLevel(count Level)
+    {
+      return math::Min(math::Max(Level, (count)1), Count) - 1;
+    }
+
+    /**Returns the value of a decaying sine wave at a time in seconds, relative
+    to full scale. It decays by 60 dB over the duration.*/
+    static number Sample(number Frequency, number Seconds, number Amplitude,
+      number Time)
+    {
+      return Amplitude * math::Exp((number)-6.9 / Seconds * Time) *
+        math::Sin(math::TwoPi * Frequency * Time);
+    }
+  };
+
+  /**Renders onsets as a click track. Each onset triggers one of a set of short
+  click sounds. The clicks are mixed into a fixed-size block with saturating
+  adds, and each finished block is streamed to file, so memory use depends only
+  on the block size and the clicks, not on the duration.*/
+  class ClickTrack
+  {
+  public:
+    ///An onset time in seconds and the click that sounds at it.
+    struct Onset
+    {
+      number Time;
+      count Click;
+
+      Onset() : Time(0), Click(0) {}
+      Onset(number Time, count Click) : Time(Time), Click(Click) {}
+
+      bool operator < (const Onset& Other) const
+      {
+        return Time < Other.Time;
+      }
+    };
+
+  private:
+    count SampleRate;
+    count BlockFrames;
+    Array<int16> ClickSamples;
+    Array<count> ClickStarts;
+    Array<count> ClickLengths;
+
+  public:
+    ///Creates a click track at a sample rate with a given block size.
+    ClickTrack(count SampleRate = 44100, count BlockFrames = 4096) :
+      SampleRate(SampleRate), BlockFrames(BlockFrames < 1 ? 1 : BlockFrames) {}
+
+    /**Adds a click synthesized as a decaying sine wave and returns its index.
+    The amplitude is relative to full scale and the click decays by 60 dB over
+    its duration.*/
+    count AddClick(number Frequency, number Seconds, number Amplitude)
+    {
+      count Length = math::Max((count)((number)SampleRate * Seconds), (count)1);
+      count Start = ClickSamples.n();
+      ClickSamples.n(Start + Length);
+      for(count i = 0; i < Length; i++)
+      {
+        number t = (number)i / (number)SampleRate;
+        number v = LevelClicks::Sample(Frequency, Seconds, Amplitude, t) *
+          (number)32767.0;
+        ClickSamples[Start + i] = Saturate16Bit((int32)v);
+      }
+      ClickStarts.Add(Start);
+      ClickLengths.Add(Length);
+      return ClickStarts.n() - 1;
+    }
+
+    ///Adds the level clicks in order, so that click i marks level i + 1.
+    void AddLevelClicks(void)
+    {
+      for(count i = 0; i < LevelClicks::Count; i++)
+        AddClick(LevelClicks::Frequency(i), LevelClicks::Seconds(),
+          LevelClicks::Amplitude(i));
+    }
+
+    /**Renders the onsets to a file lasting the given number of seconds. The
+    onsets are sorted by time in place. Onsets referring to clicks that do not
+    exist are skipped. The same signal is written to every channel.*/
+    bool Render(const ascii* Filename, Array<Onset>& Onsets, number Seconds,
+      count ChannelCount = 2,
+      Stream16Bit::Format Type = Stream16Bit::Formats::AIFF)
+    {
+      Onsets.Sort();
+      count SampleCount = (count)((number)SampleRate * Seconds);
+      Stream16Bit Stream(Filename, ChannelCount, SampleRate, SampleCount, Type);
+
+      Array<int16> Block;
+      Block.n(BlockFrames);
+      Array<const int16*> Channels;
+      Channels.n(math::Max(ChannelCount, (count)1));
+      for(count c = 0; c < Channels.n(); c++)
+        Channels[c] = &Block[0];
+
+      //Onsets before First have finished sounding.
+      count First = 0;
+      for(count b = 0; b < SampleCount && Stream.IsGood(); b += BlockFrames)
+      {
+        count Frames = math::Min(BlockFrames, SampleCount - b);
+        Memory::ClearArray(&Block[0], Frames);
+        for(count i = First; i < Onsets.n(); i++)
+        {
+          const Onset& o = Onsets[i];
+          count Start = (count)(o.Time * (number)SampleRate);
+          if(Start >= b + Frames)
+            break;
+          bool Exists = o.Click >= 0 && o.Click < ClickStarts.n();
+          count Length = Exists ? ClickLengths[o.Click] : 0;
+          if(Start + Length <= b)
+          {
+            if(i == First)
+              First++;
+            continue;
+          }
+          if(!Exists)
+            continue;
+          count From = math::Max(Start, b);
+          count To = math::Min(Start + Length, b + Frames);
+          MixSaturating(&Block[From - b],
+            &ClickSamples[ClickStarts[o.Click] + From - Start], To - From);
+        }
+        Stream.WriteBlock(&Channels[0], Frames);
+      }
+      return Stream.Close();
+    }
+  };
 }}
 #endif
@@ -1082,6 +1082,16 @@ namespace prim
       _endprofile(primProfiles);
     }
 
+    /**Move constructor takes the sections of a temporary string without
+    copying or merging them.*/
+    String(String&& otherString) : Length(otherString.Length),
+      Characters(otherString.Characters),
+      Sections(static_cast<List<Section>&&>(otherString.Sections))
+    {
+      otherString.Length = 0;
+      otherString.Characters = 0;
+    }
+
     ///Constructor turns an integer into a string.
     String(integer x) : Length(0), Characters(0)
     {
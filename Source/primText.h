@@ -104,6 +104,56 @@ namespace prim
       //Free temporary memory.
       delete HexCharacters;
     }
+
+    /**Encodes binary data as ASCII base-85 text terminated by ~>, which is
+    about 25% larger than the data instead of the 100% of hex. Groups of four
+    zero bytes are written as z.*/
+    static void EncodeDataAsASCII85String(
+      const byte* Data, count DataByteLength, String& ASCII85String)
+    {
+      //Create temporary ASCII character string.
+      ascii* Characters = new ascii[(DataByteLength + 3) / 4 * 5 + 3];
+
+      count c = 0;
+      for(count b = 0; b < DataByteLength; b += 4)
+      {
+        count GroupLength = DataByteLength - b < 4 ? DataByteLength - b : 4;
+        uint32 Group = 0;
+        for(count i = 0; i < 4; i++)
+          Group = (Group << 8) | (i < GroupLength ? (uint32)Data[b + i] : 0);
+
+        if(!Group && GroupLength == 4)
+        {
+          Characters[c++] = 'z';
+          continue;
+        }
+
+        ascii Digits[5];
+        for(count i = 4; i >= 0; i--)
+        {
+          Digits[i] = (ascii)(Group % 85 + 33);
+          Group /= 85;
+        }
+
+        //A partial group of n bytes is written as n + 1 characters.
+        for(count i = 0; i <= GroupLength; i++)
+          Characters[c++] = Digits[i];
+      }
+      Characters[c++] = '~';
+      Characters[c++] = '>';
+      Characters[c] = 0;
+
+      ASCII85String = Characters;
+      delete [] Characters;
+    }
+
+    /**Compresses data into a zlib stream (the format of the PDF FlateDecode
+    filter). The data is deflated in a single block with the fixed Huffman
+    codes and greedy LZ77 matching over a 32K window, which gets most of the
+    compression of a full encoder on repetitive data such as PDF operators
+    and dictionaries while staying small and fast.*/
+    static void CompressData(
+      const byte* Data, count DataByteLength, Array<byte>& Compressed);
   };
 }
 
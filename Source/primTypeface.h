@@ -32,6 +32,7 @@
 #include "primTypes.h"
 #include "primMemory.h"
 #include "primString.h"
+#include "primArray.h"
 #include "primEndian.h"
 
 namespace prim
@@ -1188,6 +1189,398 @@ namespace prim
         return Summary;
       }
 
+      //----------//
+      //SUBSETTING//
+      //----------//
+
+      ///Returns the table with the given four-letter code or null if absent.
+      const Table* FindTable(const ascii* FourLetterCode) const
+      {
+        for(count i = 0; Tables && i < NumTables; i++)
+        {
+          const Tag& t = Tables[i].NameTag;
+          if(t.FourLetterCode[0] == FourLetterCode[0] &&
+            t.FourLetterCode[1] == FourLetterCode[1] &&
+            t.FourLetterCode[2] == FourLetterCode[2] &&
+            t.FourLetterCode[3] == FourLetterCode[3])
+          {
+            if((count)Tables[i].Offset + (count)Tables[i].Length >
+              (count)Length)
+                return 0;
+            return &Tables[i];
+          }
+        }
+        return 0;
+      }
+
+      /**\brief Builds a smaller font program containing only the glyphs
+      needed to show the given character codes. \details The glyphs are
+      renumbered, starting with .notdef, and any components of composite
+      glyphs are pulled in as well. The glyf, loca, hmtx and cmap tables are
+      rebuilt for the new glyphs (cmap as a single Microsoft Unicode format 4
+      subtable), head, hhea and maxp are patched to match, post is reduced to
+      version 3 (no glyph names), and OS/2 and the hinting tables are copied
+      as they are. Returns false and leaves the output empty if the font is
+      missing a required table, in which case the whole program should be
+      used instead.*/
+      bool Subset(const Array<uint16>& CharacterCodes,
+        Array<byte>& SubsetProgram)
+      {
+        SubsetProgram.Clear();
+
+        const Table* tableHEAD = FindTable("head");
+        const Table* tableHHEA = FindTable("hhea");
+        const Table* tableMAXP = FindTable("maxp");
+        const Table* tableLOCA = FindTable("loca");
+        const Table* tableGLYF = FindTable("glyf");
+        const Table* tableHMTX = FindTable("hmtx");
+        if(!Program || !tableHEAD || !tableHHEA || !tableMAXP || !tableLOCA ||
+          !tableGLYF || !tableHMTX || tableHEAD->Length < 54 ||
+          tableHHEA->Length < 36 || tableMAXP->Length < 6)
+            return false;
+
+        count NumGlyphs = GetUInt16(&Program[tableMAXP->Offset + 4]);
+        count NumMetrics = GetUInt16(&Program[tableHHEA->Offset + 34]);
+        bool LongOffsets = GetUInt16(&Program[tableHEAD->Offset + 50]) != 0;
+        if(!NumGlyphs || !NumMetrics || NumMetrics > NumGlyphs ||
+          (count)tableLOCA->Length < (NumGlyphs + 1) * (LongOffsets ? 4 : 2) ||
+          (count)tableHMTX->Length < NumMetrics * 4 +
+          (NumGlyphs - NumMetrics) * 2)
+            return false;
+
+        const byte* LOCA = &Program[tableLOCA->Offset];
+        const byte* GLYF = &Program[tableGLYF->Offset];
+        const byte* HMTX = &Program[tableHMTX->Offset];
+
+        //Map old glyph indices to new ones, starting with .notdef.
+        Array<integer> NewIndex;
+        Array<uint16> OldIndex;
+        NewIndex.n(NumGlyphs);
+        for(count i = 0; i < NumGlyphs; i++)
+          NewIndex[i] = -1;
+        AddSubsetGlyph(0, NewIndex, OldIndex);
+
+        //Sort and remove duplicate character codes.
+        Array<uint16> Codes;
+        Codes.CopyFrom(CharacterCodes);
+        Codes.Sort();
+        Array<uint16> CodeGlyphs;
+        count UniqueCodes = 0;
+        for(count i = 0; i < Codes.n(); i++)
+        {
+          if(UniqueCodes && Codes[UniqueCodes - 1] == Codes[i])
+            continue;
+          uint16 Glyph = CMAP.GlyphIndexFromCharacterCode(Codes[i]);
+          if(!Glyph || (count)Glyph >= NumGlyphs)
+            continue;
+          Codes[UniqueCodes++] = Codes[i];
+          CodeGlyphs.Add(Glyph);
+          AddSubsetGlyph(Glyph, NewIndex, OldIndex);
+        }
+        Codes.n(UniqueCodes);
+
+        //Pull in the components of composite glyphs as the list grows.
+        for(count i = 0; i < OldIndex.n(); i++)
+        {
+          count Start = 0, End = 0;
+          GetGlyphRange(OldIndex[i], LOCA, LongOffsets, tableGLYF->Length,
+            Start, End);
+          if(End - Start < 10 || (int16)GetUInt16(&GLYF[Start]) >= 0)
+            continue;
+          for(count j = Start + 10; j + 4 <= End;)
+          {
+            uint16 Flags = GetUInt16(&GLYF[j]);
+            uint16 Component = GetUInt16(&GLYF[j + 2]);
+            if((count)Component < NumGlyphs)
+              AddSubsetGlyph(Component, NewIndex, OldIndex);
+            j += GetComponentLength(Flags);
+            if(!(Flags & 0x20)) //MORE_COMPONENTS
+              break;
+          }
+        }
+        count SubsetGlyphs = OldIndex.n();
+
+        //The tables to write, in the tag order the directory requires.
+        const ascii* Tags[12] = {"OS/2", "cmap", "cvt ", "fpgm", "glyf",
+          "head", "hhea", "hmtx", "loca", "maxp", "post", "prep"};
+        Array<byte> Data[12];
+        Array<byte>& dataCMAP = Data[1];
+        Array<byte>& dataGLYF = Data[4];
+        Array<byte>& dataHEAD = Data[5];
+        Array<byte>& dataHHEA = Data[6];
+        Array<byte>& dataHMTX = Data[7];
+        Array<byte>& dataLOCA = Data[8];
+        Array<byte>& dataMAXP = Data[9];
+        Array<byte>& dataPOST = Data[10];
+
+        //Copy the glyph outlines and build long loca offsets to them.
+        byte* NewLOCA = dataLOCA.n((SubsetGlyphs + 1) * 4);
+        for(count i = 0; i < SubsetGlyphs; i++)
+        {
+          count Start = 0, End = 0;
+          GetGlyphRange(OldIndex[i], LOCA, LongOffsets, tableGLYF->Length,
+            Start, End);
+          count Offset = dataGLYF.n();
+          PutUInt32(&NewLOCA[i * 4], (uint32)Offset);
+          count Padded = (End - Start + 3) & ~3;
+          if(!Padded)
+            continue;
+          byte* Glyph = &dataGLYF.n(Offset + Padded)[Offset];
+          Memory::CopyArray(Glyph, &GLYF[Start], End - Start);
+
+          //Renumber the components of a composite glyph.
+          if(End - Start < 10 || (int16)GetUInt16(Glyph) >= 0)
+            continue;
+          for(count j = 10; j + 4 <= End - Start;)
+          {
+            uint16 Flags = GetUInt16(&Glyph[j]);
+            uint16 Component = GetUInt16(&Glyph[j + 2]);
+            if((count)Component < NumGlyphs)
+              PutUInt16(&Glyph[j + 2], (uint16)NewIndex[Component]);
+            j += GetComponentLength(Flags);
+            if(!(Flags & 0x20))
+              break;
+          }
+        }
+        PutUInt32(&NewLOCA[SubsetGlyphs * 4], (uint32)dataGLYF.n());
+
+        //Write a full metric for every glyph.
+        byte* NewHMTX = dataHMTX.n(SubsetGlyphs * 4);
+        for(count i = 0; i < SubsetGlyphs; i++)
+        {
+          count Old = OldIndex[i];
+          uint16 Advance = GetUInt16(&HMTX[
+            (Old < NumMetrics ? Old : NumMetrics - 1) * 4]);
+          uint16 LSB = (Old < NumMetrics ? GetUInt16(&HMTX[Old * 4 + 2]) :
+            GetUInt16(&HMTX[NumMetrics * 4 + (Old - NumMetrics) * 2]));
+          PutUInt16(&NewHMTX[i * 4], Advance);
+          PutUInt16(&NewHMTX[i * 4 + 2], LSB);
+        }
+
+        //Patch the copies of head, hhea and maxp.
+        CopyTable(*tableHEAD, dataHEAD);
+        PutUInt32(&dataHEAD[8], 0); //Checksum adjustment is set at the end.
+        PutUInt16(&dataHEAD[50], 1); //Long loca offsets
+        CopyTable(*tableHHEA, dataHHEA);
+        PutUInt16(&dataHHEA[34], (uint16)SubsetGlyphs);
+        CopyTable(*tableMAXP, dataMAXP);
+        PutUInt16(&dataMAXP[4], (uint16)SubsetGlyphs);
+
+        //Drop the glyph names since the glyphs have been renumbered.
+        if(const Table* tablePOST = FindTable("post"))
+        {
+          if(tablePOST->Length >= 32)
+          {
+            Memory::CopyArray(dataPOST.n(32), &Program[tablePOST->Offset],
+              32);
+            PutUInt32(&dataPOST[0], 0x00030000);
+          }
+        }
+
+        //Copy the remaining tables as they are, if present.
+        for(count i = 0; i < 12; i++)
+        {
+          if(i == 0 || i == 2 || i == 3 || i == 11)
+            if(const Table* t = FindTable(Tags[i]))
+              CopyTable(*t, Data[i]);
+        }
+
+        /*Create the Microsoft Unicode format 4 character map. Runs of codes
+        that map to consecutive glyphs share a segment.*/
+        Array<uint16> StartCodes, EndCodes, Deltas;
+        for(count i = 0; i < Codes.n(); i++)
+        {
+          uint16 Code = Codes[i];
+          uint16 Delta = (uint16)(NewIndex[CodeGlyphs[i]] - (integer)Code);
+          if(EndCodes.n() && EndCodes.last() + 1 == Code &&
+            Deltas.last() == Delta)
+              EndCodes.last() = Code;
+          else
+          {
+            StartCodes.Add(Code);
+            EndCodes.Add(Code);
+            Deltas.Add(Delta);
+          }
+        }
+        StartCodes.Add(0xFFFF);
+        EndCodes.Add(0xFFFF);
+        Deltas.Add(1);
+
+        count Segments = StartCodes.n();
+        count SearchRange = 2;
+        count EntrySelector = 0;
+        while(SearchRange * 2 <= Segments * 2)
+        {
+          SearchRange *= 2;
+          EntrySelector++;
+        }
+        count SubtableLength = 16 + Segments * 8;
+        byte* NewCMAP = dataCMAP.n(12 + SubtableLength);
+        PutUInt16(&NewCMAP[0], 0); //Version
+        PutUInt16(&NewCMAP[2], 1); //Number of subtables
+        PutUInt16(&NewCMAP[4], 3); //Microsoft
+        PutUInt16(&NewCMAP[6], 1); //Unicode BMP
+        PutUInt32(&NewCMAP[8], 12);
+        byte* Format4 = &NewCMAP[12];
+        PutUInt16(&Format4[0], 4);
+        PutUInt16(&Format4[2], (uint16)SubtableLength);
+        PutUInt16(&Format4[4], 0); //Language
+        PutUInt16(&Format4[6], (uint16)(Segments * 2));
+        PutUInt16(&Format4[8], (uint16)SearchRange);
+        PutUInt16(&Format4[10], (uint16)EntrySelector);
+        PutUInt16(&Format4[12], (uint16)(Segments * 2 - SearchRange));
+        for(count i = 0; i < Segments; i++)
+        {
+          PutUInt16(&Format4[14 + i * 2], EndCodes[i]);
+          PutUInt16(&Format4[16 + Segments * 2 + i * 2], StartCodes[i]);
+          PutUInt16(&Format4[16 + Segments * 4 + i * 2], Deltas[i]);
+          PutUInt16(&Format4[16 + Segments * 6 + i * 2], 0);
+        }
+
+        //Lay out the table directory followed by the padded tables.
+        count TablesToWrite = 0;
+        for(count i = 0; i < 12; i++)
+          if(Data[i].n())
+            TablesToWrite++;
+        count DirectorySearchRange = 1;
+        count DirectoryEntrySelector = 0;
+        while(DirectorySearchRange * 2 <= TablesToWrite)
+        {
+          DirectorySearchRange *= 2;
+          DirectoryEntrySelector++;
+        }
+        count TotalLength = 12 + TablesToWrite * 16;
+        for(count i = 0; i < 12; i++)
+          TotalLength += (Data[i].n() + 3) & ~3;
+
+        byte* Out = SubsetProgram.n(TotalLength);
+        PutUInt32(&Out[0], 0x00010000);
+        PutUInt16(&Out[4], (uint16)TablesToWrite);
+        PutUInt16(&Out[6], (uint16)(DirectorySearchRange * 16));
+        PutUInt16(&Out[8], (uint16)DirectoryEntrySelector);
+        PutUInt16(&Out[10], (uint16)((TablesToWrite - DirectorySearchRange) *
+          16));
+
+        count Entry = 12;
+        count Offset = 12 + TablesToWrite * 16;
+        count HeadOffset = 0;
+        for(count i = 0; i < 12; i++)
+        {
+          count TableLength = Data[i].n();
+          if(!TableLength)
+            continue;
+          Memory::CopyArray(&Out[Offset], &Data[i][0], TableLength);
+          if(i == 5)
+            HeadOffset = Offset;
+          Memory::CopyArray(&Out[Entry], (const byte*)Tags[i], 4);
+          PutUInt32(&Out[Entry + 4], CalculateChecksum(&Out[Offset],
+            TableLength));
+          PutUInt32(&Out[Entry + 8], (uint32)Offset);
+          PutUInt32(&Out[Entry + 12], (uint32)TableLength);
+          Entry += 16;
+          Offset += (TableLength + 3) & ~3;
+        }
+
+        //The whole font must sum to 0xB1B0AFBA.
+        PutUInt32(&Out[HeadOffset + 8],
+          (uint32)0xB1B0AFBA - CalculateChecksum(Out, TotalLength));
+
+        return true;
+      }
+
+    private:
+      ///Reads a big-endian 16-bit value from raw font data.
+      static uint16 GetUInt16(const byte* b)
+      {
+        return (uint16)(((uint16)b[0] << 8) | (uint16)b[1]);
+      }
+
+      ///Reads a big-endian 32-bit value from raw font data.
+      static uint32 GetUInt32(const byte* b)
+      {
+        return ((uint32)b[0] << 24) | ((uint32)b[1] << 16) |
+          ((uint32)b[2] << 8) | (uint32)b[3];
+      }
+
+      ///Writes a big-endian 16-bit value to raw font data.
+      static void PutUInt16(byte* b, uint16 Value)
+      {
+        b[0] = (byte)(Value >> 8);
+        b[1] = (byte)Value;
+      }
+
+      ///Writes a big-endian 32-bit value to raw font data.
+      static void PutUInt32(byte* b, uint32 Value)
+      {
+        b[0] = (byte)(Value >> 24);
+        b[1] = (byte)(Value >> 16);
+        b[2] = (byte)(Value >> 8);
+        b[3] = (byte)Value;
+      }
+
+      ///Sums the data as big-endian longs, padding the end with zeroes.
+      static uint32 CalculateChecksum(const byte* b, count Bytes)
+      {
+        uint32 Sum = 0;
+        for(count i = 0; i < Bytes; i += 4)
+        {
+          uint32 Value = 0;
+          for(count j = 0; j < 4; j++)
+            Value = (Value << 8) | (i + j < Bytes ? (uint32)b[i + j] : 0);
+          Sum += Value;
+        }
+        return Sum;
+      }
+
+      ///Returns the byte length of a composite glyph component record.
+      static count GetComponentLength(uint16 Flags)
+      {
+        count ComponentLength = 4 + ((Flags & 0x1) ? 4 : 2);
+        if(Flags & 0x8) //WE_HAVE_A_SCALE
+          ComponentLength += 2;
+        else if(Flags & 0x40) //WE_HAVE_AN_X_AND_Y_SCALE
+          ComponentLength += 4;
+        else if(Flags & 0x80) //WE_HAVE_A_TWO_BY_TWO
+          ComponentLength += 8;
+        return ComponentLength;
+      }
+
+      ///Adds a glyph to the subset if it is not already in it.
+      static void AddSubsetGlyph(uint16 Glyph, Array<integer>& NewIndex,
+        Array<uint16>& OldIndex)
+      {
+        if(NewIndex[Glyph] >= 0)
+          return;
+        NewIndex[Glyph] = OldIndex.n();
+        OldIndex.Add(Glyph);
+      }
+
+      ///Finds the byte range of a glyph within the glyf table.
+      static void GetGlyphRange(uint16 Glyph, const byte* LOCA,
+        bool LongOffsets, uint32 GlyphTableLength, count& Start, count& End)
+      {
+        if(LongOffsets)
+        {
+          Start = GetUInt32(&LOCA[Glyph * 4]);
+          End = GetUInt32(&LOCA[Glyph * 4 + 4]);
+        }
+        else
+        {
+          Start = (count)GetUInt16(&LOCA[Glyph * 2]) * 2;
+          End = (count)GetUInt16(&LOCA[Glyph * 2 + 2]) * 2;
+        }
+        if(End > (count)GlyphTableLength || Start > End)
+          Start = End = 0;
+      }
+
+      ///Copies a table of the original program into a byte array.
+      void CopyTable(const Table& t, Array<byte>& Destination) const
+      {
+        Memory::CopyArray(Destination.n(t.Length), &Program[t.Offset],
+          t.Length);
+      }
+
+    public:
       //----------------------//
       //CONSTRUCTOR/DESTRUCTOR//
       //----------------------//
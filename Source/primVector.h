@@ -193,14 +193,6 @@ namespace prim
         return *this;
       }
 
-      ///Assignment operator copies another x-y pair into this one.
-      inline Cartesian operator = (Cartesian otherCartesian)
-      {
-        x = otherCartesian.x;
-        y = otherCartesian.y;
-        return *this;
-      }
-
       ///Equivalence comparison operator.
       inline bool operator == (Cartesian otherCartesian) const
       {
@@ -241,12 +233,9 @@ namespace prim
           Polar(Angle, Magnitude);
       }
 
-      ///Copy constructor copies another x-y pair into this one.
-      Cartesian(const Cartesian& otherCartesian)
-      {
-        x = otherCartesian.x;
-        y = otherCartesian.y;
-      }
+      /*The copy constructor and assignment operator are left implicit so
+      that a Cartesian of a plain number type stays trivially copyable, which
+      lets Array relocate vectors with a single memory copy.*/
 
       ///Creates a Cartesian x-y pair at the origin.
       Cartesian() : x(0), y(0) {}